@@ -0,0 +1,53 @@
+/*
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github
+ *
+ * This file is part of the sharpfin project
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ADAPTER_H__
+#define __ADAPTER_H__
+
+/*
+ * A JTAG adapter backend.  All adapters talk the wiggler's language:
+ * Output() gets a data port byte with the TCK_H, TMS_H and TDI_H bits
+ * of jtag.h, and Input() returns a status port byte with TDO inverted
+ * in bit 7.
+ *
+ * Open() gets the adapter's argument from the command line (may be
+ * NULL) and returns 0 on failure, after printing why.  Close() is
+ * called once the programmer is done.
+ */
+typedef struct {
+    const char *name;
+    int  (*Open)( const char *arg );
+    void (*Close)( void );
+    void (*Output)( U8 value );
+    U8   (*Input)( void );
+} JTAG_Adapter;
+
+extern const JTAG_Adapter *jtagAdapter;     // The one in use, defaults to the wiggler
+
+// Parallel port wiggler, ppt.c
+extern const JTAG_Adapter wigglerAdapter;
+
+// Simulated S3C2410 with a K9Fxx08 NAND on an image file, sim2410.c
+extern const JTAG_Adapter simAdapter;
+
+#endif //__ADAPTER_H__
@@ -29,6 +29,8 @@
 #include <string.h>
 #include "def.h"
 #include "jtag.h"
+
+const JTAG_Adapter *jtagAdapter = &wigglerAdapter;
 /*
  * Holding TMS=1 and giving 5 rising clock edges guarantees to get you to the "Test-Logic Reset" state
  * from any other state in JTAG land.
@@ -109,27 +111,44 @@ int size, i, tdi;
 	JTAG_SET( TDI_H | TMS_L | TCK_H ); JTAG_DELAY(); 	// Change to Run-Test/Idle
 }
 
-void JTAG_ShiftDRState( char *wrDR, char *rdDR ) {
-    int size, i, tdi;
+/*
+ * Shift a packed chain of cells through DR, from Run-Test/Idle back to
+ * Run-Test/Idle.  TDO is only sampled for the first 'capture' cells, so
+ * scans that just drive pins, or only need cells near the start of the
+ * chain, skip the status port reads.  Cells of rdDR past those are left
+ * as they were.
+ */
+void JTAG_ShiftDR( const U32 *wrDR, U32 *rdDR, int cells, int capture ) {
+    int w, b, n, last, sample;
+    U32 word, in, tdi, tms;
 	JTAG_SET( TDI_H | TMS_H | TCK_L ); JTAG_DELAY();
 	JTAG_SET( TDI_H | TMS_H | TCK_H ); JTAG_DELAY(); 	// Select-DR-Scan
 	JTAG_SET( TDI_H | TMS_L | TCK_L ); JTAG_DELAY();
 	JTAG_SET( TDI_H | TMS_L | TCK_H ); JTAG_DELAY(); 	// Capture-DR
 	JTAG_SET( TDI_H | TMS_L | TCK_L ); JTAG_DELAY();
 	JTAG_SET( TDI_H | TMS_L | TCK_H ); JTAG_DELAY(); 	// Shift-DR
-	size = strlen( wrDR );
-	for( i=0 ; i<(size-1) ; i++ ) {
-	    tdi = (wrDR[i] == HIGH) ? TDI_H : TDI_L;
-	    JTAG_SET( tdi | TMS_L | TCK_L ); JTAG_DELAY();
-	    JTAG_SET( tdi | TMS_L | TCK_H ); JTAG_DELAY(); 	// Shift-DR
-	    rdDR[i] = JTAG_GET_TDO();
+	if( rdDR == NULL ) capture = 0;
+	for( w=0 ; w<JTAG_WORDS(cells) ; w++ ) {
+	    word = wrDR[w];
+	    in = 0;
+	    n = cells - w*32;
+	    if( n>32 ) n = 32;
+	    last = (w == JTAG_WORDS(cells)-1) ? n-1 : -1;
+	    sample = capture - w*32;
+	    if( sample>n ) sample = n;
+	    for( b=0 ; b<n ; b++, word>>=1 ) {
+	        tdi = (word & 1) ? TDI_H : TDI_L;
+	        tms = (b == last) ? TMS_H : TMS_L;	// The last cell moves on to Exit1-DR
+	        JTAG_SET( tdi | tms | TCK_L ); JTAG_DELAY();
+	        JTAG_SET( tdi | tms | TCK_H ); JTAG_DELAY(); 	// Shift-DR
+	        if( b<sample ) in |= JTAG_TDO_BIT() << b;
+	    }
+	    if( sample == 32 )
+	        rdDR[w] = in;
+	    else if( sample > 0 )
+	        rdDR[w] = (rdDR[w] & ~((1U<<sample)-1)) | in;
 	}
 
-	tdi = (wrDR[i] == HIGH) ? TDI_H : TDI_L;	        // i = S3C2410_MAX_CELL_INDEX
-	JTAG_SET( tdi | TMS_H | TCK_L ); JTAG_DELAY();
-	JTAG_SET( tdi | TMS_H | TCK_H ); JTAG_DELAY(); 	    // Exit1-DR
-	rdDR[i] = JTAG_GET_TDO();
-
 	JTAG_SET( TDI_H | TMS_H | TCK_L ); JTAG_DELAY();
 	JTAG_SET( TDI_H | TMS_H | TCK_H ); JTAG_DELAY(); 	// Update-DR
 
@@ -138,32 +157,6 @@ void JTAG_ShiftDRState( char *wrDR, char *rdDR ) {
 	JTAG_SET( TDI_H | TMS_L | TCK_H ); JTAG_DELAY();    // Update-DR
 }
 
-void  JTAG_ShiftDRStateNoTDO(char *wrDR) {
-    int size, i, tdi;
-	JTAG_SET( TDI_H | TMS_H | TCK_L ); JTAG_DELAY();
-	JTAG_SET( TDI_H | TMS_H | TCK_H ); JTAG_DELAY(); 	// Select-DR-Scan
-	JTAG_SET( TDI_H | TMS_L | TCK_L ); JTAG_DELAY();
-	JTAG_SET( TDI_H | TMS_L | TCK_H ); JTAG_DELAY(); 	// Capture-DR
-	JTAG_SET( TDI_H | TMS_L | TCK_L ); JTAG_DELAY();
-	JTAG_SET( TDI_H | TMS_L | TCK_H ); JTAG_DELAY(); 	// Shift-DR
-	size = strlen( wrDR );
-	for( i=0 ; i<size-1 ; i++ ) {
-	    tdi = (wrDR[i] == HIGH) ? TDI_H : TDI_L;
-	    JTAG_SET( tdi | TMS_L | TCK_L ); JTAG_DELAY();
-	    JTAG_SET( tdi | TMS_L | TCK_H ); JTAG_DELAY(); 	// Shift-DR
-	    //rdDR[i]=JTAG_GET_TDO();
-	}
-	tdi = (wrDR[i]==HIGH) ? TDI_H:TDI_L;	            // i = S3C2410_MAX_CELL_INDEX
-	JTAG_SET( tdi | TMS_H | TCK_L ); JTAG_DELAY();
-	JTAG_SET( tdi | TMS_H | TCK_H ); JTAG_DELAY(); 	    // Exit1-DR
-	//rdDR[i] = JTAG_GET_TDO();
-	JTAG_SET( TDI_H | TMS_H | TCK_L ); JTAG_DELAY();
-	JTAG_SET( TDI_H | TMS_H | TCK_H ); JTAG_DELAY(); 	// Update-DR
-	//Run-Test/Idle
-	JTAG_SET( TDI_H | TMS_L | TCK_L ); JTAG_DELAY();
-	JTAG_SET( TDI_H | TMS_L | TCK_H ); JTAG_DELAY(); 	// Update-DR
-}
-
 U32 JTAG_ReadId(void) {
     int i;
     char id[32];
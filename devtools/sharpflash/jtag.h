@@ -25,7 +25,7 @@
 
 #ifndef __JTAG_H__
 #define __JTAG_H__
-#include "ppt.h"
+#include "adapter.h"
 /*****************************************************************************\
  *	                  [[    JTAG PIN assignment    ]]                        *
  *****************************************************************************
@@ -84,14 +84,25 @@
  * on the TAP timing requirements & how fast you can crank your CPU.
  */
 INLINE static void JTAG_DELAY( void ) {int _d;for(_d=0 ; _d<1 ; _d++);}
-INLINE static void JTAG_SET(U32 value)	{ OutputPpt(value); }
-INLINE static char JTAG_GET_TDO() { return (InputPpt()&(1<<7)) ? LOW:HIGH; }
+INLINE static void JTAG_SET(U32 value)	{ jtagAdapter->Output(value); }
+INLINE static char JTAG_GET_TDO() { return (jtagAdapter->Input()&(1<<7)) ? LOW:HIGH; }
+INLINE static U32  JTAG_TDO_BIT() { return (jtagAdapter->Input()&(1<<7)) ? 0:1; }
+
+/*
+ * Scan chains are packed bit vectors, cell n is bit (n%32) of word n/32,
+ * and cell 0 is the first one shifted in.
+ */
+#define JTAG_WORDS(cells)       (((cells)+31)/32)
+#define JTAG_CELL_WORD(n)       ((n)>>5)
+#define JTAG_CELL_MASK(n)       (1U<<((n)&31))
+#define JTAG_CELL_GET(v,n)      (((v)[JTAG_CELL_WORD(n)]&JTAG_CELL_MASK(n))!=0)
+#define JTAG_CELL_SET(v,n)      ((v)[JTAG_CELL_WORD(n)]|=JTAG_CELL_MASK(n))
+#define JTAG_CELL_CLR(v,n)      ((v)[JTAG_CELL_WORD(n)]&=~JTAG_CELL_MASK(n))
 
 // Local function prototypes
 void JTAG_Reset( void );
 void JTAG_RunTestldleState( void );
 U32  JTAG_ReadId( void );
 void JTAG_ShiftIRState( char *wrIR );
-void JTAG_ShiftDRState( char *wrDR, char *rdDR );
-void JTAG_ShiftDRStateNoTDO( char *wrDR );
+void JTAG_ShiftDR( const U32 *wrDR, U32 *rdDR, int cells, int capture );
 #endif
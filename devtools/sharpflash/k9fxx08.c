@@ -39,6 +39,8 @@ static void NF_nFCE_H(void);
 static U8   NF_RDDATA(void);
 static void NF_WRDATA(U8 data);
 static void NF_WAITRB(void);
+static void NF_StatsReset(void);
+static void NF_StatsPrint(const char *unit, U32 count);
 
 //*************** H/W dependent functions ***************
 static U16  NF_CheckId(void);
@@ -70,6 +72,7 @@ void K9Fxx08_badcheck(U16 type) {
 	if (type == JTAG_ID_K9F2808U0C) numBlocks = 1024;
 	if (type == JTAG_ID_K9F5608U0B) numBlocks = 2048;
 	printf("Checking NAND Blocks") ;
+	NF_StatsReset() ;
 	for (i=0 ; i<numBlocks ; i++) {
 		if (i%64 == 0)
             printf("\n %08X: ", i*0x4000) ;
@@ -83,12 +86,13 @@ void K9Fxx08_badcheck(U16 type) {
         fflush(stdout);
     }
 	printf("\nTotal Bad Blocks: %d\n", badcount) ;
+	NF_StatsPrint("block", numBlocks) ;
 }
 
 void K9Fxx08_write( char *filename, U32 start, U32 len ) {
     int i, blockwriteerror, bad;
     U32 sourceBlock, numBlocks;
-    U32 block, blockcount;
+    U32 block, blockcount, pages;
     U8 src[0x4200];
     FILE *fi;
     time_t rawtime, starttime;
@@ -113,6 +117,8 @@ void K9Fxx08_write( char *filename, U32 start, U32 len ) {
 	       "-------  --------------------------------  ---------\n") ;
 	time(&starttime) ;
 	blockcount=0 ;
+	pages=0 ;
+	NF_StatsReset() ;
 	while (blockcount<numBlocks) {
 		printf("%07X  ", block*0x4000) ;
 		fflush(stdout) ;
@@ -125,7 +131,7 @@ void K9Fxx08_write( char *filename, U32 start, U32 len ) {
                     printf("fread() error\n");
 			    blockwriteerror=0 ;
 			    // Fill It
-			    for (i=0; i<32; i++) {
+			    for (i=0; i<32; i++, pages++) {
 				    if (NF_WritePage(block, i, &src[i*528], &src[i*528+512])!=BAD_BLOCK_OK) {
 					    // Error Writing
 					    printf("B") ;
@@ -161,6 +167,7 @@ void K9Fxx08_write( char *filename, U32 start, U32 len ) {
 	}
 	// Close File
 	fclose( fi ) ;
+	NF_StatsPrint("page", pages) ;
 }
 
 void K9Fxx08_read(char *file, U32 start, U32 len) {
@@ -191,6 +198,7 @@ void K9Fxx08_read(char *file, U32 start, U32 len) {
 	printf("-------  --------------------------------  ---------\n") ;
 
 	time(&starttime) ;
+	NF_StatsReset() ;
 	for (blockcount=0, block = sourceBlock; blockcount < numBlocks; block++, blockcount++) {
 		printf("%07X  ", block*0x4000) ;
 		fflush(stdout) ;
@@ -217,11 +225,11 @@ void K9Fxx08_read(char *file, U32 start, U32 len) {
         printf("   %2dh %02dm\n", ((U32)mins/60), ((U32)mins%60)) ;
 
 		fflush(stdout) ;
-		block++ ;
 	}
 	printf("\n");
 	fclose( of );
 	fclose( df );
+	NF_StatsPrint("page", blockcount*32) ;
 }
 
 /*
@@ -463,6 +471,58 @@ static void NF_Init(void)
 //*************************************************
 //*************************************************
 
+// Every pin change costs a full DR scan of the chip, so the sequences below
+// use as few scans as the NAND timing allows:
+//  - a strobe needs two updates (falling and rising edge), so a command,
+//    address or data byte takes two scans,
+//  - releasing CLE/ALE and D[7:0] after a latch cycle is not scanned on
+//    its own but left pending and goes out with the next scan, which is
+//    the next falling nFWE edge or a R/nB poll,
+//  - a read byte is sampled by the scan that raises nFRE again: Capture-DR
+//    comes before Update-DR, so that scan still sees the data the NAND
+//    drove while nFRE was low.  nFRE has to go high in between, so a byte
+//    can't be sampled and the next one strobed by the same scan,
+//  - TDO is only sampled up to the last cell that is looked at.
+// The lower cells are nearest TDO, so a data byte needs 101 of the 427.
+#define NF_DATA_CAPTURE     (DATA0_IN+1)
+#define NF_WAIT_CAPTURE     (NCON0+1)
+
+static int nfPending;       // pin changes not scanned out yet
+
+static struct {
+    U32 scans;              // DR scans issued
+    U32 estimate;           // scans needed if R/nB is ready at the first poll
+    U32 tdo;                // cells sampled from TDO
+} nfStats;
+
+static void NF_Scan(int capture) {
+	JTAG_ShiftDR( outCellValue, capture ? inCellValue : NULL, S2410_CELLS, capture );
+	nfPending = 0;
+	nfStats.scans++;
+	nfStats.tdo += capture;
+}
+
+// Leave the bus after a latch cycle, goes out with the next scan
+static void NF_Release(void) {
+	S2410_SetPin( CLE, LOW );
+	S2410_SetPin( ALE, LOW );
+	S2410_SetPin( DATA0_7_CON, HIGH );     // D[7:0]=input
+	nfPending = 1;
+}
+
+static void NF_StatsReset(void) {
+	memset( &nfStats, 0, sizeof(nfStats) );
+}
+
+// Scan counts since NF_StatsReset(), per page or block
+static void NF_StatsPrint(const char *unit, U32 count) {
+	if (count == 0)
+		return;
+	printf("JTAG: %u %ss, %.1f scans/%s (estimated %.1f), %.1f TDO cells/%s\n",
+	       count, unit, (float)nfStats.scans/count, unit,
+	       (float)nfStats.estimate/count, (float)nfStats.tdo/count, unit) ;
+}
+
 void K9Fxx08_JtagInit(void)
 {
 	JTAG_RunTestldleState();
@@ -486,16 +546,13 @@ static void NF_CMD(U8 cmd)
 	S2410_SetPin( CLE, HIGH );
 
     S2410_SetDataByte( cmd );
-	JTAG_ShiftDRStateNoTDO( outCellValue );
+	NF_Scan( 0 );
 
 	S2410_SetPin(nFWE,HIGH);
-	JTAG_ShiftDRStateNoTDO( outCellValue );
+	NF_Scan( 0 );
 
-#if 1
-	S2410_SetPin(CLE,LOW);
-	S2410_SetPin(DATA0_7_CON,HIGH);        // D[7:0]=input
-	JTAG_ShiftDRStateNoTDO( outCellValue );
-#endif
+	NF_Release();
+	nfStats.estimate += 2;
 }
 
 
@@ -512,38 +569,43 @@ U8 b = (U8) addr & 0xff;
 	S2410_SetPin(ALE,HIGH);
 	S2410_SetPin(CLE,LOW);
 	S2410_SetDataByte( b );
-	JTAG_ShiftDRStateNoTDO(outCellValue);
+	NF_Scan( 0 );
 
 	S2410_SetPin(nFWE,HIGH);
-	JTAG_ShiftDRStateNoTDO(outCellValue);
+	NF_Scan( 0 );
 
-#if 1
-	S2410_SetPin(ALE,LOW);
-	S2410_SetPin(DATA0_7_CON,HIGH); //D[7:0]=input
-	JTAG_ShiftDRStateNoTDO(outCellValue);
-#endif
+	NF_Release();
+	nfStats.estimate += 2;
 }
 
 
+// nFCE goes low with the first strobe of the next cycle
 static void NF_nFCE_L(void) {
 	S2410_SetPin( nFCE,LOW );
-	JTAG_ShiftDRStateNoTDO( outCellValue );
+	nfPending = 1;
 }
 
 
 static void NF_nFCE_H(void) {
 	S2410_SetPin( nFCE,HIGH );
-	JTAG_ShiftDRStateNoTDO( outCellValue );
+	NF_Scan( 0 );
+	nfStats.estimate++;
 }
 
 
 static U8 NF_RDDATA(void) {
+	// tCLR/tAR: CLE and ALE must be low before nFRE falls, and D[7:0]
+	// must not be driven when the NAND starts to.
+	if (nfPending)
+		NF_Scan( 0 );
+
 	S2410_SetPin( DATA0_7_CON ,HIGH );                  //D[7:0]=input
 	S2410_SetPin( nFRE, LOW );
-	JTAG_ShiftDRStateNoTDO( outCellValue );
+	NF_Scan( 0 );
 
 	S2410_SetPin( nFRE, HIGH );
-	JTAG_ShiftDRState( outCellValue, inCellValue);
+	NF_Scan( NF_DATA_CAPTURE );
+	nfStats.estimate += 2;
 
     return S2410_GetDataByte();
 }
@@ -552,17 +614,19 @@ static void NF_WRDATA(U8 data) {
 	S2410_SetPin(DATA0_7_CON ,LOW); //D[7:0]=output
 	S2410_SetPin(nFWE,LOW);
 	S2410_SetDataByte(data);
-	JTAG_ShiftDRStateNoTDO(outCellValue);
+	NF_Scan( 0 );
 
 	S2410_SetPin(nFWE,HIGH);
-	JTAG_ShiftDRStateNoTDO(outCellValue);
+	NF_Scan( 0 );
+	nfStats.estimate += 2;
 }
 
 static void NF_WAITRB(void) {
 char state_nWAIT;
 char state_NCON0;
+	nfStats.estimate++;
     while (1) {
-		JTAG_ShiftDRState(outCellValue,inCellValue);
+		NF_Scan( NF_WAIT_CAPTURE );
         state_nWAIT = S2410_GetPin(nWAIT);
         state_NCON0 = S2410_GetPin(NCON0);
         if( (state_nWAIT==HIGH) && (state_NCON0==HIGH))
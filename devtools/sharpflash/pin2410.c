@@ -27,11 +27,19 @@
 #include "def.h"
 #include "pin2410.h"
 #include "jtag.h"
-char outCellValue[ S2410_MAX_CELL_INDEX + 2 ];
-char inCellValue[ S2410_MAX_CELL_INDEX + 2 ];
-int  dataOutCellIndex[ 32 ];
-int  dataInCellIndex[ 32 ];
-int  addrCellIndex[ 27 ];
+U32 outCellValue[ S2410_CELL_WORDS ];
+U32 inCellValue[ S2410_CELL_WORDS ];
+S2410_Cell dataOutCell[ 32 ];
+S2410_Cell dataInCell[ 32 ];
+S2410_Cell addrCell[ 27 ];
+
+static int  dataOutCellIndex[ 32 ];
+static int  dataInCellIndex[ 32 ];
+static int  addrCellIndex[ 27 ];
+
+static void S2410_MakeCells( S2410_Cell *cell, const int *index, int n );
+static void S2410_SetCells( const S2410_Cell *cell, U32 value, int n );
+static U32  S2410_GetCells( const S2410_Cell *cell, int n );
 
 void S2410_InitCell(void) {
     int i;
@@ -129,20 +137,23 @@ void S2410_InitCell(void) {
     addrCellIndex[25] = ADDR25;
     addrCellIndex[26] = ADDR26;
 
-    // outCellValue[] must be initialised with dummy values for JTAG_ShiftDRState();
-    for(i=0;i<=S2410_MAX_CELL_INDEX;i++)
+    // Word and mask of each cell, so that values are set without looking up indexes
+    S2410_MakeCells( dataOutCell, dataOutCellIndex, 32 );
+    S2410_MakeCells( dataInCell, dataInCellIndex, 32 );
+    S2410_MakeCells( addrCell, addrCellIndex, 27 );
+
+    // outCellValue[] must be initialised with dummy values for JTAG_ShiftDR();
+    for( i=0 ; i<S2410_CELL_WORDS ; i++ )
     {
-	    outCellValue[ i ] = HIGH;
-	     inCellValue[ i ] = 'u';
+	    outCellValue[ i ] = 0xffffffff;
+	     inCellValue[ i ] = 0;
     }
-    outCellValue[ S2410_MAX_CELL_INDEX+1 ] = '\0';
-     inCellValue[ S2410_MAX_CELL_INDEX+1 ] = '\0';
 
     JTAG_RunTestldleState();
     JTAG_ShiftIRState( SAMPLE_PRELOAD );
-    JTAG_ShiftDRState( outCellValue, inCellValue ); // inCellValue[] is initialised.
+    JTAG_ShiftDR( outCellValue, inCellValue, S2410_CELLS, S2410_CELLS ); // inCellValue[] is initialised.
 
-    for( i=0 ; i<=S2410_MAX_CELL_INDEX ; i++ )
+    for( i=0 ; i<S2410_CELL_WORDS ; i++ )
     {
     	outCellValue[i] = inCellValue[i];	        // outCellValue[] is initialised.
     }
@@ -198,109 +209,95 @@ void S2410_InitCell(void) {
 
 void S2410_SetPin(int index, char value)
 {
-    outCellValue[index] = value;
+    if( value == HIGH )
+        JTAG_CELL_SET( outCellValue, index );
+    else
+        JTAG_CELL_CLR( outCellValue, index );
 }
 
 
 char S2410_GetPin(int index)
 {
-    return inCellValue[ index ];
+    return JTAG_CELL_GET( inCellValue, index ) ? HIGH : LOW;
 }
 
 
 void S2410_SetAddr(U32 addr)
 {
-int i;
-
-    for( i=0 ; i<=26 ; i++ )
-    {
-    	if(addr & (1<<i))
-    	    outCellValue[addrCellIndex[i]] = HIGH;
-    	else
-    	    outCellValue[addrCellIndex[i]] = LOW;
-    }
+    S2410_SetCells( addrCell, addr, 27 );
 }
 
 
 void S2410_SetDataByte(U8 data)
 {
-int i;
-
-    for( i=0 ; i<8 ; i++ )
-    {
-    	if(data & (1<<i))
-    	    outCellValue[dataOutCellIndex[i]] = HIGH;
-    	else
-    	    outCellValue[dataOutCellIndex[i]] = LOW;
-    }
+    S2410_SetCells( dataOutCell, data, 8 );
 }
 
 
 void S2410_SetDataHW(U16 data)
 {
-    int i;
-
-    for(i=0;i<16;i++)
-    {
-    	if(data & (1<<i))
-    	    outCellValue[dataOutCellIndex[i]] = HIGH;
-    	else
-    	    outCellValue[dataOutCellIndex[i]] = LOW;
-    }
+    S2410_SetCells( dataOutCell, data, 16 );
 }
 
 
 void S2410_SetDataWord(U32 data)
 {
-int i;
+    S2410_SetCells( dataOutCell, data, 32 );
+}
 
-    for(i=0;i<32;i++)
-    {
-    	if(data & (1<<i))
-    	    outCellValue[dataOutCellIndex[i]] = HIGH;
-    	else
-    	    outCellValue[dataOutCellIndex[i]] = LOW;
-    }
+
+U8 S2410_GetDataByte(void)
+{
+    return (U8) S2410_GetCells( dataInCell, 8 );
 }
 
+U16 S2410_GetDataHW(void) {
+    return (U16) S2410_GetCells( dataInCell, 16 );
+}
 
 
-U8 S2410_GetDataByte(void)
+U32 S2410_GetDataWord(void) {
+    return S2410_GetCells( dataInCell, 32 );
+}
+
+
+static void S2410_MakeCells( S2410_Cell *cell, const int *index, int n )
 {
-int	i;
-U8 data=0;
+int i;
 
-    for(i=0 ; i<8 ; i++)
+    for( i=0 ; i<n ; i++ )
     {
-        if(inCellValue[dataInCellIndex[i]] == HIGH)
-        {
-            data |=(1<<i);
-        }
+        cell[i].word = JTAG_CELL_WORD( index[i] );
+        cell[i].mask = JTAG_CELL_MASK( index[i] );
     }
-    return data;
 }
 
-U16 S2410_GetDataHW(void) {
-    int	i;
-    U16 data=0;
-    for(i=0 ; i<16 ; i++) {
-        if(inCellValue[dataInCellIndex[i]]==HIGH)
-        {
-            data |= (1<<i);
-        }
+
+/*
+ * Bit i of value goes to cell[i]
+ */
+static void S2410_SetCells( const S2410_Cell *cell, U32 value, int n )
+{
+int i;
+U32 *w;
+
+    for( i=0 ; i<n ; i++, value>>=1 )
+    {
+        w = &outCellValue[ cell[i].word ];
+        *w = (value & 1) ? (*w | cell[i].mask) : (*w & ~cell[i].mask);
     }
-    return data;
 }
 
 
-U32 S2410_GetDataWord(void) {
-    int	i;
-    U32 data=0;
-    for(i=0 ; i<32 ; i++) {
-        if(inCellValue[dataInCellIndex[i]]==HIGH)
-        {
-            data |= (1<<i);
-        }
+static U32 S2410_GetCells( const S2410_Cell *cell, int n )
+{
+int i;
+U32 data=0;
+
+    for( i=0 ; i<n ; i++ )
+    {
+        if( inCellValue[ cell[i].word ] & cell[i].mask )
+            data |= (1U<<i);
     }
     return data;
 }
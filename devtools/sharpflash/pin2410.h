@@ -26,8 +26,11 @@
 
 #ifndef __PIN2410_H__
 #define __PIN2410_H__
+#include "jtag.h"
 // Boundary Scan Cell number of S3C2410
 #define S2410_MAX_CELL_INDEX	426	//0~426
+#define S2410_CELLS         (S2410_MAX_CELL_INDEX+1)
+#define S2410_CELL_WORDS    JTAG_WORDS(S2410_CELLS)
 #define DATA0_7_CON	    (99)
 #define DATA0_IN	    (100)
 #define DATA0_OUT	    (98)
@@ -181,6 +184,12 @@
 /* Exported Functions                                                        */
 /*****************************************************************************/
 
+/* Word and mask of a cell in a packed chain, see jtag.h */
+typedef struct {
+    int word;
+    U32 mask;
+} S2410_Cell;
+
 void S2410_InitCell(void);
 void S2410_SetPin(int index, char value);
 char S2410_GetPin(int index);
@@ -191,13 +200,13 @@ U8  S2410_GetDataByte( void );
 U16 S2410_GetDataHW( void );
 U32 S2410_GetDataWord( void );
 void S2410_SetAddr(U32 addr);
-extern char outCellValue[ S2410_MAX_CELL_INDEX + 2 ];
-extern char  inCellValue[ S2410_MAX_CELL_INDEX + 2 ];
-extern int  dataOutCellIndex[32];
-extern int  dataInCellIndex[32];
-extern int  addrCellIndex[27];
+extern U32 outCellValue[ S2410_CELL_WORDS ];
+extern U32  inCellValue[ S2410_CELL_WORDS ];
+extern S2410_Cell dataOutCell[32];
+extern S2410_Cell dataInCell[32];
+extern S2410_Cell addrCell[27];
 
 // MACRO for speed up
-//#define S2410_SetPin(index,value)   outCellValue[index] = value
-//#define S2410_GetPin(index)	    inCellValue[index]
+//#define S2410_SetPin(index,value)   ((value)==HIGH ? JTAG_CELL_SET(outCellValue,index) : JTAG_CELL_CLR(outCellValue,index))
+//#define S2410_GetPin(index)	    (JTAG_CELL_GET(inCellValue,index) ? HIGH : LOW)
 #endif  //__PIN2410_H__
@@ -42,6 +42,7 @@
 
 #include "def.h"
 #include "ppt.h"
+#include "adapter.h"
 
 // Printer port and bit definitions
 #define ECP_ECR_OFFSET		0x402       // Looks wrong but it's actually right
@@ -216,3 +217,30 @@ int EnableIO( void ) {
     return 0;
 #endif
 }
+
+
+/*
+ * The wiggler as a JTAG adapter backend.  The port is chosen with
+ * SetPrinterNumber() beforehand, so the argument is not used.
+ */
+static int WigglerOpen( const char *arg ) {
+    // In both Windows and Linux we must enable access to the I/O ports
+    if (EnableIO() == 0) {
+        printf("Unable to access I/O ports.\n");
+        return 0;
+    }
+    // Configure the parallel port
+    ConfigureParallelPort();
+    return 1;
+}
+
+static void WigglerClose( void ) {
+#if defined(LINUX_PPDEV) && ! defined(__CYGWIN__)
+    ioctl(validPpt, PPRELEASE);
+    close(validPpt);
+#endif
+}
+
+const JTAG_Adapter wigglerAdapter = {
+    "wiggler", WigglerOpen, WigglerClose, OutputPpt, InputPpt
+};
@@ -31,6 +31,7 @@
 #include "def.h"
 #include "jtag.h"
 #include "ppt.h"
+#include "adapter.h"
 #include "pin2410.h"
 #include "k9fxx08.h"
 
@@ -45,14 +46,22 @@ eCommandMode mode = GET_JTAG_IDS;
 U32 start_address = 0;
 U32 length = 0;
 char filename[ 256 ];
+char *adapterArg = NULL;
 
 void usage() {
 	printf("\n"
-           "sharpflash [-p 1|2|3] [-r|-w filename start length ]\n"
-	       "sharpflash [-p 1|2|3] [-b]\n\n"
+           "sharpflash [-p 1|2|3 | -s image[,options]] [-r|-w filename start length ]\n"
+	       "sharpflash [-p 1|2|3 | -s image[,options]] [-b]\n\n"
 	       "  -r -w      Read flash to file, or write file to flash\n"
            "  -b         Check flash for bad blocks\n"
 	       "  -p <n>     n = 1, 2 or 3. Use LPT1 (default) LPT2 or LPT3 parallel port\n"
+	       "  -s <spec>  Use a simulated processor and NAND instead of the cable, with\n"
+	       "             the flash contents in a nanddump format image file. Options:\n"
+	       "               id=ec73|ec75    flash type (default ec75)\n"
+	       "               bad=n:n:...     blocks with a factory bad block mark\n"
+	       "               fail=n:n:...    blocks that fail erase and program\n"
+	       "               tck=kHz         TCK rate for the timing (default 250)\n"
+	       "               tr=, tprog=, tbers=  busy times in us (10, 200, 2000)\n"
 	       "  filename   Destination / source filename, the file must be in nanddump format\n"
 	       "  start      Hex start address in NAND for read/write, must be a multiple of 0x4000\n"
 	       "  length     Hex length to read/write. if file is too short,\n"
@@ -87,6 +96,14 @@ void ParseCommandLine(int argc, char *argv[] ) {
                 exit(1);
             }
             paramnum +=2;
+        } else if (strcmp(argv[ paramnum ], "-s") == 0) {
+            if (paramnum+1>=argc) {
+                printf("Missing simulator image file\n");
+                exit(1);
+            }
+            jtagAdapter = &simAdapter;
+            adapterArg = argv[ paramnum+1 ];
+            paramnum +=2;
         } else if (strcmp(argv[ paramnum ], "-b")==0) {
             mode = BLOCK_CHECK_MODE;
             paramnum++;
@@ -144,17 +161,14 @@ int main(int argc, char *argv[]) {
         printf("length must be a multiple of 0x4000\n") ;
         return 1;
     }
-    // In both Windows and Linux we must enable access to the I/O ports
-    if (EnableIO() == 0) {
-        printf("Unable to access I/O ports.\n");
+    // Open the JTAG cable, or the simulator
+    if (jtagAdapter->Open(adapterArg) == 0)
         return 1;
-    }
-    // Configure the parallel port
-    ConfigureParallelPort();
     // Connect to the Processor
     cpu_id = JTAG_ReadId();
     if (cpu_id != JTAG_ID_CPU) {
     	printf("Unable to find S3C2410 processor on JTAG Cable, found %08X\n", cpu_id);
+    	jtagAdapter->Close();
     	return 0 ;
     }
     printf("Detected S3C2410 processor on JTAG Cable\n");
@@ -173,12 +187,15 @@ int main(int argc, char *argv[]) {
         printf("Found K9F5608UOC flash on processor, id=0x%04X\n", flash_id );
     } else {
         printf("Unknown flash id on processor bus, found 0x%04X\n", flash_id );
+        jtagAdapter->Close();
     return 1;
     }
     
     // If that's all we need to do then exit
-    if (mode == GET_JTAG_IDS)
+    if (mode == GET_JTAG_IDS) {
+        jtagAdapter->Close();
         exit(0);
+    }
 
     if (mode == FLASH_READ_MODE) {
         // Read data
@@ -191,5 +208,6 @@ int main(int argc, char *argv[]) {
 		K9Fxx08_badcheck( flash_id ) ;
     }
 	printf("\n") ;
+	jtagAdapter->Close();
 	return 0 ;
 }
@@ -0,0 +1,639 @@
+/*
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github
+ *
+ * This file is part of the sharpfin project
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Simulated target: the S3C2410 TAP and boundary scan chain, with a
+ * K9Fxx08 NAND on its NAND controller pins.  The flash contents live in
+ * an image file in nanddump format (528 byte pages), which is created
+ * erased if it doesn't exist and written back on close.
+ *
+ * The adapter argument is
+ *
+ *   image[,id=ec73|ec75][,bad=n:n:...][,fail=n:n:...][,tck=kHz]
+ *        [,tr=us][,tprog=us][,tbers=us]
+ *
+ * bad= blocks get a factory bad block mark, fail= blocks report a
+ * failure on erase (and stay as they were) and on program (which still
+ * happens).  The busy times are turned into TCK cycles at tck= kHz,
+ * which is also what the wire time in the summary is worked out at.
+ *
+ * The NAND only sees the pins at each Update-DR, so it checks the cycles
+ * for what the timing needs at that resolution: CLE, ALE, nFCE and the
+ * data must be stable while nFWE rises, CLE and ALE low and the data
+ * bus released while nFRE falls, and no data read while busy.  Anything
+ * else is counted as a timing violation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "def.h"
+#include "jtag.h"
+#include "pin2410.h"
+
+#define SIM_PAGE            528
+#define SIM_PAGES_PER_BLOCK 32
+#define SIM_MAX_LIST        64
+#define SIM_MAX_REPORT      10
+
+// IR values, the first bit shifted in is the LSB
+#define IR_EXTEST           0x0
+#define IR_SAMPLE_PRELOAD   0x3
+#define IR_IDCODE           0xe
+
+// TAP controller states
+enum {
+    TLR, RTI, SELDR, CAPDR, SHDR, EX1DR, PADR, EX2DR, UPDR,
+    SELIR, CAPIR, SHIR, EX1IR, PAIR, EX2IR, UPIR
+};
+
+// Next state for TMS low and high
+static const U8 tapNext[16][2] = {
+    { RTI, TLR },     { RTI, SELDR },   { CAPDR, SELIR }, { SHDR, EX1DR },
+    { SHDR, EX1DR },  { PADR, UPDR },   { PADR, EX2DR },  { SHDR, UPDR },
+    { RTI, SELDR },   { CAPIR, TLR },   { SHIR, EX1IR },  { SHIR, EX1IR },
+    { PAIR, UPIR },   { PAIR, EX2IR },  { SHIR, UPIR },   { RTI, SELDR }
+};
+
+// D[7:0] cells
+static const int dataOut[8] = {
+    DATA0_OUT, DATA1_OUT, DATA2_OUT, DATA3_OUT, DATA4_OUT, DATA5_OUT, DATA6_OUT, DATA7_OUT
+};
+static const int dataIn[8] = {
+    DATA0_IN, DATA1_IN, DATA2_IN, DATA3_IN, DATA4_IN, DATA5_IN, DATA6_IN, DATA7_IN
+};
+
+// What nFRE puts on the data bus
+enum { OUT_NONE, OUT_DATA, OUT_STATUS, OUT_ID };
+
+// Command being built up from the latch cycles
+enum { CMD_NONE, CMD_READ, CMD_PROG, CMD_ERASE, CMD_ID };
+
+// NAND pins as driven by the boundary scan cells
+typedef struct {
+    int cle, ale, nwe, nre, nce;
+    int drive;              // D[7:0] driven by the CPU
+    U8  data;
+} SIM_Pins;
+
+static struct {
+    // TAP
+    U8  lastOut;
+    int state;
+    U32 ir, irShift;
+    int tdo;
+    U32 chain[S2410_CELL_WORDS];    // Shift-DR, as a ring of 'len' cells from 'pos'
+    int len, pos;
+    U32 update[S2410_CELL_WORDS];   // Boundary scan update register
+    SIM_Pins pins;
+
+    // NAND
+    char file[256];
+    U8  *image;
+    U32 blocks;
+    U16 id;
+    int dirty;
+    int cmd, addrCycles, output, driving, idIndex;
+    U32 area, col, row;
+    U8  page[SIM_PAGE];
+    U8  status;
+    U32 busy;               // TCK cycles left
+    U32 fail[SIM_MAX_LIST];
+    int nFail;
+
+    // Timing
+    U32 tck, tR, tPROG, tBERS, tRST;
+
+    // Statistics
+    unsigned long long tckCycles;
+    U32 scans, reads, programs, erases, violations;
+} sim;
+
+static void SIM_Violation( const char *what ) {
+    sim.violations++;
+    if (sim.violations <= SIM_MAX_REPORT)
+        printf("sim: %s at scan %u\n", what, sim.scans);
+}
+
+static U32 SIM_Cycles( U32 us ) {
+    return (U32)(((unsigned long long)us * sim.tck) / 1000);
+}
+
+static int SIM_Failing( U32 block ) {
+    int i;
+    for (i=0 ; i<sim.nFail ; i++)
+        if (sim.fail[i] == block)
+            return 1;
+    return 0;
+}
+
+static U8 *SIM_Page( U32 row ) {
+    return &sim.image[ (row % (sim.blocks*SIM_PAGES_PER_BLOCK)) * SIM_PAGE ];
+}
+
+/*
+ * NAND side
+ */
+
+static void SIM_Command( U8 cmd ) {
+    U32 block = (sim.row % (sim.blocks*SIM_PAGES_PER_BLOCK)) / SIM_PAGES_PER_BLOCK;
+    int i;
+    U8 *p;
+
+    if (sim.busy && cmd != 0x70 && cmd != 0xff) {
+        SIM_Violation("command while busy");
+        return;
+    }
+    switch (cmd) {
+        case 0xff:                          // Reset
+            sim.cmd = CMD_NONE;
+            sim.output = OUT_NONE;
+            sim.area = 0;
+            sim.busy = sim.tRST;
+            break;
+        case 0x00:                          // Read area A, B or C (spare)
+        case 0x01:
+        case 0x50:
+            sim.area = (cmd == 0x00) ? 0 : (cmd == 0x01) ? 256 : 512;
+            sim.cmd = CMD_READ;
+            sim.addrCycles = 0;
+            sim.output = OUT_NONE;
+            break;
+        case 0x80:                          // Serial data input
+            sim.cmd = CMD_PROG;
+            sim.addrCycles = 0;
+            sim.output = OUT_NONE;
+            memset(sim.page, 0xff, SIM_PAGE);
+            break;
+        case 0x10:                          // Program
+            if (sim.cmd != CMD_PROG || sim.addrCycles < 3) {
+                SIM_Violation("program without address");
+                break;
+            }
+            p = SIM_Page(sim.row);
+            for (i=0 ; i<SIM_PAGE ; i++)
+                p[i] &= sim.page[i];
+            sim.dirty = 1;
+            sim.programs++;
+            sim.status = SIM_Failing(block) ? 0x01 : 0x00;
+            sim.busy = sim.tPROG;
+            sim.cmd = CMD_NONE;
+            if (sim.area == 256)
+                sim.area = 0;
+            break;
+        case 0x60:                          // Block erase
+            sim.cmd = CMD_ERASE;
+            sim.addrCycles = 0;
+            sim.output = OUT_NONE;
+            break;
+        case 0xd0:
+            if (sim.cmd != CMD_ERASE || sim.addrCycles < 2) {
+                SIM_Violation("erase without address");
+                break;
+            }
+            if (SIM_Failing(block)) {
+                sim.status = 0x01;
+            } else {
+                memset(SIM_Page(block*SIM_PAGES_PER_BLOCK), 0xff, SIM_PAGE*SIM_PAGES_PER_BLOCK);
+                sim.dirty = 1;
+                sim.status = 0x00;
+            }
+            sim.erases++;
+            sim.busy = sim.tBERS;
+            sim.cmd = CMD_NONE;
+            break;
+        case 0x70:                          // Read status
+            sim.output = OUT_STATUS;
+            break;
+        case 0x90:                          // Read ID
+            sim.cmd = CMD_ID;
+            sim.addrCycles = 0;
+            sim.output = OUT_NONE;
+            break;
+        default:
+            SIM_Violation("unknown command");
+            break;
+    }
+}
+
+static void SIM_Address( U8 addr ) {
+    switch (sim.cmd) {
+        case CMD_READ:
+        case CMD_PROG:
+            if (sim.addrCycles == 0)
+                sim.col = sim.area + ((sim.area == 512) ? (addr & 0x0f) : addr);
+            else if (sim.addrCycles == 1)
+                sim.row = addr;
+            else if (sim.addrCycles == 2)
+                sim.row |= addr << 8;
+            if (++sim.addrCycles == 3 && sim.cmd == CMD_READ) {
+                sim.output = OUT_DATA;
+                sim.busy = sim.tR;
+                sim.reads++;
+                if (sim.area == 256)
+                    sim.area = 0;
+            }
+            break;
+        case CMD_ERASE:
+            if (sim.addrCycles == 0)
+                sim.row = addr;
+            else if (sim.addrCycles == 1)
+                sim.row |= addr << 8;
+            sim.addrCycles++;
+            break;
+        case CMD_ID:
+            sim.output = OUT_ID;
+            sim.idIndex = 0;
+            break;
+        default:
+            SIM_Violation("address without command");
+            break;
+    }
+}
+
+static void SIM_Data( U8 data ) {
+    if (sim.cmd != CMD_PROG || sim.addrCycles < 3) {
+        SIM_Violation("data input without program command");
+        return;
+    }
+    if (sim.col < SIM_PAGE)
+        sim.page[sim.col++] = data;
+}
+
+// Byte on the bus while nFRE is low
+static U8 SIM_ReadByte( void ) {
+    switch (sim.output) {
+        case OUT_DATA:
+            return SIM_Page(sim.row)[sim.col];
+        case OUT_STATUS:
+            return 0x80 | (sim.busy ? 0x00 : 0x40) | sim.status;
+        case OUT_ID:
+            return (sim.idIndex == 0) ? (sim.id >> 8) : (sim.id & 0xff);
+    }
+    return 0xff;
+}
+
+// nFRE rising edge, move on to the next byte
+static void SIM_ReadNext( void ) {
+    if (sim.output == OUT_DATA && ++sim.col == SIM_PAGE) {
+        // Sequential row read
+        sim.col = (sim.area == 512) ? 512 : 0;
+        sim.row++;
+        sim.busy = sim.tR;
+    } else if (sim.output == OUT_ID) {
+        sim.idIndex++;
+    }
+}
+
+// The pins as they are after an Update-DR in EXTEST
+static void SIM_ReadPins( SIM_Pins *p ) {
+    int i;
+    p->cle   = JTAG_CELL_GET(sim.update, CLE);
+    p->ale   = JTAG_CELL_GET(sim.update, ALE);
+    p->nwe   = JTAG_CELL_GET(sim.update, nFWE);
+    p->nre   = JTAG_CELL_GET(sim.update, nFRE);
+    p->nce   = JTAG_CELL_GET(sim.update, nFCE);
+    p->drive = !JTAG_CELL_GET(sim.update, DATA0_7_CON);
+    p->data  = 0;
+    for (i=0 ; i<8 ; i++)
+        if (JTAG_CELL_GET(sim.update, dataOut[i]))
+            p->data |= 1<<i;
+}
+
+static void SIM_PinsIdle( SIM_Pins *p ) {
+    memset(p, 0, sizeof(*p));
+    p->nwe = p->nre = p->nce = 1;
+}
+
+// Work out the NAND cycles from the pin changes
+static void SIM_Update( const SIM_Pins *now ) {
+    const SIM_Pins *was = &sim.pins;
+    int selected = !was->nce || !now->nce;
+
+    if (!now->nwe && !now->nre)
+        SIM_Violation("nFWE and nFRE low together");
+
+    if (selected && !was->nwe && now->nwe) {
+        // Latch on the rising nFWE edge, with what was set up before it
+        if (was->nce)
+            SIM_Violation("nFWE rising with nFCE high");
+        else if (now->cle != was->cle || now->ale != was->ale || now->nce != was->nce)
+            SIM_Violation("CLE/ALE/nFCE change on rising nFWE (tCLH/tALH/tCH)");
+        else if (!was->drive || !now->drive || now->data != was->data)
+            SIM_Violation("data not held on rising nFWE (tDH)");
+        else if (was->cle && was->ale)
+            SIM_Violation("CLE and ALE high together");
+        else if (was->cle)
+            SIM_Command(was->data);
+        else if (was->ale)
+            SIM_Address(was->data);
+        else
+            SIM_Data(was->data);
+    }
+
+    if (!now->nce && was->nre && !now->nre) {
+        // Falling nFRE, the NAND starts to drive the bus.  CLE and ALE
+        // must have gone low, and the CPU let go of it, before that.
+        if (was->cle || was->ale || now->cle || now->ale)
+            SIM_Violation("nFRE falling too soon after CLE/ALE (tCLR/tAR)");
+        if (was->drive || now->drive)
+            SIM_Violation("nFRE falling with D[7:0] driven (bus contention)");
+        if (sim.busy && sim.output != OUT_STATUS)
+            SIM_Violation("data read while busy");
+        sim.driving = 1;
+    } else if (sim.driving && (now->nre || now->nce)) {
+        sim.driving = 0;
+        if (now->nre && !was->nre && !was->nce)
+            SIM_ReadNext();
+    }
+
+    sim.pins = *now;
+}
+
+/*
+ * S3C2410 side
+ */
+
+// Capture-DR in EXTEST: the input cells see the pins
+static void SIM_Capture( void ) {
+    U8 bus;
+    int i, ready = (sim.busy == 0);
+
+    memcpy(sim.chain, sim.update, sizeof(sim.chain));
+    if (sim.driving)
+        bus = SIM_ReadByte();
+    else if (sim.pins.drive)
+        bus = sim.pins.data;
+    else
+        bus = 0xff;                         // Pull-ups
+    if (sim.driving && sim.pins.drive)
+        bus &= sim.pins.data;
+    for (i=0 ; i<8 ; i++) {
+        if (bus & (1<<i))
+            JTAG_CELL_SET(sim.chain, dataIn[i]);
+        else
+            JTAG_CELL_CLR(sim.chain, dataIn[i]);
+    }
+    // R/nB is wired to both
+    if (ready) {
+        JTAG_CELL_SET(sim.chain, nWAIT);
+        JTAG_CELL_SET(sim.chain, NCON0);
+    } else {
+        JTAG_CELL_CLR(sim.chain, nWAIT);
+        JTAG_CELL_CLR(sim.chain, NCON0);
+    }
+}
+
+static void SIM_Rising( int tms, int tdi ) {
+    int cell;
+
+    sim.tckCycles++;
+    if (sim.busy)
+        sim.busy--;
+
+    switch (sim.state) {
+        case CAPDR:
+            sim.pos = 0;
+            if (sim.ir == IR_EXTEST || sim.ir == IR_SAMPLE_PRELOAD) {
+                sim.len = S2410_CELLS;
+                SIM_Capture();
+            } else if (sim.ir == IR_IDCODE) {
+                sim.len = 32;
+                sim.chain[0] = JTAG_ID_CPU;
+            } else {
+                sim.len = 1;                // BYPASS
+                sim.chain[0] = 0;
+            }
+            break;
+        case SHDR:
+            cell = sim.pos;
+            if (tdi)
+                JTAG_CELL_SET(sim.chain, cell);
+            else
+                JTAG_CELL_CLR(sim.chain, cell);
+            sim.pos = (sim.pos+1) % sim.len;
+            break;
+        case CAPIR:
+            sim.irShift = 0x1;
+            break;
+        case SHIR:
+            sim.irShift = (sim.irShift >> 1) | (tdi ? 0x8 : 0);
+            break;
+    }
+    sim.state = tapNext[sim.state][tms];
+}
+
+static void SIM_Falling( void ) {
+    SIM_Pins now;
+    int i;
+
+    switch (sim.state) {
+        case TLR:
+            sim.ir = IR_IDCODE;
+            break;
+        case SHDR:
+            sim.tdo = JTAG_CELL_GET(sim.chain, sim.pos);
+            break;
+        case SHIR:
+            sim.tdo = sim.irShift & 1;
+            break;
+        case UPDR:
+            if (sim.len != S2410_CELLS)
+                break;
+            for (i=0 ; i<S2410_CELLS ; i++) {
+                if (JTAG_CELL_GET(sim.chain, (sim.pos+i) % S2410_CELLS))
+                    JTAG_CELL_SET(sim.update, i);
+                else
+                    JTAG_CELL_CLR(sim.update, i);
+            }
+            if (sim.ir == IR_EXTEST) {
+                sim.scans++;
+                SIM_ReadPins(&now);
+                SIM_Update(&now);
+            }
+            break;
+        case UPIR:
+            sim.ir = sim.irShift;
+            if (sim.ir == IR_EXTEST) {
+                SIM_ReadPins(&now);
+            } else {
+                SIM_PinsIdle(&now);
+            }
+            SIM_Update(&now);
+            break;
+    }
+}
+
+/*
+ * Adapter
+ */
+
+static int SIM_ParseList( const char *s, U32 *list, int max ) {
+    int n = 0;
+    char *end;
+    while (*s && n < max) {
+        list[n++] = strtoul(s, &end, 0);
+        if (*end != ':')
+            break;
+        s = end+1;
+    }
+    return n;
+}
+
+static int SimOpen( const char *arg ) {
+    char spec[512], *opt, *val;
+    U32 bad[SIM_MAX_LIST];
+    int nBad = 0, i;
+    long size;
+    FILE *f;
+
+    memset(&sim, 0, sizeof(sim));
+    sim.id = JTAG_ID_K9F5608U0B;
+    sim.tck = 250;
+    sim.tR = 10;
+    sim.tPROG = 200;
+    sim.tBERS = 2000;
+    sim.tRST = 5;
+
+    // strtok() would skip an empty first field and take an option as the file
+    if (arg == NULL || *arg == '\0' || *arg == ',') {
+        printf("sim: no image file given\n");
+        return 0;
+    }
+    if (strlen(arg) >= sizeof(spec)) {
+        printf("sim: -s argument too long\n");
+        return 0;
+    }
+    strcpy(spec, arg);
+    opt = strtok(spec, ",");
+    strncpy(sim.file, opt, sizeof(sim.file)-1);
+    while ((opt = strtok(NULL, ",")) != NULL) {
+        val = strchr(opt, '=');
+        if (val == NULL) {
+            printf("sim: option %s needs a value\n", opt);
+            return 0;
+        }
+        *val++ = '\0';
+        if (strcmp(opt, "id") == 0)
+            sim.id = strtoul(val, NULL, 16);
+        else if (strcmp(opt, "bad") == 0)
+            nBad = SIM_ParseList(val, bad, SIM_MAX_LIST);
+        else if (strcmp(opt, "fail") == 0)
+            sim.nFail = SIM_ParseList(val, sim.fail, SIM_MAX_LIST);
+        else if (strcmp(opt, "tck") == 0)
+            sim.tck = atoi(val);
+        else if (strcmp(opt, "tr") == 0)
+            sim.tR = atoi(val);
+        else if (strcmp(opt, "tprog") == 0)
+            sim.tPROG = atoi(val);
+        else if (strcmp(opt, "tbers") == 0)
+            sim.tBERS = atoi(val);
+        else {
+            printf("sim: unknown option %s\n", opt);
+            return 0;
+        }
+    }
+    if (sim.id == JTAG_ID_K9F2808U0C)
+        sim.blocks = 1024;
+    else if (sim.id == JTAG_ID_K9F5608U0B)
+        sim.blocks = 2048;
+    else {
+        printf("sim: unknown flash id %04X\n", sim.id);
+        return 0;
+    }
+    if (sim.tck == 0)
+        sim.tck = 1;
+    sim.tR = SIM_Cycles(sim.tR);
+    sim.tPROG = SIM_Cycles(sim.tPROG);
+    sim.tBERS = SIM_Cycles(sim.tBERS);
+    sim.tRST = SIM_Cycles(sim.tRST);
+
+    // A missing or short image reads as erased flash
+    size = sim.blocks * SIM_PAGES_PER_BLOCK * SIM_PAGE;
+    sim.image = malloc(size);
+    if (sim.image == NULL) {
+        printf("sim: out of memory\n");
+        return 0;
+    }
+    memset(sim.image, 0xff, size);
+    f = fopen(sim.file, "rb");
+    if (f != NULL) {
+        if (fread(sim.image, 1, size, f) < size)
+            sim.dirty = 1;
+        fclose(f);
+    } else {
+        sim.dirty = 1;
+    }
+    // Factory marks go in the 6th spare byte of the first two pages
+    for (i=0 ; i<nBad ; i++) {
+        if (bad[i] >= sim.blocks)
+            continue;
+        SIM_Page(bad[i]*SIM_PAGES_PER_BLOCK)[517] = 0x00;
+        SIM_Page(bad[i]*SIM_PAGES_PER_BLOCK+1)[517] = 0x00;
+        sim.dirty = 1;
+    }
+
+    sim.state = TLR;
+    sim.ir = IR_IDCODE;
+    sim.len = 1;
+    memset(sim.update, 0xff, sizeof(sim.update));
+    SIM_PinsIdle(&sim.pins);
+    printf("sim: %s, %u blocks, id %04X, TCK %u kHz\n", sim.file, sim.blocks, sim.id, sim.tck);
+    return 1;
+}
+
+static void SimClose( void ) {
+    FILE *f;
+
+    if (sim.image == NULL)
+        return;
+    printf("sim: %u DR scans, %llu TCK cycles (%.1f s at %u kHz), %u page reads, %u programs, %u erases, %u timing violations\n",
+           sim.scans, sim.tckCycles, (double)sim.tckCycles / (sim.tck*1000.0), sim.tck,
+           sim.reads, sim.programs, sim.erases, sim.violations);
+    if (sim.dirty) {
+        f = fopen(sim.file, "wb");
+        if (f == NULL || fwrite(sim.image, SIM_PAGE*SIM_PAGES_PER_BLOCK, sim.blocks, f) != sim.blocks)
+            printf("sim: error writing %s\n", sim.file);
+        if (f != NULL)
+            fclose(f);
+    }
+    free(sim.image);
+    sim.image = NULL;
+}
+
+static void SimOutput( U8 value ) {
+    int was = sim.lastOut & TCK_H, now = value & TCK_H;
+    sim.lastOut = value;
+    if (!was && now)
+        SIM_Rising( (value & TMS_H) != 0, (value & TDI_H) != 0 );
+    else if (was && !now)
+        SIM_Falling();
+}
+
+static U8 SimInput( void ) {
+    return sim.tdo ? 0x00 : 0x80;          // TDO comes in inverted
+}
+
+const JTAG_Adapter simAdapter = {
+    "sim", SimOpen, SimClose, SimOutput, SimInput
+};
@@ -0,0 +1,370 @@
+/*
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github
+ *
+ * This file is part of the sharpfin project
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * lcdd - LCD compositor daemon
+ *
+ * Owns the LCD, and shows the layers sent by clients (see lcdclient.h)
+ * merged by priority, refreshing the display at most once per frame.
+ * Scripts can also write lines of text to a named pipe, which sets
+ * the layer lcdprint uses, without starting a client at all.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include "lcd.h"
+#include "lcdclient.h"
+#include "log.h"
+
+#define LCDD_MAXLAYERS 32
+#define LCDD_FRAME_MS 50		/* Minimum time between refreshes */
+#define LCDD_TICK_MS 300		/* Scrolling interval */
+#define LCDD_IDLETICK_MS 1000		/* Scrolling interval once idle */
+#define LCDD_IDLE_MS 60000		/* Time without updates before idle */
+#define LCDD_FIFO "/tmp/lcdd.fifo"	/* Default pipe, LCDD_FIFO overrides */
+#define LCDD_FIFO_LAYER 1		/* Same layer and priority as lcdprint */
+#define LCDD_FIFO_PRIORITY 50
+#define LCDD_FIFO_LINE (LCDD_MAXROWS*LCDD_ROWLEN)
+
+struct lcdd_layer {
+	int used ;
+	struct lcdd_msg msg ;		/* Latest LCDD_SET for the layer */
+	unsigned long seq ;		/* Order of arrival, newest wins ties */
+	long expires ;			/* Monotonic ms, or 0 for never */
+} ;
+
+static struct lcdd_layer lcdd_layers[LCDD_MAXLAYERS] ;
+static char lcdd_shown[LCDD_MAXROWS][LCDD_ROWLEN] ;
+static char lcdd_fifobuf[LCDD_FIFO_LINE] ;	/* Start of a line still being written */
+static int lcdd_fifolen=0 ;
+static volatile int lcdd_quit=0 ;
+
+/* Returns the monotonic clock in milliseconds */
+static long lcdd_now()
+{
+	struct timespec ts ;
+	clock_gettime(CLOCK_MONOTONIC, &ts) ;
+	return ts.tv_sec*1000L+ts.tv_nsec/1000000L ;
+}
+
+static void lcdd_signal(int sig)
+{
+	lcdd_quit=1 ;
+}
+
+/* Applies a client message, returns true if the layers changed */
+static int lcdd_apply(struct lcdd_msg *m, long now)
+{
+	static unsigned long seq=0 ;
+	struct lcdd_layer *l, *unused=NULL ;
+	int i ;
+
+	for (i=0, l=NULL; i<LCDD_MAXLAYERS; i++) {
+		if (lcdd_layers[i].used && lcdd_layers[i].msg.layer==m->layer) l=&lcdd_layers[i] ;
+		else if (!lcdd_layers[i].used && unused==NULL) unused=&lcdd_layers[i] ;
+	}
+
+	switch (m->cmd) {
+	case LCDD_SET:
+		if (l==NULL) l=unused ;
+		if (l==NULL) {
+			logf(LG_WRN, "too many layers, ignoring layer %d", m->layer) ;
+			return SLCD_FALSE ;
+		}
+		for (i=0; i<LCDD_MAXROWS; i++) m->rows[i][LCDD_ROWLEN-1]='\0' ;
+		l->used=SLCD_TRUE ;
+		l->msg=*m ;
+		l->seq=++seq ;
+		l->expires=(m->timeout>0) ? now+m->timeout : 0 ;
+		return SLCD_TRUE ;
+	case LCDD_CLEAR:
+		if (l==NULL) return SLCD_FALSE ;
+		l->used=SLCD_FALSE ;
+		return SLCD_TRUE ;
+	default:
+		logf(LG_WRN, "unknown command %d", m->cmd) ;
+		return SLCD_FALSE ;
+	}
+}
+
+/* Removes timed out layers, returns true if any were, and sets *next to the next expiry */
+static int lcdd_expire(long now, long *next)
+{
+	int i, changed=SLCD_FALSE ;
+
+	*next=0 ;
+	for (i=0; i<LCDD_MAXLAYERS; i++) {
+		if (!lcdd_layers[i].used || lcdd_layers[i].expires==0) continue ;
+		if (lcdd_layers[i].expires<=now) {
+			lcdd_layers[i].used=SLCD_FALSE ;
+			changed=SLCD_TRUE ;
+		} else if (*next==0 || lcdd_layers[i].expires<*next) {
+			*next=lcdd_layers[i].expires ;
+		}
+	}
+	return changed ;
+}
+
+/* Creates and opens the pipe, returns -1 if there can't be one */
+static int lcdd_fifoopen(char *path)
+{
+	struct stat st ;
+	int fd ;
+
+	if (path[0]=='\0') return -1 ;
+	if (mkfifo(path, 0666)!=0 && errno!=EEXIST) {
+		logf(LG_WRN, "unable to create %s: %s", path, strerror(errno)) ;
+		return -1 ;
+	}
+	if (stat(path, &st)!=0 || !S_ISFIFO(st.st_mode)) {
+		logf(LG_WRN, "%s is not a named pipe", path) ;
+		return -1 ;
+	}
+	chmod(path, 0666) ;
+
+	/* Opened for writing too, so that lcdd never sees the last writer leave */
+	fd=open(path, O_RDWR|O_NONBLOCK) ;
+	if (fd<0) logf(LG_WRN, "unable to open %s: %s", path, strerror(errno)) ;
+	return fd ;
+}
+
+/*
+ * Turns one line from the pipe into a layer update: the rows are
+ * separated by '|', and an empty line clears the layer.
+ */
+static int lcdd_fifoline(char *line, long now)
+{
+	struct lcdd_msg m ;
+	char *next ;
+	int r ;
+
+	memset(&m, 0, sizeof(m)) ;
+	m.magic=LCDD_MAGIC ;
+	m.cmd=(line[0]=='\0') ? LCDD_CLEAR : LCDD_SET ;
+	m.layer=LCDD_FIFO_LAYER ;
+	m.priority=LCDD_FIFO_PRIORITY ;
+	for (r=0; r<LCDD_MAXROWS && line!=NULL && m.cmd==LCDD_SET; r++) {
+		next=strchr(line, '|') ;
+		if (next!=NULL) *next++='\0' ;
+		strncpy(m.rows[r], line, LCDD_ROWLEN-1) ;
+		m.mask|=1<<r ;
+		line=next ;
+	}
+	logf(LG_DBG, "pipe cmd %d mask %x", m.cmd, m.mask) ;
+	return lcdd_apply(&m, now) ;
+}
+
+/* Reads what is waiting in the pipe, returns true if the layers changed */
+static int lcdd_fiforead(int fd, long now)
+{
+	char *line, *nl ;
+	int n, changed=SLCD_FALSE ;
+
+	while ((n=read(fd, lcdd_fifobuf+lcdd_fifolen, sizeof(lcdd_fifobuf)-1-lcdd_fifolen))>0) {
+		lcdd_fifolen+=n ;
+		lcdd_fifobuf[lcdd_fifolen]='\0' ;
+		line=lcdd_fifobuf ;
+		while ((nl=strchr(line, '\n'))!=NULL) {
+			*nl='\0' ;
+			if (nl>line && nl[-1]=='\r') nl[-1]='\0' ;
+			if (lcdd_fifoline(line, now)) changed=SLCD_TRUE ;
+			line=nl+1 ;
+		}
+		lcdd_fifolen-=line-lcdd_fifobuf ;
+		memmove(lcdd_fifobuf, line, lcdd_fifolen) ;
+
+		/* A line longer than the buffer is taken as it is */
+		if (lcdd_fifolen==sizeof(lcdd_fifobuf)-1) {
+			lcdd_fifobuf[lcdd_fifolen]='\0' ;
+			if (lcdd_fifoline(lcdd_fifobuf, now)) changed=SLCD_TRUE ;
+			lcdd_fifolen=0 ;
+		}
+	}
+	return changed ;
+}
+
+/* Merges the layers into the frame, returns true if any row changed */
+static int lcdd_compose(lcd_handle *h)
+{
+	struct lcdd_layer *best ;
+	char *text ;
+	int r, i, changed=SLCD_FALSE ;
+
+	for (r=0; r<lcd_height() && r<LCDD_MAXROWS; r++) {
+		/* Highest priority layer setting this row, newest on a tie */
+		for (i=0, best=NULL; i<LCDD_MAXLAYERS; i++) {
+			if (!lcdd_layers[i].used || (lcdd_layers[i].msg.mask&(1<<r))==0) continue ;
+			if (best==NULL || lcdd_layers[i].msg.priority>best->msg.priority ||
+				(lcdd_layers[i].msg.priority==best->msg.priority && lcdd_layers[i].seq>best->seq))
+				best=&lcdd_layers[i] ;
+		}
+		text=(best!=NULL) ? best->msg.rows[r] : "" ;
+
+		/* Only replace rows that differ, so that the others keep scrolling */
+		if (strcmp(text, lcdd_shown[r])!=0) {
+			strcpy(lcdd_shown[r], text) ;
+			lcd_framesetline(h, r, text) ;
+			changed=SLCD_TRUE ;
+		}
+	}
+	return changed ;
+}
+
+int main(int argc, char **argv) {
+	struct sockaddr_un addr ;
+	struct lcdd_msg msg ;
+	struct timeval tv ;
+	fd_set rfds ;
+	lcd_handle *h ;
+	char *path, *fifo ;
+	int fd, fifofd, c, n, dirty=SLCD_FALSE, background=SLCD_FALSE ;
+	int frame=LCDD_FRAME_MS, tick=LCDD_TICK_MS ;
+	long now, wait, next, lastrefresh ;
+	enum log_level level=LG_WRN ;
+
+	path=getenv("LCDD_SOCKET") ;
+	if (path==NULL) path=LCDD_SOCKET ;
+	fifo=getenv("LCDD_FIFO") ;
+	if (fifo==NULL) fifo=LCDD_FIFO ;
+	while ((c=getopt(argc, argv, "s:p:f:t:dv"))!=-1) {
+		switch (c) {
+		case 's': path=optarg ; break ;
+		case 'p': fifo=optarg ; break ;
+		case 'f': frame=atoi(optarg) ; break ;
+		case 't': tick=atoi(optarg) ; break ;
+		case 'd': background=SLCD_TRUE ; break ;
+		case 'v': level=LG_DBG ; break ;
+		default:
+			fprintf(stderr, "usage: %s [-s socket] [-p fifo] [-f frame_ms] [-t tick_ms] [-d] [-v]\n", argv[0]) ;
+			return 1 ;
+		}
+	}
+	if (frame<1) frame=1 ;
+	if (tick<frame) tick=frame ;
+	if (strlen(path)>=sizeof(addr.sun_path)) {
+		fprintf(stderr, "%s: socket path too long\n", argv[0]) ;
+		return 1 ;
+	}
+	if (background && daemon(0, 0)!=0) {
+		perror("daemon") ;
+		return 1 ;
+	}
+	log_init(argv[0], background ? LOG_TO_SYSLOG : LOG_TO_STDERR, level, 0) ;
+
+	/* Listen for clients, anyone on the radio may draw */
+	fd=socket(AF_UNIX, SOCK_DGRAM, 0) ;
+	if (fd<0) {
+		logf(LG_FTL, "unable to create socket") ;
+		return 1 ;
+	}
+	memset(&addr, 0, sizeof(addr)) ;
+	addr.sun_family=AF_UNIX ;
+	strcpy(addr.sun_path, path) ;
+	unlink(path) ;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr))!=0) {
+		logf(LG_FTL, "unable to bind %s: %s", path, strerror(errno)) ;
+		return 1 ;
+	}
+	chmod(path, 0666) ;
+	fifofd=lcdd_fifoopen(fifo) ;
+
+	signal(SIGTERM, lcdd_signal) ;
+	signal(SIGINT, lcdd_signal) ;
+
+	/* Take over the display */
+	lcd_init() ;
+	lcd_brightness(100) ;
+	lcd_tickrate(tick, (tick>LCDD_IDLETICK_MS) ? tick : LCDD_IDLETICK_MS, LCDD_IDLE_MS) ;
+	h=lcd_framecreate() ;
+	if (h==NULL) return 1 ;
+	lcd_refresh(h) ;
+
+	now=lcdd_now() ;
+	lastrefresh=now-frame ;
+	next=0 ;
+	while (!lcdd_quit) {
+		/* Sleep until the next thing that needs doing, scrolling as lcd_tickwait() says */
+		wait=lcd_tickwait() ;
+		if (wait<0) wait=60000 ;
+		if (dirty && lastrefresh+frame-now<wait) wait=lastrefresh+frame-now ;
+		if (next!=0 && next-now<wait) wait=next-now ;
+		if (wait<0) wait=0 ;
+		tv.tv_sec=wait/1000 ;
+		tv.tv_usec=(wait%1000)*1000 ;
+		FD_ZERO(&rfds) ;
+		FD_SET(fd, &rfds) ;
+		if (fifofd>=0) FD_SET(fifofd, &rfds) ;
+		n=select(((fifofd>fd) ? fifofd : fd)+1, &rfds, NULL, NULL, &tv) ;
+		if (n<0 && errno!=EINTR) {
+			logf(LG_FTL, "select failed: %s", strerror(errno)) ;
+			break ;
+		}
+		now=lcdd_now() ;
+
+		/* Take everything that is waiting, the last update of a layer wins */
+		if (n>0 && fifofd>=0 && FD_ISSET(fifofd, &rfds)) {
+			if (lcdd_fiforead(fifofd, now)) dirty=SLCD_TRUE ;
+		}
+		if (n>0 && FD_ISSET(fd, &rfds)) {
+			while ((n=recv(fd, &msg, sizeof(msg), MSG_DONTWAIT))>0) {
+				if (n!=sizeof(msg) || msg.magic!=LCDD_MAGIC) {
+					logf(LG_WRN, "ignoring bad message (%d bytes)", n) ;
+					continue ;
+				}
+				logf(LG_DBG, "layer %d cmd %d priority %d", msg.layer, msg.cmd, msg.priority) ;
+				if (lcdd_apply(&msg, now)) dirty=SLCD_TRUE ;
+			}
+		}
+		if (lcdd_expire(now, &next)) dirty=SLCD_TRUE ;
+
+		/* One coalesced refresh per frame */
+		if (dirty && now-lastrefresh>=frame) {
+			if (lcdd_compose(h)) {
+				lcd_refresh(h) ;
+				lastrefresh=now ;
+			}
+			dirty=SLCD_FALSE ;
+		} else {
+			lcd_tickauto() ;
+		}
+	}
+
+	close(fd) ;
+	unlink(path) ;
+	if (fifofd>=0) {
+		close(fifofd) ;
+		unlink(fifo) ;
+	}
+	lcd_delete(h) ;
+	lcd_exit() ;
+	return 0;
+}
@@ -26,10 +26,22 @@
 #include <unistd.h>
 #include <string.h>
 #include "lcd.h"
+#include "lcdclient.h"
+
+#define LCDPRINT_LAYER 1
+#define LCDPRINT_PRIORITY 50
 
 int main(int argc, char **argv) {
 	lcd_handle *h ;
-	int r;
+	int r, fd ;
+
+	/* If lcdd owns the display, just hand it the lines */
+	if (!(argc>1 && strcmp(argv[1],"-v")==0) && (fd=lcd_clientopen())>=0) {
+		r=lcd_clientset(fd, LCDPRINT_LAYER, LCDPRINT_PRIORITY, 0, &argv[1], argc-1) ;
+		lcd_clientclose(fd) ;
+		return r ? 0 : 1 ;
+	}
+
 	lcd_init() ;
 	lcd_brightness(100) ;
 	//lcd_contrast(50) ;
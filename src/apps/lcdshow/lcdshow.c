@@ -21,42 +21,367 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+/*
+ * Screen capture.
+ *
+ * The graphics display is grabbed at a fixed rate into one reused frame
+ * buffer.  A frame whose hash matches the last one written is skipped,
+ * the others are written as PBM or PNG files, or as records of a run
+ * length delta stream on stdout, see README.
+ */
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
-#include "lcd.h"
-#include "reciva_lcd.h"
+#include <strings.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include "lcdhw.h"
+
+#define STREAM_MAGIC "LCDS"
+#define STREAM_GAP 3		/* Unchanged bytes worth ending a literal run for */
+
+enum format { FMT_PBM, FMT_PNG, FMT_STREAM } ;
+
+struct capture {
+	int width, height ;
+	int stride, size ;		/* Bytes per row, and per frame */
+	unsigned char *frame ;		/* Grabbed frame */
+	unsigned char *last ;		/* Last frame written, for deltas */
+	unsigned char *out ;		/* Encoding buffer */
+	int outsize ;
+} ;
+
+static volatile int done=0 ;
+static unsigned int crctable[256] ;
+
+static void usage() ;
+static void stop(int sig) ;
+static int checkpattern(const char *pattern) ;
+static unsigned int hashframe(const unsigned char *p, int n) ;
+static long long now() ;
+static int writepbm(FILE *f, struct capture *c) ;
+static int writepng(FILE *f, struct capture *c) ;
+static void pngchunk(FILE *f, const char *type, const unsigned char *data, int n) ;
+static unsigned int crc32(unsigned int crc, const unsigned char *p, int n) ;
+static int writedelta(FILE *f, struct capture *c, long long ms) ;
+static unsigned char *putvarint(unsigned char *p, unsigned int v) ;
+static void put32(unsigned char *p, unsigned int v) ;
 
 int main(int argc,char**argv) {
-	lcd_handle *h ;
-	lcd_init();
-	lcd_brightness(100) ;
-	h=lcd_framecreate() ;
-	lcd_framesetline(h,1,"TEST") ;
-	lcd_refresh(h) ;
-	int top=0,left=0,width=-1,height=-1;
-	if (argc>1) {
-		top=atoi(argv[1]);
-		if (argc>2) {
-			left=atoi(argv[2]);
-		}
-		if (argc>3) {
-			width=atoi(argv[3]);
-		}
-		if (argc>4) {
-			height=atoi(argv[4]);
-		}
-	}
-	struct bitmap_data*bitmap=lcd_grab_region(top,left,width,height);
-	if (bitmap!=NULL) {
-		printf("top: %i, left: %i, width: %i, height: %i\n",bitmap->top,bitmap->left,bitmap->width,bitmap->height);
-	 	printf("data %p\n",bitmap->data);
-	} else {
-		perror("Bitmap data was NULL");
-		lcd_exit() ;
-		exit(1);
-	} 
-	lcd_exit() ;
+	struct capture c ;
+	char *pattern=NULL, fname[256] ;
+	enum format fmt=FMT_PBM ;
+	double rate=5.0 ;
+	long long count=-1, grabs=0, written=0, start, next, t ;
+	unsigned int hash, lasthash=0 ;
+	int all=0, verbose=0, haslast=0, opt, r ;
+	struct timespec ts ;
+	FILE *f ;
+	char *ext ;
+
+	while ((opt=getopt(argc, argv, "r:n:o:sav"))!=-1) {
+		switch (opt) {
+		case 'r': rate=atof(optarg) ; break ;
+		case 'n': count=atoll(optarg) ; break ;
+		case 'o': pattern=optarg ; break ;
+		case 's': fmt=FMT_STREAM ; break ;
+		case 'a': all=1 ; break ;
+		case 'v': verbose=1 ; break ;
+		default: usage() ;
+		}
+	}
+	if (optind!=argc || rate<=0 || (pattern!=NULL && fmt==FMT_STREAM)) usage() ;
+	if (pattern!=NULL) {
+		if (!checkpattern(pattern)) {
+			fprintf(stderr, "lcdshow: file name needs one %%d for the frame number\n") ;
+			return 1 ;
+		}
+		ext=strrchr(pattern, '.') ;
+		if (ext!=NULL && strcasecmp(ext, ".png")==0) fmt=FMT_PNG ;
+	}
+	/* A single frame to stdout unless capturing */
+	if (count<0) count=(pattern==NULL && fmt!=FMT_STREAM) ? 1 : 0 ;
+
+	/* Size the buffers once */
+	memset(&c, 0, sizeof(c)) ;
+	lcd_hwgrabbitmap(NULL, 0, &c.width, &c.height) ;
+	if (c.width<=0 || c.height<=0) {
+		fprintf(stderr, "lcdshow: the display has no graphics\n") ;
+		return 1 ;
+	}
+	c.stride=(c.width+7)/8 ;
+	c.size=c.stride*c.height ;
+	c.outsize=2*c.size+c.height+64 ;
+	c.frame=malloc(c.size) ;
+	c.last=calloc(c.size, 1) ;
+	c.out=malloc(c.outsize) ;
+	if (c.frame==NULL || c.last==NULL || c.out==NULL) {
+		fprintf(stderr, "lcdshow: out of memory\n") ;
+		return 1 ;
+	}
+
+	signal(SIGINT, stop) ;
+	signal(SIGTERM, stop) ;
+	signal(SIGPIPE, stop) ;
+
+	if (fmt==FMT_STREAM) {
+		memcpy(c.out, STREAM_MAGIC, 4) ;
+		c.out[4]=c.width>>8 ; c.out[5]=c.width ;
+		c.out[6]=c.height>>8 ; c.out[7]=c.height ;
+		fwrite(c.out, 1, 8, stdout) ;
+		fflush(stdout) ;
+	}
+
+	start=now() ;
+	next=start ;
+	while (!done && (count==0 || grabs<count)) {
+		if (grabs>0) {
+			/* Wait for the next slot, skipping any that were missed */
+			next+=(long long)(1e9/rate) ;
+			t=now() ;
+			if (next<t) next=t ;
+			ts.tv_sec=next/1000000000LL ;
+			ts.tv_nsec=next%1000000000LL ;
+			while ((r=clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))==EINTR && !done) ;
+			if (done) break ;
+		}
+		if (!lcd_hwgrabbitmap(c.frame, c.size, &c.width, &c.height)) {
+			fprintf(stderr, "lcdshow: unable to grab the screen\n") ;
+			break ;
+		}
+		grabs++ ;
+
+		hash=hashframe(c.frame, c.size) ;
+		if (haslast && hash==lasthash && !all) continue ;
+
+		if (fmt==FMT_STREAM) {
+			if (!writedelta(stdout, &c, (now()-start)/1000000)) break ;
+			fflush(stdout) ;
+		} else if (pattern==NULL) {
+			if (!writepbm(stdout, &c)) break ;
+		} else {
+			snprintf(fname, sizeof(fname), pattern, (int)written) ;
+			f=fopen(fname, "wb") ;
+			if (f==NULL) {
+				perror(fname) ;
+				break ;
+			}
+			r=(fmt==FMT_PNG) ? writepng(f, &c) : writepbm(f, &c) ;
+			if (fclose(f)!=0 || !r) {
+				perror(fname) ;
+				break ;
+			}
+		}
+		memcpy(c.last, c.frame, c.size) ;
+		lasthash=hash ;
+		haslast=1 ;
+		written++ ;
+	}
+
+	if (verbose) {
+		fprintf(stderr, "lcdshow: %lld frames grabbed, %lld written in %.1fs\n",
+			grabs, written, (now()-start)/1e9) ;
+	}
+	free(c.frame) ;
+	free(c.last) ;
+	free(c.out) ;
 	return 0;
 }
+
+static void usage()
+{
+	fprintf(stderr, "usage: lcdshow [-r fps] [-n frames] [-a] [-v] [-o file%%04d.pbm|file%%04d.png | -s]\n") ;
+	exit(1) ;
+}
+
+static void stop(int sig)
+{
+	done=1 ;
+}
+
+/* True if the pattern has exactly one conversion, and it is a %d */
+static int checkpattern(const char *pattern)
+{
+	const char *p ;
+	int n=0 ;
+
+	for (p=pattern; *p!='\0'; p++) {
+		if (*p!='%') continue ;
+		if (p[1]=='%') {
+			p++ ;
+			continue ;
+		}
+		for (p++; *p>='0' && *p<='9'; p++) ;
+		if (*p!='d') return 0 ;
+		n++ ;
+	}
+	return (n==1) ;
+}
+
+/* FNV-1a, enough to spot a changed frame */
+static unsigned int hashframe(const unsigned char *p, int n)
+{
+	unsigned int h=2166136261U ;
+	while (n-->0) {
+		h^=*p++ ;
+		h*=16777619U ;
+	}
+	return h ;
+}
+
+static long long now()
+{
+	struct timespec ts ;
+	clock_gettime(CLOCK_MONOTONIC, &ts) ;
+	return (long long)ts.tv_sec*1000000000LL+ts.tv_nsec ;
+}
+
+/* Binary PBM: rows packed MSB first, 1 is black, which is the frame as it is */
+static int writepbm(FILE *f, struct capture *c)
+{
+	fprintf(f, "P4\n%d %d\n", c->width, c->height) ;
+	fwrite(c->frame, 1, c->size, f) ;
+	return (fflush(f)==0) ;
+}
+
+/*
+ * 1 bit greyscale PNG.  The frame is only a few hundred bytes, so the
+ * image data is zlib 'stored' blocks rather than compressed, which
+ * needs no library.  Greyscale 0 is black, so the pixels are inverted.
+ */
+static int writepng(FILE *f, struct capture *c)
+{
+	static const unsigned char sig[8]={ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' } ;
+	unsigned char ihdr[13], *p, *raw ;
+	unsigned int a=1, b=0 ;
+	int y, x, n, rawsize, block ;
+
+	put32(ihdr, c->width) ;
+	put32(ihdr+4, c->height) ;
+	ihdr[8]=1 ;		/* Bit depth */
+	ihdr[9]=0 ;		/* Greyscale */
+	ihdr[10]=ihdr[11]=ihdr[12]=0 ;
+
+	/* Filter type 0 and the inverted row, for each row, at the end of out */
+	rawsize=c->height*(c->stride+1) ;
+	raw=c->out+c->outsize-rawsize ;
+	for (y=0; y<c->height; y++) {
+		raw[y*(c->stride+1)]=0 ;
+		for (x=0; x<c->stride; x++) raw[y*(c->stride+1)+1+x]=~c->frame[y*c->stride+x] ;
+	}
+	for (x=0; x<rawsize; x++) {
+		a=(a+raw[x])%65521 ;
+		b=(b+a)%65521 ;
+	}
+
+	/* zlib stream of stored blocks, written in front of the raw data */
+	p=c->out ;
+	*p++=0x78 ;
+	*p++=0x01 ;
+	for (x=0; x<rawsize; x+=n) {
+		n=rawsize-x ;
+		if (n>65535) n=65535 ;
+		block=(x+n==rawsize) ;
+		*p++=block ;
+		*p++=n&0xff ;
+		*p++=n>>8 ;
+		*p++=~n&0xff ;
+		*p++=(~n>>8)&0xff ;
+		memmove(p, raw+x, n) ;
+		p+=n ;
+	}
+	put32(p, (b<<16)|a) ;
+	p+=4 ;
+
+	fwrite(sig, 1, sizeof(sig), f) ;
+	pngchunk(f, "IHDR", ihdr, sizeof(ihdr)) ;
+	pngchunk(f, "IDAT", c->out, p-c->out) ;
+	pngchunk(f, "IEND", NULL, 0) ;
+	return (fflush(f)==0) ;
+}
+
+static void pngchunk(FILE *f, const char *type, const unsigned char *data, int n)
+{
+	unsigned char buf[4] ;
+	unsigned int crc ;
+
+	put32(buf, n) ;
+	fwrite(buf, 1, 4, f) ;
+	fwrite(type, 1, 4, f) ;
+	if (n>0) fwrite(data, 1, n, f) ;
+	crc=crc32(crc32(0xffffffffU, (const unsigned char *)type, 4), data, n) ;
+	put32(buf, crc^0xffffffffU) ;
+	fwrite(buf, 1, 4, f) ;
+}
+
+static unsigned int crc32(unsigned int crc, const unsigned char *p, int n)
+{
+	unsigned int c ;
+	int i, k ;
+
+	if (crctable[1]==0) {
+		for (i=0; i<256; i++) {
+			for (c=i, k=0; k<8; k++) c=(c&1) ? 0xedb88320U^(c>>1) : c>>1 ;
+			crctable[i]=c ;
+		}
+	}
+	while (n-->0) crc=crctable[(crc^*p++)&0xff]^(crc>>8) ;
+	return crc ;
+}
+
+/*
+ * One delta stream record: the time in ms and the payload length as
+ * 32 bit big endian numbers, then runs of (unchanged bytes, changed
+ * bytes) as varints, each followed by the changed bytes.  The first
+ * record is relative to a blank frame.
+ */
+static int writedelta(FILE *f, struct capture *c, long long ms)
+{
+	unsigned char *p=c->out+8 ;
+	int i=0, skip, lit, gap ;
+
+	while (i<c->size) {
+		for (skip=0; i<c->size && c->frame[i]==c->last[i]; i++) skip++ ;
+		if (i==c->size) break ;
+
+		/* Changed bytes, taking in short unchanged gaps */
+		for (lit=i; i<c->size; ) {
+			if (c->frame[i]!=c->last[i]) {
+				i++ ;
+				continue ;
+			}
+			for (gap=0; i+gap<c->size && gap<STREAM_GAP && c->frame[i+gap]==c->last[i+gap]; gap++) ;
+			if (gap==STREAM_GAP || i+gap==c->size) break ;
+			i+=gap ;
+		}
+		p=putvarint(p, skip) ;
+		p=putvarint(p, i-lit) ;
+		memcpy(p, c->frame+lit, i-lit) ;
+		p+=i-lit ;
+	}
+	put32(c->out, (unsigned int)ms) ;
+	put32(c->out+4, p-c->out-8) ;
+	return (fwrite(c->out, 1, p-c->out, f)==(size_t)(p-c->out)) ;
+}
+
+/* LEB128: 7 bits a byte, low bits first, top bit set on all but the last */
+static unsigned char *putvarint(unsigned char *p, unsigned int v)
+{
+	while (v>=0x80) {
+		*p++=(v&0x7f)|0x80 ;
+		v>>=7 ;
+	}
+	*p++=v ;
+	return p ;
+}
+
+static void put32(unsigned char *p, unsigned int v)
+{
+	p[0]=v>>24 ;
+	p[1]=v>>16 ;
+	p[2]=v>>8 ;
+	p[3]=v ;
+}
@@ -21,30 +21,251 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+/*
+ * Key to display latency.
+ *
+ * Each key event carries its input event time.  The key is applied to a
+ * workload screen, and the time lcd_refresh() returns, which is right
+ * after the IOC_LCD_DRAW_SCREEN ioctl that shows the result, is compared
+ * with it.  The latency is split into the wait until key_poll() returned
+ * the key, and the time taken to update and draw the screen.
+ *
+ * Between keys the program blocks in select() on the key devices, so
+ * the wait is not padded by a polling interval.  The event times are on
+ * the wall clock, which steps when NTP syncs: keys that would come out
+ * negative are counted and left out of the figures.
+ */
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/select.h>
 #include "lcd.h"
 #include "key.h"
+
+struct samples {
+	char *name ;
+	long *us ;
+	int n, size ;
+} ;
+
+enum workload { WL_FRAME, WL_MENU, WL_VMENU } ;
+
+static volatile int done=0 ;
+
+static void usage() ;
+static void stop(int sig) ;
+static long tvdiff(struct timeval *from, struct timeval *to) ;
+static void waitkeys(struct key_handler *eh, long us, int pollus) ;
+static void addsample(struct samples *s, long us) ;
+static void report(struct samples *s) ;
+static int cmplong(const void *a, const void *b) ;
+static int vmenuentry(void *data, int index, int *idnumber, char *buf, int maxlen) ;
+
 int main(int argc, char **argv) {
 	struct key_handler *eh;
 	struct key ev;
-	lcd_handle *h ;
-	int r;
+	lcd_handle *h, *menu=NULL, *frame ;
+	struct samples total={ "total" }, wait={ "wait" }, draw={ "draw" } ;
+	struct timeval polled, drawn, lastkey ;
+	enum workload wl=WL_FRAME ;
+	int entries=-1, pollus=10000, maxkeys=0, idle=0, quiet=0, stepped=0 ;
+	long waitus, drawus ;
+	int c, i, r ;
+
+	while ((c=getopt(argc, argv, "w:n:u:k:t:q"))!=-1) {
+		switch (c) {
+		case 'w':
+			if (strcmp(optarg, "frame")==0) wl=WL_FRAME ;
+			else if (strcmp(optarg, "menu")==0) wl=WL_MENU ;
+			else if (strcmp(optarg, "vmenu")==0) wl=WL_VMENU ;
+			else usage() ;
+			break ;
+		case 'n': entries=atoi(optarg) ; break ;
+		case 'u': pollus=atoi(optarg) ; break ;
+		case 'k': maxkeys=atoi(optarg) ; break ;
+		case 't': idle=atoi(optarg) ; break ;
+		case 'q': quiet=1 ; break ;
+		default: usage() ;
+		}
+	}
+	if (optind!=argc || pollus<0) usage() ;
+	if (entries<=0) entries=(wl==WL_VMENU) ? 10000 : 50 ;
+
+	signal(SIGINT, stop) ;
+	signal(SIGTERM, stop) ;
+
 	lcd_init() ;
 	eh = key_init();
-	h=lcd_framecreate() ;
-	while(1) {
+	if (eh==NULL) {
+		fprintf(stderr, "recivatest: no key devices\n") ;
+		lcd_exit() ;
+		return 1 ;
+	}
+
+	/* The screen the keys act on */
+	frame=lcd_framecreate() ;
+	if (wl==WL_MENU) {
+		menu=lcd_menucreate() ;
+		for (i=0; i<entries; i++) {
+			char buf[32] ;
+			snprintf(buf, sizeof(buf), "Entry %d", i) ;
+			lcd_menuaddentry(menu, i, buf, (i==0)?SLCD_SELECTED:SLCD_NOTSELECTED) ;
+		}
+	} else if (wl==WL_VMENU) {
+		menu=lcd_vmenucreate(entries, vmenuentry, NULL) ;
+	}
+	h=(menu!=NULL) ? menu : frame ;
+	lcd_frameprintf(frame, 0, "Press a key") ;
+	lcd_refresh(h) ;
+
+	gettimeofday(&lastkey, NULL) ;
+	while (!done && (maxkeys==0 || total.n<maxkeys)) {
 		r = key_poll(eh, &ev);
-		if(r == 1) {
+		if (r!=1) {
+			gettimeofday(&polled, NULL) ;
+			if (idle>0 && tvdiff(&lastkey, &polled)>=idle*1000000L) break ;
+			waitkeys(eh, (idle>0) ? idle*1000000L-tvdiff(&lastkey, &polled) : -1, pollus) ;
+			continue ;
+		}
+		gettimeofday(&polled, NULL) ;
+		lastkey=polled ;
+
+		/* Apply the key, skipping the ones that change nothing */
+		if (menu==NULL) {
 			lcd_frameprintf(h, 0, "Key: %d", ev.id) ;
 			lcd_frameprintf(h, 1, "State: %d", ev.state) ;
-			lcd_refresh(h) ;
-			fprintf(stderr,"key %d state %d\n", ev.id, ev.state);
+			lcd_frameprintf(h, 2, "Count: %d", ev.count) ;
+		} else if (ev.state!=KEY_STATE_PRESSED) {
+			continue ;
+		} else if (h==menu && (ev.id==KEY_ID_LEFT || ev.id==KEY_ID_VOLUP)) {
+			for (i=0; i<ev.count; i++) lcd_menucontrol(menu, SLCD_UP) ;
+		} else if (h==menu && (ev.id==KEY_ID_RIGHT || ev.id==KEY_ID_VOLDN)) {
+			for (i=0; i<ev.count; i++) lcd_menucontrol(menu, SLCD_DOWN) ;
+		} else if (h==menu && ev.id==KEY_ID_SELECT) {
+			lcd_framesetline(frame, 0, "Selected") ;
+			lcd_frameprintf(frame, 1, "%s", lcd_menugetsels(menu)) ;
+			h=frame ;
+		} else if (h==frame && ev.id==KEY_ID_BACK) {
+			h=menu ;
+		} else {
+			continue ;
+		}
+		lcd_refresh(h) ;
+		gettimeofday(&drawn, NULL) ;
+
+		/* A clock step between the event and now shows as a negative time */
+		waitus=tvdiff(&ev.time, &polled) ;
+		drawus=tvdiff(&polled, &drawn) ;
+		if (waitus<0 || drawus<0) {
+			stepped++ ;
+			if (!quiet) fprintf(stderr, "key %d state %d count %d not measured, the clock stepped\n",
+				ev.id, ev.state, ev.count) ;
+			continue ;
+		}
+		addsample(&total, waitus+drawus) ;
+		addsample(&wait, waitus) ;
+		addsample(&draw, drawus) ;
+		if (!quiet) {
+			fprintf(stderr,"key %d state %d count %d latency %.3fms\n", ev.id, ev.state, ev.count,
+				total.us[total.n-1]/1000.0);
 		}
-		usleep(10000);
 	}
 
+	report(&total) ;
+	report(&wait) ;
+	report(&draw) ;
+	if (stepped>0) printf("%d keys not measured, the clock stepped\n", stepped) ;
+
+	if (menu!=NULL) lcd_delete(menu) ;
+	lcd_delete(frame) ;
+	key_exit(eh) ;
 	lcd_exit() ;
 	return 0;
 }
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: recivatest [-w frame|menu|vmenu] [-n entries] [-u pollus] [-k keys] [-t idlesecs] [-q]\n") ;
+	exit(1) ;
+}
+
+static void stop(int sig)
+{
+	done=1 ;
+}
+
+/* Microseconds from one time to another */
+static long tvdiff(struct timeval *from, struct timeval *to)
+{
+	return (to->tv_sec-from->tv_sec)*1000000L+(to->tv_usec-from->tv_usec) ;
+}
+
+/*
+ * Waits up to us microseconds (for ever if negative) for input on the
+ * key devices, or until a signal.  A handler without devices, as with
+ * the virtual keys, is polled every pollus microseconds instead.
+ */
+static void waitkeys(struct key_handler *eh, long us, int pollus)
+{
+	fd_set fds ;
+	struct timeval tv ;
+	int i, fdmax=-1 ;
+
+	FD_ZERO(&fds) ;
+	for (i=0; i<EVENT_FD_COUNT; i++) {
+		if (eh->fd[i]==-1) continue ;
+		FD_SET(eh->fd[i], &fds) ;
+		if (eh->fd[i]>fdmax) fdmax=eh->fd[i] ;
+	}
+	if (fdmax<0) {
+		usleep(pollus) ;
+		return ;
+	}
+	tv.tv_sec=us/1000000L ;
+	tv.tv_usec=us%1000000L ;
+	select(fdmax+1, &fds, NULL, NULL, (us<0) ? NULL : &tv) ;
+}
+
+static void addsample(struct samples *s, long us)
+{
+	long *p ;
+	if (s->n==s->size) {
+		p=realloc(s->us, sizeof(long)*(s->size+1024)) ;
+		if (p==NULL) return ;
+		s->us=p ;
+		s->size+=1024 ;
+	}
+	s->us[s->n++]=us ;
+}
+
+/* Prints the median, 99th percentile and maximum, by nearest rank */
+static void report(struct samples *s)
+{
+	if (s->n==0) {
+		printf("%-6s      0 keys\n", s->name) ;
+		return ;
+	}
+	qsort(s->us, s->n, sizeof(long), cmplong) ;
+	printf("%-6s %6d keys  p50 %8.3fms  p99 %8.3fms  max %8.3fms\n", s->name, s->n,
+		s->us[(s->n*50+99)/100-1]/1000.0, s->us[(s->n*99+99)/100-1]/1000.0,
+		s->us[s->n-1]/1000.0) ;
+}
+
+static int cmplong(const void *a, const void *b)
+{
+	long x=*(const long *)a, y=*(const long *)b ;
+	return (x>y)-(x<y) ;
+}
+
+/* Virtual menu entries, generated as they are shown */
+static int vmenuentry(void *data, int index, int *idnumber, char *buf, int maxlen)
+{
+	*idnumber=index ;
+	snprintf(buf, maxlen, "Station %05d", index) ;
+	return SLCD_TRUE ;
+}
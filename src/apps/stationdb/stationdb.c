@@ -0,0 +1,105 @@
+/* 
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github 
+ *
+ * This file is part of the sharpfin project
+ *  
+ * This Library is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "log.h"
+#include "stationdb.h"
+
+/* One station, in the format of the station list */
+static void stationdb_print(stationdb *db, int s) {
+	const unsigned int *g ;
+	int i, n ;
+
+	printf("%s|%s|", stationdb_id(db, s), stationdb_name(db, s)) ;
+	n=stationdb_stationgenres(db, s, &g) ;
+	for (i=0; i<n; i++) printf("%s%s", i ? "," : "", stationdb_genrename(db, g[i])) ;
+	printf("|%s\n", stationdb_url(db, s)) ;
+}
+
+static int usage(void) {
+	fprintf(stderr,
+		"stationdb build index [stationlist]\n"
+		"stationdb list index\n"
+		"stationdb find index id\n"
+		"stationdb prefix index text\n"
+		"stationdb genres index\n"
+		"stationdb genre index name\n") ;
+	return 1 ;
+}
+
+int main(int argc, char **argv) {
+	stationdb *db ;
+	const unsigned int *st ;
+	FILE *in=stdin ;
+	int i, n, first ;
+
+	log_init("stationdb", LOG_TO_STDERR, LG_WRN, 0) ;
+	if (argc<3) return usage() ;
+
+	if (strcmp(argv[1], "build")==0) {
+		if (argc>3 && (in=fopen(argv[3], "r"))==NULL) {
+			perror(argv[3]) ;
+			return 1 ;
+		}
+		n=stationdb_build(in, argv[2]) ;
+		if (in!=stdin) fclose(in) ;
+		return (n<0) ? 1 : 0 ;
+	}
+
+	db=stationdb_open(argv[2]) ;
+	if (db==NULL) return 1 ;
+	n=0 ;
+	first=0 ;
+	if (strcmp(argv[1], "list")==0) {
+		n=stationdb_count(db) ;
+		for (i=0; i<n; i++) stationdb_print(db, i) ;
+	} else if (strcmp(argv[1], "genres")==0) {
+		n=stationdb_genrecount(db) ;
+		for (i=0; i<n; i++) printf("%s|%d\n", stationdb_genrename(db, i), stationdb_genrestations(db, i, &st)) ;
+	} else if (argc<4) {
+		stationdb_close(db) ;
+		return usage() ;
+	} else if (strcmp(argv[1], "find")==0) {
+		first=stationdb_find(db, argv[3]) ;
+		if (first>=0) {
+			stationdb_print(db, first) ;
+			n=1 ;
+		}
+	} else if (strcmp(argv[1], "prefix")==0) {
+		n=stationdb_prefix(db, argv[3], &first) ;
+		for (i=first; i<first+n; i++) stationdb_print(db, i) ;
+	} else if (strcmp(argv[1], "genre")==0) {
+		first=stationdb_findgenre(db, argv[3]) ;
+		if (first>=0) n=stationdb_genrestations(db, first, &st) ;
+		for (i=0; i<n; i++) stationdb_print(db, st[i]) ;
+	} else {
+		stationdb_close(db) ;
+		return usage() ;
+	}
+	stationdb_close(db) ;
+
+	/* Like grep: fail when nothing was found */
+	return (n>0) ? 0 : 1 ;
+}
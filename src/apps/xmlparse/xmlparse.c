@@ -1,21 +1,21 @@
-/* 
+/*
  * Sharpfin project
  * Copyright (C) by Steve Clarke
  * 2011-11-30 Philipp Schmidt
- *   Added to github 
+ *   Added to github
  *
  * This file is part of the sharpfin project
- *  
- * This Library is free software: you can redistribute it and/or modify 
- * it under the terms of the GNU General Public License as published by 
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation, either version 3 of the License, or
  * (at your option) any later version.
- * 
+ *
  * This Library is distributed in the hope that it will be useful,
  * but WITHOUT ANY WARRANTY; without even the implied warranty of
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  * GNU General Public License for more details.
- *  
+ *
  * You should have received a copy of the GNU General Public License
  * along with this source files. If not, see
  * <http://www.gnu.org/licenses/>.
@@ -24,8 +24,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#define DEBUG(s,t,u) printf(s,t,u)
-//#define DEBUG(s,t,y)
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // Configuration File Functions
 #define CFG_NOCMD 0
@@ -39,30 +43,87 @@
 #define CFG_LOOPUNTILEOF 8
 #define CFG_END 9
 
-void readcfg(FILE *fp) ;
-int getcommand() ;
-char *getdata() ;
-void gotoline() ;
-void nextline() ;
+//
+// The parse.cfg is compiled once into a program: labels are dropped,
+// each loopuntileof holds the index of the instruction it jumps to, and
+// print strings are split into literal text and $0-$9 references.
+//
+struct piece {
+  const char *text ;            // Literal text, or NULL for an argument
+  int len ;                     // Length of text, or argument number
+} ;
+
+struct insn {
+  int cmd ;
+  char *data ;
+  int datalen ;
+  int target ;                  // loopuntileof: instruction to jump to
+  char *text ;                  // print: literal text of the pieces
+  struct piece *pieces ;
+  int npieces ;
+} ;
 
-int currline ;
+struct program {
+  struct insn *insn ;
+  int ninsn ;
+} ;
+
+struct program *compilecfg(FILE *fp) ;
+void freecfg(struct program *prg) ;
 
 // Source File Functions
-char *getthing(FILE *fp) ;
-int istag() ;
-char *thing() ;
-char *thingattribute(char *attribute) ;
-int end() ;
+//
+// The input is mapped (or read) whole, and every 'thing' is a range in
+// it: a tag from '<' up to the '>', or a word up to white space or the
+// next '<'.  Double quotes hide delimiters.  White space inside a thing
+// reads as ' ', and only things that are printed are copied out.
+//
+struct input {
+  const unsigned char *buf ;
+  size_t len ;
+  size_t pos ;
+  void *map ;                   // buf when mmapped, else NULL
+  int eof ;                     // A read went past the end
+  int end ;                     // getthing found nothing left
+  size_t start ;                // Current thing
+  size_t thinglen ;
+  int tag ;
+  char *text ;                  // Current thing as a string, see lastthing()
+  size_t textsize ;
+  int textvalid ;
+  char *attr ;                  // Reply of thingattribute()
+  size_t attrsize ;
+} ;
+
+struct input *openinput(const char *fname) ;
+void closeinput(struct input *in) ;
+void getthing(struct input *in) ;
+int thingis(struct input *in, const char *data, int datalen) ;
+char *lastthing(struct input *in) ;
+char *thing(struct input *in) ;
+char *thingattribute(struct input *in, char *attribute) ;
+void run(struct program *prg, struct input *in, char **args, int nargs, FILE *out) ;
 #define iswhite(c) (c==' ' || c=='\n' || c=='\t' || c=='\r')
 
+// Memory Functions
+void *xrealloc(void *p, size_t size) ;
+void *xcalloc(size_t n, size_t size) ;
+char *xstrdup(const char *s) ;
+
+// Batch Functions
+int batch(int argc, char *argv[]) ;
+
 /*
  * Main
  */
 int main(int argc, char *argv[]) {
-  FILE *src, *cfg ;
-  int finished=(1==0) ;
+  FILE *cfg ;
+  struct input *src ;
+  struct program *prg ;
+  if (argc>1 && strcmp(argv[1], "-b")==0) return batch(argc, argv) ;
   if (argc<3) {
-    printf("xmlparse parse.cfg filename [arg0 ... ]\n\n") ;
+    printf("xmlparse parse.cfg filename [arg0 ... ]\n") ;
+    printf("xmlparse -b [-j jobs] [-t | -o dir] parse.cfg input ... [-- arg0 ... ]\n\n") ;
     printf("parse.cfg format\n---------------\n\n") ;
     printf("  :label\n") ;
     printf("  searchfortag tag\n") ;
@@ -77,296 +138,734 @@ int main(int argc, char *argv[]) {
     printf("  also, $. => space, $$ => $ and $n => \\n\n\n") ;
     return 1 ;
   }
-  src=fopen(argv[2],"r") ;
+  src=openinput(argv[2]) ;
   cfg=fopen(argv[1],"r") ;
 
   if (src==NULL || cfg==NULL) {
     fprintf(stderr, "xmlparse: unable to open file(s)\n") ;
     return 1 ;
   }
-  readcfg(cfg) ;
+  prg=compilecfg(cfg) ;
+  fclose(cfg) ;
+  run(prg, src, &argv[3], argc-3, stdout) ;
+  closeinput(src) ;
+  freecfg(prg) ;
+  return 0 ;
+}
+
+// Memory Functions
+
+//
+// There is nothing to fall back on without memory, so these report it
+// and exit instead of returning NULL
+//
+void *xrealloc(void *p, size_t size) {
+  void *n=realloc(p, size) ;
+  if (n==NULL) {
+    fprintf(stderr, "xmlparse: out of memory\n") ;
+    exit(1) ;
+  }
+  return n ;
+}
+
+void *xcalloc(size_t n, size_t size) {
+  void *p=calloc(n, size) ;
+  if (p==NULL) {
+    fprintf(stderr, "xmlparse: out of memory\n") ;
+    exit(1) ;
+  }
+  return p ;
+}
+
+char *xstrdup(const char *s) {
+  size_t len=strlen(s)+1 ;
+  return memcpy(xrealloc(NULL, len), s, len) ;
+}
+
+/*
+ * Run the program over one input
+ */
+void run(struct program *prg, struct input *in, char **args, int nargs, FILE *out) {
+  struct insn *i ;
+  int pc=0, p ;
+  int finished=(1==0) ;
   do {
-    switch(getcommand()) {
-    case CFG_LABEL:
-    case CFG_NOCMD:
-           nextline() ;
-           break ;
+    i=&prg->insn[pc] ;
+    switch(i->cmd) {
     case CFG_SEARCHFORTAG:
       do {
-        getthing(src) ;
-      } while ( (!istag() || strcmp(thing(), getdata())!=0) && !end()) ;
-      nextline() ;
+        getthing(in) ;
+      } while ( (!in->tag || !thingis(in, i->data, i->datalen)) && !in->end) ;
+      pc++ ;
       break ;
     case CFG_PRINTUNTILTAG:
-      getthing(src) ;
-      if (!end() && !istag()) printf("%s",thing()) ;
-      while (!end() && !(istag() && strcmp(thing(), getdata())==0)) {
-        getthing(src) ;
-        if (!istag()) printf(" %s", thing()) ;
+      getthing(in) ;
+      if (!in->end && !in->tag) fputs(thing(in), out) ;
+      while (!in->end && !(in->tag && thingis(in, i->data, i->datalen))) {
+        getthing(in) ;
+        if (!in->tag) {
+          putc(' ', out) ;
+          fputs(thing(in), out) ;
+        }
       }
-      nextline() ;
+      pc++ ;
       break ;
     case CFG_PRINTATTRIBUTE:
-      printf("%s", thingattribute(getdata())) ;
-      nextline() ;
+      fputs(thingattribute(in, i->data), out) ;
+      pc++ ;
       break ;
-    case CFG_PRINT: {
-        char *b ;
-        for (b=getdata() ; *b!='\0'; b++) {
-          // Argv Entry
-          if (*b=='$') {
-            if (*(b+1)!='\0') b++ ;
-            switch (*b) {
-            case '$':
-              printf("$") ;
-              break ;
-            case '0':
-              if (argc>=3) printf(argv[3]) ;    
-              break ;
-            case '1':
-              if (argc>=4) printf(argv[4]) ;
-              break ;
-            case '2':
-              if (argc>=5) printf(argv[5]) ;
-              break ;
-            case '3':
-              if (argc>=6) printf(argv[6]) ;
-              break ;
-            case '4':
-              if (argc>=7) printf(argv[7]) ;
-              break ;
-            case '5':
-              if (argc>=8) printf(argv[8]) ;
-              break ;
-            case '6':
-              if (argc>=9) printf(argv[9]) ;
-              break ;
-            case '7':
-              if (argc>=10) printf(argv[10]) ;
-              break ;
-            case '8':
-              if (argc>=11) printf(argv[11]) ;
-              break ;
-            case '9':
-              if (argc>=12) printf(argv[12]) ;
-              break ;
-            case 'n':
-              printf("\n") ;
-              break ;
-            case '.':
-              printf(" ") ;
-              break ;
-            }
-          } else {
-            printf("%c", *b) ;
-          }
+    case CFG_PRINT:
+      for (p=0; p<i->npieces; p++) {
+        if (i->pieces[p].text!=NULL) {
+          fwrite(i->pieces[p].text, 1, i->pieces[p].len, out) ;
+        } else if (i->pieces[p].len<nargs) {
+          fputs(args[i->pieces[p].len], out) ;
         }
       }
-      nextline() ;
+      pc++ ;
       break ;
     case CFG_SEARCHFORSTR:
       do {
-        getthing(src) ;
-      } while (strcmp(thing(), getdata())==0 && !end()) ;
-      nextline() ;
+        getthing(in) ;
+      } while (thingis(in, i->data, i->datalen) && !in->end) ;
+      pc++ ;
       break ;
     case CFG_PRINTUNTILSTR:
-      getthing(src) ;
-      while (!end() && strcmp(thing(), getdata())!=0) {
-        printf(" %s", thing()) ;
-        getthing(src) ;
+      getthing(in) ;
+      while (!in->end && !thingis(in, i->data, i->datalen)) {
+        putc(' ', out) ;
+        fputs(thing(in), out) ;
+        getthing(in) ;
       }
-      nextline() ;
+      pc++ ;
       break ;
     case CFG_LOOPUNTILEOF:
-      if (!end()) gotoline() ;
-      else nextline() ;
+      if (!in->end) pc=i->target ;
+      else pc++ ;
       break ;
     case CFG_END:
       finished=(1==1) ;
       break ;
     }
-  } while (!end() && !finished) ;
- fclose(src) ;
- fclose(cfg) ;
- return 0 ;
+  } while (!in->end && !finished) ;
 }
 
 // Source Data Functions
-#define THINGLEN 1024
-char lastthing[THINGLEN+1] ;
-int enddetected ;
-int end() {
-  return enddetected ;
+
+//
+// Scanner tables: the characters that may end a word, and a tag.  Both
+// include '"', which switches quoting on, after which only the closing
+// '"' is looked for.
+//
+static unsigned char stopword[256] = {
+  ['\t']=1, ['\n']=1, ['\r']=1, [' ']=1, ['"']=1, ['<']=1
+} ;
+static unsigned char stoptag[256] = {
+  ['"']=1, ['>']=1
+} ;
+
+struct input *openinput(const char *fname) {
+  struct input *in ;
+  struct stat st ;
+  unsigned char *b ;
+  size_t size ;
+  ssize_t r ;
+  int fd ;
+
+  fd=open(fname, O_RDONLY) ;
+  if (fd<0) return NULL ;
+  in=xcalloc(1, sizeof(*in)) ;
+
+  // Map regular files, read anything else (pipes, devices) into memory
+  if (fstat(fd, &st)==0 && S_ISREG(st.st_mode) && st.st_size>0) {
+    in->map=mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) ;
+    if (in->map!=MAP_FAILED) {
+      madvise(in->map, st.st_size, MADV_SEQUENTIAL) ;
+      in->buf=in->map ;
+      in->len=st.st_size ;
+      close(fd) ;
+      return in ;
+    }
+    in->map=NULL ;
+  }
+  size=65536 ;
+  b=xrealloc(NULL, size) ;
+  while ((r=read(fd, b+in->len, size-in->len))>0) {
+    in->len+=r ;
+    if (in->len==size) b=xrealloc(b, size*=2) ;
+  }
+  in->buf=b ;
+  close(fd) ;
+  return in ;
 }
 
-char *getthing(FILE *fp) {
- int i, ch, inquotes=(1==0), endchar, endchar2 ;
- i=0 ;
- if (feof(fp)) {
-   enddetected=(1==1) ;
-   lastthing[0]='\0' ;
-   return lastthing ;
- }
- enddetected=(1==0) ;
-
- // Skip white space
-  do {
-    ch=fgetc(fp) ;
-  } while (iswhite(ch)) ;
-
- // Decide where we stop
- if (ch=='<') { endchar='>' ; endchar2='>' ; }
- else { endchar=' ' ; endchar2='<' ; }
-
- // Process tring
- i=0 ;
- if (ch!=EOF) do {
-   if (ch=='\"') inquotes=!inquotes ;
-   lastthing[i++]=ch ;
-   ch=fgetc(fp) ;
-   if (iswhite(ch)) ch=' ' ;
- } while (ch!=EOF && (inquotes || (ch!=endchar && ch!=endchar2)) ) ;
- lastthing[i]='\0' ;
- if (ch=='<') ungetc(ch, fp);
- return (lastthing) ;  
+void closeinput(struct input *in) {
+  if (in->map!=NULL) munmap(in->map, in->len) ;
+  else free((void *)in->buf) ;
+  free(in->text) ;
+  free(in->attr) ;
+  free(in) ;
+}
+
+/*
+ * Step to the next thing.  The end is reported by the call after the
+ * one that reached the end of the input, as feof() would.
+ */
+void getthing(struct input *in) {
+  const unsigned char *b=in->buf, *q ;
+  const unsigned char *stop ;
+  size_t p=in->pos, n=in->len ;
+  int inquotes=(1==0) ;
+
+  in->textvalid=(1==0) ;
+  in->thinglen=0 ;
+  in->tag=(1==0) ;
+  if (in->eof) {
+    in->end=(1==1) ;
+    return ;
+  }
+  in->end=(1==0) ;
+
+  // Skip white space
+  while (p<n && iswhite(b[p])) p++ ;
+  in->start=p ;
+  if (p>=n) {
+    in->eof=(1==1) ;
+    in->pos=p ;
+    return ;
+  }
+
+  // Decide where we stop
+  in->tag=(b[p]=='<') ;
+  stop=in->tag ? stoptag : stopword ;
+  if (b[p]=='\"') inquotes=(1==1) ;
+  p++ ;
+
+  while (p<n) {
+    if (inquotes) {
+      q=memchr(b+p, '\"', n-p) ;
+      if (q==NULL) break ;
+      p=(q-b)+1 ;
+      inquotes=(1==0) ;
+      continue ;
+    }
+    while (p<n && !stop[b[p]]) p++ ;
+    if (p>=n) break ;
+    if (b[p]=='\"') {
+      p++ ;
+      inquotes=(1==1) ;
+      continue ;
+    }
+    // Found the end, a '<' belongs to the next thing
+    in->thinglen=p-in->start ;
+    in->pos=(b[p]=='<') ? p : p+1 ;
+    return ;
+  }
+  in->thinglen=n-in->start ;
+  in->pos=n ;
+  in->eof=(1==1) ;
+}
+
+/*
+ * Same as strcmp(thing(), data)==0, without copying the thing
+ */
+int thingis(struct input *in, const char *data, int datalen) {
+  const unsigned char *s=in->buf+in->start ;
+  size_t len=in->thinglen, i ;
+  unsigned char c ;
+
+  if (in->tag) {
+    for (i=1; i<len && s[i]!='>' && s[i]!='\0' && !iswhite(s[i]); i++) ;
+    return (i-1==(size_t)datalen && memcmp(s+1, data, datalen)==0) ;
+  }
+  for (i=0; i<len && s[i]!='\0'; i++) {
+    if ((int)i>=datalen) return (1==0) ;
+    c=iswhite(s[i]) ? ' ' : s[i] ;
+    if (c!=(unsigned char)data[i]) return (1==0) ;
+  }
+  return (i==(size_t)datalen) ;
 }
 
-int istag() {
-  return (lastthing[0]=='<') ;
+/*
+ * The current thing as a string, tag brackets and all
+ */
+char *lastthing(struct input *in) {
+  const unsigned char *s=in->buf+in->start ;
+  size_t i ;
+
+  if (in->textvalid) return in->text ;
+  if (in->thinglen+1>in->textsize) {
+    in->textsize=in->thinglen+256 ;
+    in->text=xrealloc(in->text, in->textsize) ;
+  }
+  for (i=0; i<in->thinglen; i++) {
+    in->text[i]=iswhite(s[i]) ? ' ' : s[i] ;
+  }
+  in->text[i]='\0' ;
+  in->textvalid=(1==1) ;
+  return in->text ;
 }
 
-char *thing() {
-  static char reply[THINGLEN+1] ;
+/*
+ * The current word, or the name of the current tag
+ */
+char *thing(struct input *in) {
+  char *reply=lastthing(in) ;
   int i ;
-  if (istag()) {
-    strcpy(reply, &lastthing[1]) ;
-    for (i=0; i<THINGLEN && (reply[i]!='>' && !iswhite(reply[i])); i++) ;
+  if (in->tag) {
+    reply++ ;
+    for (i=0; (reply[i]!='>' && reply[i]!='\0' && !iswhite(reply[i])); i++) ;
     reply[i]='\0' ;
-  } else {
-    strcpy(reply, lastthing) ; 
+    // The name is cut off in place, the full thing is rebuilt when needed
+    in->textvalid=(1==0) ;
   }
   return reply ;
 }
 
-char *thingattribute(char *attribute) {
-  static char reply[THINGLEN+1] ;
+char *thingattribute(struct input *in, char *attribute) {
+  char *reply, *last ;
   int i, j ;
 
-  if (!istag()) {
-    reply[0]='\0' ;
-  } else {
-    i=0; j=0 ;
-    reply[0]='\0' ;
-    while (lastthing[i]!='\0' && reply[0]=='\0') {
-      while (lastthing[i]!='\0' && lastthing[i]==attribute[j]) {i++ ; j++ ; }
-      if (attribute[j]=='\0' && lastthing[i]=='=') {
+  if (!in->tag) return "" ;
+  last=lastthing(in) ;
+  if (in->thinglen+1>in->attrsize) {
+    in->attrsize=in->thinglen+256 ;
+    in->attr=xrealloc(in->attr, in->attrsize) ;
+  }
+  reply=in->attr ;
+  i=0; j=0 ;
+  reply[0]='\0' ;
+  while (last[i]!='\0' && reply[0]=='\0') {
+    while (last[i]!='\0' && last[i]==attribute[j]) {i++ ; j++ ; }
+    if (attribute[j]=='\0' && last[i]=='=') {
+      i++ ;
+      if (last[i]=='\"') {
         i++ ;
-        if (lastthing[i]=='\"') {
-          i++ ;
-          strcpy(reply, &lastthing[i]) ;
-          for (j=0; reply[j]!='\"' && reply[j]!='\0'; j++) ;
-          reply[j]='\0' ;
-        } else {
-          strcpy(reply, &lastthing[i]) ;
-          for (j=0; !iswhite(reply[j]) && reply[j]!='\0'; j++) ;
-          reply[j]='\0' ;
-        }
+        strcpy(reply, &last[i]) ;
+        for (j=0; reply[j]!='\"' && reply[j]!='\0'; j++) ;
+        reply[j]='\0' ;
       } else {
-        if (lastthing[i]!='\0') i++ ;
+        strcpy(reply, &last[i]) ;
+        for (j=0; !iswhite(reply[j]) && reply[j]!='\0'; j++) ;
+        reply[j]='\0' ;
       }
+    } else {
+      if (last[i]!='\0') i++ ;
     }
   }
   return reply ;
 }
 
 // CFG Functions
-#define CFGLEN 128
-#define CFGLINES 256
-
-int cfgcmd[CFGLINES] ;
-char cfgdata[CFGLINES][CFGLEN] ;
-void readcfg(FILE *fp) {
-  int i, j, line=0 ;
-  char buf[CFGLEN*2+1] ;
-  for (i=0; i<CFGLINES; i++) cfgdata[i][0]='\0' ;
-  while (!feof(fp) && line<CFGLINES) {
-    fgets(buf, CFGLEN*2, fp) ;
-    // Remove Trailing White Space
-    for (i=(strlen(buf)-1); (i>0 && ((buf[i]==' ') || (buf[i]=='\n'))); i--)
-	    buf[i]='\0' ;
-    //
-    // Note:
-    //
-    // ...command    arguments  
-    //    ^      \0  ^
-    //    i          j
-    //
-
-    // Skip Leading White Space
-    for (i=0; buf[i]!='\0' && iswhite(buf[i]); i++) ;
-
-    // Labels are a Special Case
-    if (buf[i]==':') {
-
-      cfgcmd[line]=CFG_LABEL ;
-      strcpy(cfgdata[line], &buf[i+1]) ;
 
-    } else {
+struct cfgline {
+  int cmd ;
+  char *data ;
+} ;
+
+/*
+ * Split one line into command and data, exits on an unknown command
+ */
+static void parseline(char *buf, struct cfgline *l) {
+  int i, j ;
+  char *data="" ;
+
+  // Remove Trailing White Space
+  for (i=(strlen(buf)-1); (i>0 && ((buf[i]==' ') || (buf[i]=='\n'))); i--)
+    buf[i]='\0' ;
+  //
+  // Note:
+  //
+  // ...command    arguments
+  //    ^      \0  ^
+  //    i          j
+  //
+
+  // Skip Leading White Space
+  for (i=0; buf[i]!='\0' && iswhite(buf[i]); i++) ;
+
+  // Labels are a Special Case
+  if (buf[i]==':') {
+
+    l->cmd=CFG_LABEL ;
+    l->data=xstrdup(&buf[i+1]) ;
+    return ;
+
+  }
+
+  for (j=i; buf[j]!=' ' && buf[j]!='\0'; j++) ;
+  if (buf[j]!='\0') {
+    buf[j++]='\0' ;
+    while (buf[j]==' ') j++ ;
+    data=&buf[j] ;
+  }
 
-      for (j=i; buf[j]!=' ' && buf[j]!='\0'; j++) ;
-      if (buf[j]!='\0') {
-        buf[j++]='\0' ;
-        while (buf[j]==' ') j++ ;
-        strcpy(cfgdata[line], &buf[j]) ;
+  l->cmd=(-1) ;
+  if (strcmp(&buf[i],"searchfortag")==0) l->cmd=CFG_SEARCHFORTAG ;
+  if (strcmp(&buf[i],"printuntiltag")==0) l->cmd=CFG_PRINTUNTILTAG ;
+  if (strcmp(&buf[i],"printattribute")==0) l->cmd=CFG_PRINTATTRIBUTE ;
+  if (strcmp(&buf[i],"print")==0) l->cmd=CFG_PRINT ;
+  if (strcmp(&buf[i],"printuntilstring")==0) l->cmd=CFG_PRINTUNTILSTR;
+  if (strcmp(&buf[i],"searchforstring")==0) l->cmd=CFG_SEARCHFORSTR ;
+  if (strcmp(&buf[i],"loopuntileof")==0) l->cmd=CFG_LOOPUNTILEOF ;
+  if (strcmp(&buf[i],"end")==0) l->cmd=CFG_END ;
+  if (l->cmd==(-1)) {
+    printf("Invalid Command in CFG file: %s\n", &buf[i]) ;
+    exit(1) ;
+  }
+  l->data=xstrdup(data) ;
+}
+
+/*
+ * Split a print string into literal text and $0-$9 references
+ */
+static void compileprint(struct insn *in) {
+  char *b, *t, *lit ;
+
+  in->text=xrealloc(NULL, in->datalen+1) ;
+  in->pieces=xrealloc(NULL, (in->datalen+1)*sizeof(*in->pieces)) ;
+  in->npieces=0 ;
+  t=lit=in->text ;
+  for (b=in->data ; *b!='\0'; b++) {
+    // Argv Entry
+    if (*b=='$') {
+      if (*(b+1)!='\0') b++ ;
+      switch (*b) {
+      case '$':
+        *t++='$' ;
+        break ;
+      case '0': case '1': case '2': case '3': case '4':
+      case '5': case '6': case '7': case '8': case '9':
+        if (t>lit) {
+          in->pieces[in->npieces].text=lit ;
+          in->pieces[in->npieces++].len=t-lit ;
+        }
+        in->pieces[in->npieces].text=NULL ;
+        in->pieces[in->npieces++].len=*b-'0' ;
+        lit=t ;
+        break ;
+      case 'n':
+        *t++='\n' ;
+        break ;
+      case '.':
+        *t++=' ' ;
+        break ;
       }
-     
-      cfgcmd[line]=(-1) ;
-      if (strcmp(&buf[i],"searchfortag")==0) cfgcmd[line]=CFG_SEARCHFORTAG ;
-      if (strcmp(&buf[i],"printuntiltag")==0) cfgcmd[line]=CFG_PRINTUNTILTAG ;
-      if (strcmp(&buf[i],"printattribute")==0) cfgcmd[line]=CFG_PRINTATTRIBUTE ;
-      if (strcmp(&buf[i],"print")==0) cfgcmd[line]=CFG_PRINT ;
-      if (strcmp(&buf[i],"printuntilstring")==0) cfgcmd[line]=CFG_PRINTUNTILSTR;
-      if (strcmp(&buf[i],"searchforstring")==0) cfgcmd[line]=CFG_SEARCHFORSTR ;
-      if (strcmp(&buf[i],"loopuntileof")==0) cfgcmd[line]=CFG_LOOPUNTILEOF ;
-      if (strcmp(&buf[i],"end")==0) cfgcmd[line]=CFG_END ;
-      if (cfgcmd[line]==(-1)) {
-        printf("Invalid Command in CFG file: %s\n", &buf[i]) ;
-        exit(1) ;
+    } else {
+      *t++=*b ;
+    }
+  }
+  if (t>lit) {
+    in->pieces[in->npieces].text=lit ;
+    in->pieces[in->npieces++].len=t-lit ;
+  }
+}
+
+struct program *compilecfg(FILE *fp) {
+  struct program *prg ;
+  struct cfgline *lines=NULL, *labels ;
+  int nlines=0, maxlines=0 ;
+  int *labelpc ;
+  char *buf=NULL ;
+  size_t bufsize=0 ;
+  ssize_t len=0 ;
+  int i, j, n, pc ;
+  int lastnl=(1==0) ;
+
+  while ((len=getline(&buf, &bufsize, fp))>0) {
+    if (nlines+1>=maxlines) {
+      maxlines=maxlines ? maxlines*2 : 64 ;
+      lines=xrealloc(lines, maxlines*sizeof(*lines)) ;
+    }
+    lastnl=(buf[len-1]=='\n') ;
+    parseline(buf, &lines[nlines++]) ;
+  }
+  free(buf) ;
+
+  // The old line reader saw a last line that ends in a newline twice,
+  // the second time without its arguments; keep that, as it shows in
+  // the output.
+  if (nlines>0 && lastnl) {
+    lines[nlines].cmd=lines[nlines-1].cmd ;
+    if (lines[nlines].cmd==CFG_LABEL) lines[nlines].data=xstrdup(lines[nlines-1].data) ;
+    else lines[nlines].data=xstrdup("") ;
+    nlines++ ;
+  }
+
+  prg=xcalloc(1, sizeof(*prg)) ;
+  prg->insn=xcalloc(nlines+1, sizeof(*prg->insn)) ;
+  labels=xrealloc(NULL, (nlines+1)*sizeof(*labels)) ;
+  labelpc=xrealloc(NULL, (nlines+1)*sizeof(*labelpc)) ;
+  n=0 ;
+  pc=0 ;
+  for (i=0; i<nlines; i++) {
+    if (lines[i].cmd==CFG_LABEL) {
+      labels[n]=lines[i] ;
+      labelpc[n++]=pc ;
+      continue ;
+    }
+    prg->insn[pc].cmd=lines[i].cmd ;
+    prg->insn[pc].data=lines[i].data ;
+    prg->insn[pc].datalen=strlen(lines[i].data) ;
+    if (lines[i].cmd==CFG_PRINT) compileprint(&prg->insn[pc]) ;
+    pc++ ;
+  }
+  // Running off the end, or jumping to a missing label, ends the parse
+  prg->insn[pc].cmd=CFG_END ;
+  prg->insn[pc].data=xstrdup("") ;
+  prg->ninsn=pc+1 ;
+
+  for (i=0; i<pc; i++) {
+    if (prg->insn[i].cmd!=CFG_LOOPUNTILEOF) continue ;
+    prg->insn[i].target=pc ;
+    for (j=0; j<n; j++) {
+      if (strcmp(labels[j].data, prg->insn[i].data)==0) {
+        prg->insn[i].target=labelpc[j] ;
+        break ;
       }
+    }
+  }
+  for (j=0; j<n; j++) free(labels[j].data) ;
+  free(labels) ;
+  free(labelpc) ;
+  free(lines) ;
+  return prg ;
+}
 
-    }   
-    line++ ;
+void freecfg(struct program *prg) {
+  int i ;
+  for (i=0; i<prg->ninsn; i++) {
+    free(prg->insn[i].data) ;
+    free(prg->insn[i].text) ;
+    free(prg->insn[i].pieces) ;
   }
-  currline=0 ;
+  free(prg->insn) ;
+  free(prg) ;
 }
 
-int getcommand() {
-  if (currline>=(CFGLINES-1))
-    return CFG_END ;
-  else
-    return cfgcmd[currline] ;
+// Batch Functions
+//
+// One compiled program is run over many inputs by a pool of worker
+// threads.  Each worker takes the next input, and writes its output to
+// a file in the output directory, or to memory from where the main
+// thread copies it to stdout in input order.
+//
+struct job {
+  char *path ;
+  char *out ;
+  size_t outlen ;
+  int failed ;
+  int done ;
+} ;
+
+struct batchrun {
+  struct program *prg ;
+  struct job *jobs ;
+  int njobs ;
+  int next ;                    // Next job to take
+  char **args ;
+  int nargs ;
+  char *outdir ;
+  pthread_mutex_t lock ;
+  pthread_cond_t done ;
+} ;
+
+/* Name of the output file for an input, see -o */
+static const char *batchname(const char *path) {
+  const char *name=strrchr(path, '/') ;
+  return (name==NULL) ? path : name+1 ;
 }
 
-char *getdata() {
-  if (currline>=(CFGLINES-1))
-    return "" ;
-  else 
-    return cfgdata[currline] ;
+static int batchcmpname(const void *a, const void *b) {
+  return strcmp(batchname((*(struct job * const *)a)->path), batchname((*(struct job * const *)b)->path)) ;
 }
 
-void gotoline() {
-  int i, j ;
-  j=currline ;
-  for (i=0; i<CFGLINES; i++) {
-    if (cfgcmd[i]==CFG_LABEL && strcmp(cfgdata[i], cfgdata[j])==0) {
-      currline=i+1 ;
-      return ;
+/*
+ * With -o, true (after saying which) if two inputs share a name, as
+ * their outputs would overwrite each other
+ */
+static int batchclash(struct batchrun *b) {
+  struct job **byname ;
+  int i, clash=(1==0) ;
+
+  byname=xrealloc(NULL, (b->njobs+1)*sizeof(*byname)) ;
+  for (i=0; i<b->njobs; i++) byname[i]=&b->jobs[i] ;
+  qsort(byname, b->njobs, sizeof(*byname), batchcmpname) ;
+  for (i=1; i<b->njobs; i++) {
+    if (batchcmpname(&byname[i-1], &byname[i])!=0) continue ;
+    fprintf(stderr, "xmlparse: %s and %s would both write %s/%s\n", byname[i-1]->path,
+      byname[i]->path, b->outdir, batchname(byname[i]->path)) ;
+    clash=(1==1) ;
+  }
+  free(byname) ;
+  return clash ;
+}
+
+/* Skip hidden files, batchadd() skips all but plain files */
+static int batchfilter(const struct dirent *d) {
+  return (d->d_name[0]!='.') ;
+}
+
+/*
+ * Add a file, or all files in a directory (sorted by name)
+ */
+static void batchadd(struct batchrun *b, char *path, int *maxjobs) {
+  struct dirent **names ;
+  struct stat st ;
+  char *p ;
+  int i, n ;
+
+  if (stat(path, &st)==0 && S_ISDIR(st.st_mode)) {
+    n=scandir(path, &names, batchfilter, alphasort) ;
+    for (i=0; i<n; i++) {
+      p=xrealloc(NULL, strlen(path)+strlen(names[i]->d_name)+2) ;
+      sprintf(p, "%s/%s", path, names[i]->d_name) ;
+      if (stat(p, &st)==0 && S_ISREG(st.st_mode)) batchadd(b, p, maxjobs) ;
+      free(p) ;
+      free(names[i]) ;
     }
+    if (n>=0) free(names) ;
+    return ;
+  }
+  if (b->njobs==*maxjobs) {
+    *maxjobs=*maxjobs ? *maxjobs*2 : 64 ;
+    b->jobs=xrealloc(b->jobs, *maxjobs*sizeof(*b->jobs)) ;
+  }
+  memset(&b->jobs[b->njobs], 0, sizeof(*b->jobs)) ;
+  b->jobs[b->njobs++].path=xstrdup(path) ;
+}
+
+/*
+ * Parse one input into its output file or memory buffer
+ */
+static void batchjob(struct batchrun *b, struct job *j) {
+  struct input *in ;
+  const char *name ;
+  char *fname ;
+  FILE *out ;
+
+  in=openinput(j->path) ;
+  if (in==NULL) {
+    j->failed=(1==1) ;
+    return ;
+  }
+  if (b->outdir!=NULL) {
+    name=batchname(j->path) ;
+    fname=xrealloc(NULL, strlen(b->outdir)+strlen(name)+2) ;
+    sprintf(fname, "%s/%s", b->outdir, name) ;
+    out=fopen(fname, "w") ;
+    free(fname) ;
+  } else {
+    out=open_memstream(&j->out, &j->outlen) ;
   }
-  currline=CFGLINES-1 ;
+  if (out==NULL) {
+    j->failed=(1==1) ;
+  } else {
+    run(b->prg, in, b->args, b->nargs, out) ;
+    fclose(out) ;
+  }
+  closeinput(in) ;
+}
+
+static void *batchworker(void *arg) {
+  struct batchrun *b=arg ;
+  int i ;
+  for (;;) {
+    pthread_mutex_lock(&b->lock) ;
+    i=b->next++ ;
+    pthread_mutex_unlock(&b->lock) ;
+    if (i>=b->njobs) break ;
+    batchjob(b, &b->jobs[i]) ;
+    pthread_mutex_lock(&b->lock) ;
+    b->jobs[i].done=(1==1) ;
+    pthread_cond_broadcast(&b->done) ;
+    pthread_mutex_unlock(&b->lock) ;
+  }
+  return NULL ;
 }
 
-void nextline() {
-  if (currline<CFGLINES) currline++ ;
+/*
+ * xmlparse -b [-j jobs] [-t | -o dir] parse.cfg input ... [-- arg0 ... ]
+ */
+int batch(int argc, char *argv[]) {
+  struct batchrun b ;
+  pthread_t *workers ;
+  FILE *cfg ;
+  int tagged=(1==0), failed=(1==0) ;
+  int nstarted, nworkers=0, maxjobs=0 ;
+  int c, i ;
+
+  memset(&b, 0, sizeof(b)) ;
+  optind=2 ;
+  while ((c=getopt(argc, argv, "+j:o:t"))!=-1) {
+    switch (c) {
+    case 'j':
+      nworkers=atoi(optarg) ;
+      break ;
+    case 'o':
+      b.outdir=optarg ;
+      break ;
+    case 't':
+      tagged=(1==1) ;
+      break ;
+    default:
+      return 1 ;
+    }
+  }
+  if (optind>=argc) {
+    fprintf(stderr, "xmlparse: no parse.cfg given\n") ;
+    return 1 ;
+  }
+  cfg=fopen(argv[optind], "r") ;
+  if (cfg==NULL) {
+    fprintf(stderr, "xmlparse: unable to open file(s)\n") ;
+    return 1 ;
+  }
+  b.prg=compilecfg(cfg) ;
+  fclose(cfg) ;
+
+  for (i=optind+1; i<argc && strcmp(argv[i], "--")!=0; i++) batchadd(&b, argv[i], &maxjobs) ;
+  if (i<argc) {
+    b.args=&argv[i+1] ;
+    b.nargs=argc-i-1 ;
+  }
+  if (b.outdir!=NULL && batchclash(&b)) {
+    for (i=0; i<b.njobs; i++) free(b.jobs[i].path) ;
+    free(b.jobs) ;
+    freecfg(b.prg) ;
+    return 1 ;
+  }
+
+  if (nworkers<=0) nworkers=sysconf(_SC_NPROCESSORS_ONLN) ;
+  if (nworkers<=0) nworkers=1 ;
+  if (nworkers>b.njobs) nworkers=b.njobs ;
+  pthread_mutex_init(&b.lock, NULL) ;
+  pthread_cond_init(&b.done, NULL) ;
+  workers=xrealloc(NULL, (nworkers+1)*sizeof(*workers)) ;
+  for (nstarted=0; nstarted<nworkers; nstarted++) {
+    if (pthread_create(&workers[nstarted], NULL, batchworker, &b)!=0) break ;
+  }
+  if (nstarted==0) batchworker(&b) ;
+
+  // Hand out the results in input order as they complete
+  for (i=0; i<b.njobs; i++) {
+    pthread_mutex_lock(&b.lock) ;
+    while (!b.jobs[i].done) pthread_cond_wait(&b.done, &b.lock) ;
+    pthread_mutex_unlock(&b.lock) ;
+    if (b.jobs[i].failed) {
+      fprintf(stderr, "xmlparse: unable to parse %s\n", b.jobs[i].path) ;
+      failed=(1==1) ;
+    } else if (b.outdir==NULL) {
+      if (tagged) printf("@@ %s %lu\n", b.jobs[i].path, (unsigned long)b.jobs[i].outlen) ;
+      fwrite(b.jobs[i].out, 1, b.jobs[i].outlen, stdout) ;
+    }
+    free(b.jobs[i].out) ;
+    free(b.jobs[i].path) ;
+  }
+
+  for (i=0; i<nstarted; i++) pthread_join(workers[i], NULL) ;
+  free(workers) ;
+  free(b.jobs) ;
+  freecfg(b.prg) ;
+  return failed ? 1 : 0 ;
 }
@@ -0,0 +1,553 @@
+/* 
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github 
+ *
+ * This file is part of the sharpfin project
+ * libreciva micro benchmarks
+ *  
+ * This Library is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Micro benchmarks for the libreciva hot paths.
+ *
+ * Built for the build host (not the radio) against the headless
+ * virtual backend with 'make bench'.  Each benchmark reports the
+ * time and the number of heap allocations per operation, as a
+ * table on stdout and, with -j file, as one JSON object per line.
+ *
+ * lcd.c is included directly, so that its static UTF8 helpers can
+ * be measured as well.
+ */
+#include "../src/lcd/lcd.c"
+#include "lcd_virtual.h"
+#include "lcdbitmap.h"
+#include "hwtrace.h"
+#include "stationdb.h"
+#include <unistd.h>
+#include <fcntl.h>
+
+#define BENCH_STATIONS 5000
+
+/* Heap allocation counting, see -Wl,--wrap in the Makefile */
+void *__real_malloc(size_t size) ;
+void *__real_calloc(size_t n, size_t size) ;
+void *__real_realloc(void *p, size_t size) ;
+void __real_free(void *p) ;
+static unsigned long bench_allocs=0 ;
+
+void *__wrap_malloc(size_t size) { bench_allocs++ ; return __real_malloc(size) ; }
+void *__wrap_calloc(size_t n, size_t size) { bench_allocs++ ; return __real_calloc(n, size) ; }
+void *__wrap_realloc(void *p, size_t size) { bench_allocs++ ; return __real_realloc(p, size) ; }
+void __wrap_free(void *p) { __real_free(p) ; }
+
+static char *bench_names[BENCH_STATIONS] ;
+static FILE *bench_json=NULL ;
+static struct timespec bench_t0 ;
+static unsigned long bench_a0 ;
+
+/* Station name building blocks, a mix of Latin, accented and CJK text */
+static char *bench_words[] = {
+	"Radio", "FM", "Jazz", "Classic", "Rock", "News", "Talk", "Chill",
+	"R\xc3\xa1" "dio", "M\xc3\xbcnchen", "Z\xc3\xbcrich", "S\xc3\xa3o Paulo",
+	"\xe4\xb8\xad\xe5\x9b\xbd\xe4\xb9\x8b\xe5\xa3\xb0",	/* Chinese */
+	"\xe6\x9d\xb1\xe4\xba\xac",				/* Tokyo */
+	"\xec\x84\x9c\xec\x9a\xb8",				/* Seoul */
+	"\xd0\xa1\xd0\xb8\xd0\xb1\xd0\xb8\xd1\x80\xd1\x8c"	/* Siberia */
+} ;
+#define BENCH_WORDS (sizeof(bench_words)/sizeof(bench_words[0]))
+
+/* Deterministic pseudo random numbers, so runs are comparable */
+static unsigned int bench_rand()
+{
+	static unsigned int seed=20120101 ;
+	seed=seed*1103515245+12345 ;
+	return (seed>>16)&0x7fff ;
+}
+
+static void bench_makenames()
+{
+	char buf[SLCD_PRINTF_BUFSIZE] ;
+	int i ;
+	for (i=0; i<BENCH_STATIONS; i++) {
+		snprintf(buf, sizeof(buf), "%s %s %d.%d %s",
+			bench_words[bench_rand()%BENCH_WORDS],
+			bench_words[bench_rand()%BENCH_WORDS],
+			87+bench_rand()%21, bench_rand()%10,
+			bench_words[bench_rand()%BENCH_WORDS]) ;
+		bench_names[i]=strdup(buf) ;
+	}
+}
+
+static void bench_start()
+{
+	bench_a0=bench_allocs ;
+	clock_gettime(CLOCK_MONOTONIC, &bench_t0) ;
+}
+
+/* Nanoseconds since bench_start() */
+static double bench_elapsed()
+{
+	struct timespec t1 ;
+	clock_gettime(CLOCK_MONOTONIC, &t1) ;
+	return (t1.tv_sec-bench_t0.tv_sec)*1e9+(t1.tv_nsec-bench_t0.tv_nsec) ;
+}
+
+static void bench_report(char *name, long ops, double totalns, unsigned long totalallocs)
+{
+	double ns, allocs ;
+
+	ns=totalns/ops ;
+	allocs=(double)totalallocs/ops ;
+	printf("%-24s %10ld %14.1f %12.3f\n", name, ops, ns, allocs) ;
+	if (bench_json!=NULL) {
+		fprintf(bench_json, "{\"name\":\"%s\",\"ops\":%ld,\"ns_per_op\":%.1f,\"allocs_per_op\":%.3f}\n",
+			name, ops, ns, allocs) ;
+	}
+}
+
+static void bench_stop(char *name, long ops)
+{
+	bench_report(name, ops, bench_elapsed(), bench_allocs-bench_a0) ;
+}
+
+static lcd_handle *bench_menu(int n)
+{
+	lcd_handle *h ;
+	int i ;
+	h=lcd_menucreate() ;
+	for (i=0; i<n; i++) lcd_menuaddentry(h, i, bench_names[i], SLCD_NOTSELECTED) ;
+	return h ;
+}
+
+/*************************
+ * Benchmarks
+ *************************/
+
+static void bench_menuaddentry()
+{
+	lcd_handle *h ;
+	int i, r, rounds=20 ;
+
+	h=lcd_menucreate() ;
+	bench_start() ;
+	for (r=0; r<rounds; r++) {
+		for (i=0; i<BENCH_STATIONS; i++) 
+			lcd_menuaddentry(h, i, bench_names[i], SLCD_NOTSELECTED) ;
+		lcd_menuclear(h) ;
+	}
+	bench_stop("lcd_menuaddentry", (long)rounds*BENCH_STATIONS) ;
+	lcd_delete(h) ;
+}
+
+static void bench_menusort()
+{
+	lcd_handle *h ;
+	int r, rounds=3 ;
+	double total=0 ;
+	unsigned long a=0 ;
+
+	/* Only the sort is timed, not rebuilding the unsorted menu */
+	for (r=0; r<rounds; r++) {
+		h=bench_menu(BENCH_STATIONS) ;
+		bench_start() ;
+		lcd_menusort(h) ;
+		total+=bench_elapsed() ;
+		a+=bench_allocs-bench_a0 ;
+		lcd_delete(h) ;
+	}
+	bench_report("lcd_menusort", rounds, total, a) ;
+}
+
+static void bench_menucontrol()
+{
+	lcd_handle *h ;
+	long i, n=200000 ;
+
+	h=bench_menu(BENCH_STATIONS) ;
+	bench_start() ;
+	for (i=0; i<n; i++) lcd_menucontrol(h, (i/1000)&1 ? SLCD_UP : SLCD_DOWN) ;
+	bench_stop("lcd_menucontrol", n) ;
+	lcd_delete(h) ;
+}
+
+static void bench_menubyid()
+{
+	lcd_handle *h ;
+	long i, n=200000 ;
+	int id ;
+
+	/* A live station list: one entry's text changes, then the screen is redrawn */
+	h=bench_menu(BENCH_STATIONS) ;
+	lcd_menusetentry(h, 0, bench_names[0]) ;
+	lcd_refresh(h) ;
+	bench_start() ;
+	for (i=0; i<n; i++) {
+		lcd_menusetentry(h, bench_rand()%BENCH_STATIONS, bench_names[i%BENCH_STATIONS]) ;
+		lcd_refresh(h) ;
+	}
+	bench_stop("lcd_menusetentry+refresh", n) ;
+
+	/* Stations dropping out of the list and coming back at the bottom */
+	bench_start() ;
+	for (i=0; i<n; i++) {
+		id=bench_rand()%BENCH_STATIONS ;
+		if (i&1) lcd_menumoveentry(h, id, -1) ;
+		else {
+			lcd_menuremoveentry(h, id) ;
+			lcd_menuaddentry(h, id, bench_names[id], SLCD_NOTSELECTED) ;
+		}
+	}
+	bench_stop("lcd_menuremove/moveentry", n) ;
+	lcd_delete(h) ;
+}
+
+static void bench_refresh()
+{
+	lcd_handle *h ;
+	long i, n=100000 ;
+
+	h=bench_menu(BENCH_STATIONS) ;
+	bench_start() ;
+	for (i=0; i<n; i++) {
+		lcd_menucontrol(h, SLCD_DOWN) ;
+		lcd_refresh(h) ;
+	}
+	bench_stop("lcd_refresh(menu)", n) ;
+	lcd_delete(h) ;
+}
+
+/* Virtual menu callback, serving the station names */
+static int bench_vmenuentry(void *data, int index, int *idnumber, char *buf, int maxlen)
+{
+	char **names=(char **)data ;
+	*idnumber=index ;
+	strncpy(buf, names[index], maxlen-1) ;
+	buf[maxlen-1]='\0' ;
+	return SLCD_TRUE ;
+}
+
+static void bench_vmenu()
+{
+	lcd_handle *h ;
+	long i, n=100000 ;
+
+	/* Opening the list, then scrolling it, as bench_refresh() does */
+	bench_start() ;
+	for (i=0; i<1000; i++) {
+		h=lcd_vmenucreate(BENCH_STATIONS, bench_vmenuentry, bench_names) ;
+		lcd_refresh(h) ;
+		lcd_delete(h) ;
+	}
+	bench_stop("lcd_vmenucreate+refresh", 1000) ;
+
+	h=lcd_vmenucreate(BENCH_STATIONS, bench_vmenuentry, bench_names) ;
+	bench_start() ;
+	for (i=0; i<n; i++) {
+		lcd_menucontrol(h, SLCD_DOWN) ;
+		lcd_refresh(h) ;
+	}
+	bench_stop("lcd_refresh(vmenu)", n) ;
+	lcd_delete(h) ;
+}
+
+static void bench_tick()
+{
+	lcd_handle *h ;
+	long i, n=100000 ;
+	int r ;
+
+	/* Every row of the frame is longer than the screen, so all scroll */
+	h=lcd_framecreate() ;
+	for (r=0; r<lcd_height(); r++) lcd_framesetline(h, r, bench_names[r]) ;
+	lcd_refresh(h) ;
+	bench_start() ;
+	for (i=0; i<n; i++) lcd_tick() ;
+	bench_stop("lcd_tick(scroll)", n) ;
+	lcd_delete(h) ;
+
+	/* A menu with nothing to scroll, on a fixed timer or governed */
+	h=lcd_menucreate() ;
+	lcd_menuaddentry(h, 0, "Radio", SLCD_SELECTED) ;
+	lcd_refresh(h) ;
+	bench_start() ;
+	for (i=0; i<n; i++) lcd_tick() ;
+	bench_stop("lcd_tick(static)", n) ;
+	bench_start() ;
+	for (i=0; i<n; i++) lcd_tickauto() ;
+	bench_stop("lcd_tickauto(static)", n) ;
+	lcd_delete(h) ;
+}
+
+static void bench_input()
+{
+	lcd_handle *h ;
+	char url[512] ;
+	long i, n=100000 ;
+	int del ;
+
+	/* Editing the middle of a long stream URL: a knob step, then insert or DEL */
+	memset(url, 'x', 400) ;
+	url[400]='\0' ;
+	h=lcd_inputcreate("abcdefghijklmnopqrstuvwxyz0123456789:/.", url, sizeof(url)) ;
+	del=h->inputncells-8 ;
+	h->inputselectedopt=del+3 ;
+	for (i=0; i<200; i++) lcd_inputcontrol(h, SLCD_ENTER) ;
+	bench_start() ;
+	for (i=0; i<n; i++) {
+		h->inputselectedopt=(i&1) ? del-1 : h->inputncells-1 ;
+		lcd_inputcontrol(h, SLCD_RIGHT) ;
+		lcd_inputcontrol(h, SLCD_ENTER) ;
+		lcd_refresh(h) ;
+	}
+	bench_stop("lcd_inputcontrol+refresh", n) ;
+	lcd_delete(h) ;
+}
+
+static void bench_bitmap()
+{
+	lcd_bitmap *s ;
+	unsigned char *buf ;
+	long i, n=100000 ;
+	int w, hei, size ;
+
+	/* A level meter on the graphics display, one column changing per frame */
+	s=lcd_bitmapcreate(0, 0) ;
+	if (s==NULL) return ;
+	lcd_bitmapflush(s) ;
+	bench_start() ;
+	for (i=0; i<n; i++) {
+		lcd_bitmapfill(s, 4+i%120, 40, 1, 8, (i/120)&1 ? SLCD_PIXEL_OFF : SLCD_PIXEL_ON) ;
+		lcd_bitmapflush(s) ;
+	}
+	bench_stop("lcd_bitmapflush(meter)", n) ;
+
+	bench_start() ;
+	for (i=0; i<n; i++) {
+		lcd_bitmaptext(s, 0, 0, bench_names[i%BENCH_STATIONS], SLCD_PIXEL_ON) ;
+		lcd_bitmapflush(s) ;
+	}
+	bench_stop("lcd_bitmaptext+flush", n) ;
+	lcd_bitmapdelete(s) ;
+
+	/* Screen capture into one reused buffer, as lcdshow does */
+	lcd_hwgrabbitmap(NULL, 0, &w, &hei) ;
+	size=((w+7)/8)*hei ;
+	buf=malloc(size) ;
+	if (buf==NULL) return ;
+	bench_start() ;
+	for (i=0; i<n; i++) lcd_hwgrabbitmap(buf, size, &w, &hei) ;
+	bench_stop("lcd_hwgrabbitmap", n) ;
+	free(buf) ;
+}
+
+static void bench_utf8()
+{
+	long i, n=BENCH_STATIONS*40, sum=0 ;
+	int p ;
+	char *s, u8[SLCD_UTF8_MAXLEN+1] ;
+
+	bench_start() ;
+	for (i=0; i<n; i++) sum+=lcd_strlen(bench_names[i%BENCH_STATIONS]) ;
+	bench_stop("lcd_strlen", n) ;
+
+	bench_start() ;
+	for (i=0; i<n; i++) {
+		s=bench_names[i%BENCH_STATIONS] ;
+		/* lcd_getnextcharacterpos() wraps back to 0 at the end */
+		p=0 ;
+		do {
+			sum+=lcd_getutf8char(s, p, u8)[0] ;
+			p=lcd_getnextcharacterpos(s, p) ;
+		} while (p!=0) ;
+	}
+	bench_stop("lcd_getutf8char(walk)", n) ;
+
+	bench_start() ;
+	for (i=0; i<n; i++) sum+=lcd_parsespecial(lcd_getutf8char(SLCD_USTR_INPUTMENU "a", (i%9)*3, u8))[0] ;
+	bench_stop("lcd_parsespecial", n) ;
+
+	if (sum==0) printf("\n") ;	/* keep the loops */
+}
+
+static void bench_log()
+{
+	long i, n=200000 ;
+	int fd, nul ;
+
+	/* Send stderr to /dev/null while the output is being timed */
+	fflush(stderr) ;
+	fd=dup(2) ;
+	nul=open("/dev/null", O_WRONLY) ;
+	dup2(nul, 2) ;
+
+	log_init("bench", 0, LG_WRN, 0) ;
+	bench_start() ;
+	for (i=0; i<n; i++) log_entry(LG_DBG, __FUNCTION__, "filtered %ld", i) ;
+	bench_stop("log_entry(filtered)", n) ;
+
+	bench_start() ;
+	for (i=0; i<n; i++) log_entry(LG_WRN, __FUNCTION__, "station %ld: %s", i, bench_names[i%BENCH_STATIONS]) ;
+	bench_stop("log_entry(format)", n) ;
+
+	log_init("bench", LOG_TO_STDERR, LG_WRN, 0) ;
+	bench_start() ;
+	for (i=0; i<n; i++) log_entry(LG_WRN, __FUNCTION__, "station %ld: %s", i, bench_names[i%BENCH_STATIONS]) ;
+	bench_stop("log_entry(stderr)", n) ;
+
+	/* Caller side only: a burst this long overflows the ring, so
+	 * most of these lines are counted as dropped, not written */
+	log_init("bench", LOG_TO_STDERR|LOG_ASYNC, LG_WRN, 0) ;
+	bench_start() ;
+	for (i=0; i<n; i++) log_entry(LG_WRN, __FUNCTION__, "station %ld: %s", i, bench_names[i%BENCH_STATIONS]) ;
+	bench_stop("log_entry(async)", n) ;
+	log_flush() ;
+
+	dup2(fd, 2) ;
+	close(fd) ;
+	close(nul) ;
+}
+
+static void bench_stationdb()
+{
+	char fname[]="/tmp/libreciva-bench-XXXXXX" ;
+	char id[16], prefix[4] ;
+	stationdb *db ;
+	lcd_handle *h ;
+	FILE *list ;
+	long i, n=200000 ;
+	int fd, first, sum=0 ;
+
+	/* The bench stations, with a few genres each */
+	fd=mkstemp(fname) ;
+	if (fd<0) return ;
+	close(fd) ;
+	list=tmpfile() ;
+	for (i=0; i<BENCH_STATIONS; i++) {
+		fprintf(list, "s%ld|%s|%s,%s|http://radio.example/%ld\n", i, bench_names[i],
+			bench_words[i%BENCH_WORDS], bench_words[(i/3)%BENCH_WORDS], i) ;
+	}
+	rewind(list) ;
+	bench_start() ;
+	stationdb_build(list, fname) ;
+	bench_stop("stationdb_build", 1) ;
+	fclose(list) ;
+
+	bench_start() ;
+	for (i=0; i<1000; i++) stationdb_close(stationdb_open(fname)) ;
+	bench_stop("stationdb_open", 1000) ;
+
+	db=stationdb_open(fname) ;
+	bench_start() ;
+	for (i=0; i<n; i++) {
+		snprintf(id, sizeof(id), "s%u", bench_rand()%BENCH_STATIONS) ;
+		sum+=stationdb_find(db, id) ;
+	}
+	bench_stop("stationdb_find", n) ;
+
+	bench_start() ;
+	for (i=0; i<n; i++) {
+		strncpy(prefix, bench_names[i%BENCH_STATIONS], 3) ;
+		prefix[3]='\0' ;
+		sum+=stationdb_prefix(db, prefix, &first) ;
+	}
+	bench_stop("stationdb_prefix", n) ;
+
+	/* Opening the whole directory as a menu, straight from the mapping */
+	bench_start() ;
+	for (i=0; i<1000; i++) {
+		h=lcd_vmenucreatetable(stationdb_strings(db), stationdb_nameoffsets(db), stationdb_count(db)) ;
+		lcd_refresh(h) ;
+		lcd_delete(h) ;
+	}
+	bench_stop("stationdb menu+refresh", 1000) ;
+
+	stationdb_close(db) ;
+	unlink(fname) ;
+	if (sum==0) printf("\n") ;	/* keep the loops */
+}
+
+static void bench_hwtrace()
+{
+	long i, n=1000000 ;
+	long long t0 ;
+
+	/* What a backend hook costs around each device operation */
+	hwtrace_enable(0) ;
+	bench_start() ;
+	for (i=0; i<n; i++) {
+		t0=HWTRACE_START() ;
+		HWTRACE_END("bench", HWTRACE_OP_WRITE, 1, t0) ;
+	}
+	bench_stop("hwtrace(off)", n) ;
+
+	hwtrace_enable(1) ;
+	bench_start() ;
+	for (i=0; i<n; i++) {
+		t0=HWTRACE_START() ;
+		HWTRACE_END("bench", HWTRACE_OP_WRITE+(i&7), 1, t0) ;
+	}
+	bench_stop("hwtrace(on)", n) ;
+	hwtrace_enable(0) ;
+	hwtrace_reset() ;
+}
+
+int main(int argc, char **argv)
+{
+	int c ;
+
+	while ((c=getopt(argc, argv, "j:"))!=-1) {
+		switch (c) {
+		case 'j':
+			bench_json=fopen(optarg, "w") ;
+			if (bench_json==NULL) {
+				perror(optarg) ;
+				return 1 ;
+			}
+			break ;
+		default:
+			fprintf(stderr, "usage: %s [-j results.json]\n", argv[0]) ;
+			return 1 ;
+		}
+	}
+
+	log_init("bench", 0, LG_WRN, 0) ;
+	if (!lcd_init()) {
+		fprintf(stderr, "lcd_init failed\n") ;
+		return 1 ;
+	}
+	bench_makenames() ;
+
+	printf("%-24s %10s %14s %12s\n", "benchmark", "ops", "ns/op", "allocs/op") ;
+	bench_menuaddentry() ;
+	bench_menusort() ;
+	bench_menucontrol() ;
+	bench_menubyid() ;
+	bench_refresh() ;
+	bench_vmenu() ;
+	bench_tick() ;
+	bench_input() ;
+	bench_bitmap() ;
+	bench_utf8() ;
+	bench_log() ;
+	bench_stationdb() ;
+	bench_hwtrace() ;
+
+	lcd_exit() ;
+	if (bench_json!=NULL) fclose(bench_json) ;
+	return 0 ;
+}
@@ -29,6 +29,10 @@
 #define _dog_defined_h
 #define DEV_WATCHDOG "/dev/misc/S3C2410 watchdog"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Open watchdog device
 int dog_init() ;
 
@@ -44,4 +48,8 @@ int dog_isenabled() ;
 
 // Timer callback function to trigger the watchdog
 int dog_kick() ;
+
+#ifdef __cplusplus
+}
+#endif
 #endif
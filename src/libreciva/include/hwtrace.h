@@ -0,0 +1,75 @@
+/*
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github
+ *
+ * This file is part of the sharpfin project
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef hwtrace_h_defined
+#define hwtrace_h_defined
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Device operation tracing for the hardware backends.
+ *
+ * Each traced operation is timed with CLOCK_MONOTONIC and recorded as
+ * { opcode, payload bytes, start, duration } in a fixed in-memory ring,
+ * and added to a per-opcode latency histogram.  Tracing is off unless
+ * the environment has LIBRECIVA_TRACE set (to "1" or "stderr" to dump
+ * to stderr at exit, or to a file name to dump there), or the program
+ * calls hwtrace_enable().  When off, an operation costs one test of
+ * hwtrace_on.
+ *
+ * Build with CFLAGS+=-DNO_HWTRACE to remove the hooks at compile time.
+ */
+
+/* Opcodes for operations that are not ioctls */
+#define HWTRACE_OP_OPEN   0x48570001
+#define HWTRACE_OP_READ   0x48570002
+#define HWTRACE_OP_WRITE  0x48570003
+#define HWTRACE_OP_SELECT 0x48570004
+
+extern volatile int hwtrace_on;
+
+#ifdef NO_HWTRACE
+#define HWTRACE_START() 0LL
+#define HWTRACE_END(name, op, bytes, t0) do { (void)(t0); } while (0)
+#else
+#define HWTRACE_START() (hwtrace_on ? hwtrace_start() : 0LL)
+#define HWTRACE_END(name, op, bytes, t0) do { \
+	if (t0) hwtrace_end(name, op, bytes, t0); \
+} while (0)
+#endif
+
+long long hwtrace_start(void);
+void hwtrace_end(const char *name, unsigned int op, int bytes, long long t0);
+void hwtrace_enable(int on);
+void hwtrace_reset(void);
+void hwtrace_dump(FILE *f, int records);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -23,11 +23,13 @@
 
 #ifndef key_h
 #define key_h
+#include <sys/time.h>
 #define EVENT_FD_COUNT 4
+#define KEY_QUEUE_LEN 16
 
-struct key_handler {
-	int fd[EVENT_FD_COUNT];
-};
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 enum key_state {
 	KEY_STATE_RELEASED = 0,
@@ -68,12 +70,36 @@ enum key_id {
 struct key {
 	enum key_state state;
 	enum key_id id;
+	int count;		/* Rows to move for LEFT/RIGHT, 1 for all other keys */
+	struct timeval time;	/* When it happened, on the gettimeofday() clock */
+};
+
+struct key_handler {
+	int fd[EVENT_FD_COUNT];
+
+	/* Keys translated from one batch of events, waiting to be polled */
+	struct key queue[KEY_QUEUE_LEN];
+	int queuehead, queuelen;
+
+	/* Rotary wheel coalescing and acceleration */
+	int wheel;			/* Accelerated ticks not yet reported */
+	int wheeldir;			/* Direction of the last tick */
+	long wheellast;			/* Time of last tick (ms) */
+	struct timeval wheeltime;	/* Time of the first tick not yet reported */
 };
 
 #define KEY_PRESSED(key, i)  ((key->id == i) && (key->state == KEY_STATE_PRESSED))
 #define KEY_RELEASED(key, i) ((key->id == i) && (key->state == KEY_STATE_RELEASED))
 
+/*
+ * A key_handler holds all of its own state, so it needs no locking
+ * as long as one thread polls it.  key_exit() closes the devices.
+ */
 struct key_handler *key_init(void);
 int key_poll(struct key_handler *eh, struct key *ev);
+void key_exit(struct key_handler *eh);
 
+#ifdef __cplusplus
+}
+#endif
 #endif /* key_h */
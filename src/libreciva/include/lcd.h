@@ -30,8 +30,13 @@
 #define lcdif_h_defined
 #include <stdlib.h>
 #include <time.h>
+#include <pthread.h>
 #include "lcdhw.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * enum slcd_e_selected
  *
@@ -53,7 +58,8 @@ enum slcd_e_type {
 	SLCD_FRAME,
 	SLCD_INPUT,
 	SLCD_CLOCK,
-	SLCD_YESNO
+	SLCD_YESNO,
+	SLCD_VMENU
 } ;
 
 /**
@@ -64,11 +70,57 @@ enum slcd_e_type {
 struct slcd_s_row {
 	struct slcd_s_row *next, *prev ;	/* Linked list pointers */
 	char *str ;				/* row text string */
+	int *cpoff ;				/* byte offset of each UTF8 char in str, plus end */
+	int cpsize ;				/* Bytes allocated at cpoff, for the table and str */
 	int idnumber ;				/* row's ID Number */
-	int scrollpos ;				/* Scroll pos for row animations */
+	int scrollpos ;				/* Scroll pos (in UTF8 chars) for row animations */
 	int len ;				/* UTF8 aware length of str */
+	struct slcd_s_row *hnext ;		/* Next row in the same ID index bucket */
+} ;
+
+/**
+ * struct slcd_s_arena
+ *
+ * Block of memory from which a handle's rows and their text
+ * are allocated.  The blocks are released together when the
+ * menu is cleared or deleted, rather than row by row.
+ **/
+struct slcd_s_arena {
+	struct slcd_s_arena *next ;		/* Older blocks */
+	int size ;				/* Bytes available in data */
+	int used ;				/* Bytes allocated from data */
+	double data[1] ;			/* Storage (double for alignment) */
+} ;
+
+/**
+ * lcd_vmenufunc
+ * @data: the pointer given to lcd_vmenucreate()
+ * @index: entry to produce, from 0 to count-1
+ * @idnumber: set to the entry's ID number
+ * @buf: destination for the entry's UTF8 text
+ * @maxlen: size of buf
+ *
+ * Callback which produces virtual menu entries on demand.
+ * Returns true on success, or false to show an empty entry.
+ **/
+typedef int (*lcd_vmenufunc)(void *data, int index, int *idnumber, char *buf, int maxlen) ;
+
+/**
+ * struct slcd_s_vslot
+ *
+ * Rendered virtual menu entry, kept in a small LRU cache
+ **/
+#define SLCD_VMENU_CACHE 16
+struct slcd_s_vslot {
+	int index ;				/* Entry held, or -1 if empty */
+	unsigned long used ;			/* LRU clock when last used */
+	int size ;				/* Bytes allocated at row.cpoff */
+	struct slcd_s_row row ;			/* Entry text, decoded for scrolling */
 } ;
 
+/* Character of an input screen's selection, see lcd_inputcreate() */
+struct slcd_s_inputcell ;
+
 /**
  * struct lcd_handle
  *
@@ -79,14 +131,27 @@ struct slcd_s_row {
  * the storage area for screen data much larger than the
  * visible screen, and provides functions like menus,
  * input selection and progress bars.
+ *
+ * Each handle has its own lock, so different threads may build
+ * and control different screens at the same time.  The handle's
+ * functions take the lock themselves; lcd_refresh() and lcd_tick()
+ * take the display lock (see lcd_lock()) before the handle's.
  **/
 typedef struct {
 	enum slcd_e_type type ;		/* type = frame, input, menu */
+	pthread_mutex_t lock ;		/* Held while the handle is read or changed */
 	int numrows ;			/* number of rows of text in the structure */
 	struct slcd_s_row *top, *end ;	/* storage buffer pointers for lines data */
 	struct slcd_s_row *tsc, *curl ;	/* line  at top of screen, and current selected line */
+	struct slcd_s_arena *arena ;	/* storage for rows and their text, newest block first */
+	int arenawaste ;		/* bytes in the arena held by replaced text */
+	struct slcd_s_row **idindex ;	/* idnumber hash of the rows, built on first use */
+	int idindexsize ;		/* Buckets in idindex, a power of two */
+	unsigned int dirty ;		/* Screen rows to redraw, one bit per row */
 
 	char *linebuf ;			/* scratch buffer for line creation (Screen width in UTF8 chars */
+	char *selcopy ;			/* Copy of the text returned by lcd_menugetsels() */
+	int selcopysize ;		/* Bytes allocated at selcopy */
 	
 	/* Frame specific parameters */
 	int statusrow ;			/* Frame row to overwrite with 88:88 status */
@@ -97,11 +162,14 @@ typedef struct {
 	enum slcd_e_status almon ;	/* Alarm on/off state */
 	
 	/* Input Specific Parameters */
-	int inputselectedopt ;		/* Position of the selected option on input top line */
-	int inputcursorpos ;		/* Input char under cursor */
+	int inputselectedopt ;		/* Cell selected on input top line */
+	int inputcursorpos ;		/* Input chars before the cursor */
 	int inputbolpos ;		/* Input char at beginning of line */
 	char *result ;			/* Destination for result (input types) */
-	char *selectopts ;		/* Input selection list */
+	struct slcd_s_inputcell *inputcells ;	/* Input selection list, decoded */
+	int inputncells ;		/* Number of cells in inputcells */
+	char *inputtext ;		/* Gap buffer holding the input text */
+	int inputgap, inputgapend ;	/* Gap is inputtext[inputgap] up to inputtext[inputgapend] */
 	int maxlen ;			/* Max length of result */
 	
 	/* YesNo Specific Parameters */
@@ -109,6 +177,15 @@ typedef struct {
 	int yesnomax ;			/* Max number of options */
 	char *yesnoopts ;		/* YesNo Options */
 	
+	/* Virtual menu specific parameters */
+	int vcount ;			/* Number of entries */
+	int vtop, vsel ;		/* Entry at top of screen, and selected entry */
+	lcd_vmenufunc vfunc ;		/* Produces entries on demand */
+	void *vdata ;			/* Passed to vfunc */
+	const char *vtable ;		/* String table for lcd_vmenucreatetable() */
+	const int *voffsets ;		/* Offset of each string in vtable */
+	unsigned long vclock ;		/* LRU clock */
+	struct slcd_s_vslot *vcache ;	/* Recently rendered entries */
 
 } lcd_handle ;
 
@@ -184,6 +261,33 @@ int lcd_menuclear(lcd_handle *menuh) ;
  **/
 int lcd_menuaddentry(lcd_handle *handle, int idnumber, char *str, enum slcd_e_select selected) ;
 
+/**
+ * lcd_menuaddentryn
+ * @handle: handle of screen buffer
+ * @idnumber: user's reference number
+ * @str: text of the entry, need not be NUL terminated
+ * @len: length of str in bytes
+ * @selected: entry is the currently selected line
+ *
+ * As lcd_menuaddentry(), for text that is not NUL terminated,
+ * e.g. part of a larger buffer.  The text is copied once, straight
+ * into the menu's storage.  It ends at the first NUL, if any.
+ * The function returns true on success, and false if out of memory.
+ **/
+int lcd_menuaddentryn(lcd_handle *handle, int idnumber, const char *str, int len, enum slcd_e_select selected) ;
+
+/**
+ * lcd_menucompact
+ * @handle: handle of screen buffer
+ *
+ * This function copies the rows still in use into fresh storage,
+ * and releases the space held by text that has since been replaced.
+ * It is called automatically once replaced and removed text takes
+ * more space than the live rows, so it is rarely needed.
+ * The function returns true on success, and false if out of memory.
+ **/
+int lcd_menucompact(lcd_handle *handle) ;
+
 /**
  * lcd_menusort
  * @handle: handle of screen buffer
@@ -209,7 +313,10 @@ int lcd_menucontrol(lcd_handle *handle, enum slcd_e_menuctl cmd) ;
  * lcd_menugetsels
  * @handle: handle of the screen buffer
  *
- * This function returns a pointer to selected line's string
+ * This function returns a pointer to a copy of the selected line's
+ * string, owned by the handle.  It stays valid until the next call
+ * to lcd_menugetsels() for the same handle, or until the handle is
+ * deleted, whatever happens to the entry or the menu meanwhile.
  **/
 char *lcd_menugetsels(lcd_handle *handle) ;
 
@@ -221,6 +328,126 @@ char *lcd_menugetsels(lcd_handle *handle) ;
  **/
 int lcd_menugetselid(lcd_handle *handle) ;
 
+/**
+ * lcd_menusetentry
+ * @handle: handle of screen buffer
+ * @idnumber: ID number of the entry
+ * @str: new text for the entry
+ *
+ * This function replaces the text of the menu entry with the
+ * given ID number, found through an index rather than a search,
+ * so that live lists can be kept up to date cheaply.  The
+ * selection does not move, and the next lcd_refresh() only
+ * redraws the entry's row.  ID numbers should be unique for this
+ * and the other by-ID functions.  The new text overwrites the old
+ * where it fits, otherwise the old text's space is reclaimed later
+ * by an automatic lcd_menucompact().
+ * The function returns true on success, and false if there is
+ * no such entry, or out of memory.
+ **/
+int lcd_menusetentry(lcd_handle *handle, int idnumber, char *str) ;
+
+/**
+ * lcd_menusetentryn
+ * @handle: handle of screen buffer
+ * @idnumber: ID number of the entry
+ * @str: new text for the entry, need not be NUL terminated
+ * @len: length of str in bytes
+ *
+ * As lcd_menusetentry(), for text that is not NUL terminated.
+ **/
+int lcd_menusetentryn(lcd_handle *handle, int idnumber, const char *str, int len) ;
+
+/**
+ * lcd_menuremoveentry
+ * @handle: handle of screen buffer
+ * @idnumber: ID number of the entry
+ *
+ * This function removes the menu entry with the given ID number.
+ * If it was selected, the entry below it is selected (or above,
+ * for the last entry); otherwise the selection does not move.
+ * The function returns true on success, and false if there is
+ * no such entry.
+ **/
+int lcd_menuremoveentry(lcd_handle *handle, int idnumber) ;
+
+/**
+ * lcd_menumoveentry
+ * @handle: handle of screen buffer
+ * @idnumber: ID number of the entry to move
+ * @beforeid: ID number of the entry to put it in front of, or -1
+ *
+ * This function moves the menu entry with ID number idnumber in
+ * front of the entry with ID number beforeid, or to the bottom of
+ * the menu if beforeid is -1.  The selected entry stays selected.
+ * The function returns true on success, and false if either entry
+ * does not exist.
+ **/
+int lcd_menumoveentry(lcd_handle *handle, int idnumber, int beforeid) ;
+
+
+/*************************
+ * Virtual Menu Control Functions
+ *************************/
+
+/**
+ * lcd_vmenucreate
+ * @count: number of entries
+ * @func: callback producing an entry's text and ID number
+ * @data: passed to func
+ *
+ * The lcd_vmenucreate function creates a menu whose entries are
+ * not stored, but produced by func when they come on screen, and
+ * kept in a small cache.  Opening and scrolling the menu therefore
+ * costs the same whatever its size.  The handle is controlled with
+ * lcd_menucontrol(), lcd_menugetselid() and lcd_menugetsels(), but
+ * entries cannot be added or sorted.
+ * This function returns a handle, or NULL in the event of an error.
+ **/
+lcd_handle *lcd_vmenucreate(int count, lcd_vmenufunc func, void *data) ;
+
+/**
+ * lcd_vmenucreatetable
+ * @table: block of NUL terminated UTF8 strings, e.g. an mmap()ed file
+ * @offsets: byte offset of each entry's string in table
+ * @count: number of entries
+ *
+ * Creates a virtual menu reading its entries in place from a string
+ * table, which must stay valid until the handle is deleted.  The ID
+ * number of each entry is its index.
+ * This function returns a handle, or NULL in the event of an error.
+ **/
+lcd_handle *lcd_vmenucreatetable(const char *table, const int *offsets, int count) ;
+
+/**
+ * lcd_vmenusetcount
+ * @handle: handle of virtual menu
+ * @count: new number of entries
+ *
+ * Tells the menu that its entries have changed, discarding any
+ * cached text, and keeping the selection where possible.
+ * The function returns true on success.
+ **/
+int lcd_vmenusetcount(lcd_handle *handle, int count) ;
+
+/**
+ * lcd_vmenuselect
+ * @handle: handle of virtual menu
+ * @index: entry to select
+ *
+ * Selects an entry, scrolling the menu to show it if necessary.
+ * The function returns true on success, or false if index is
+ * out of range.
+ **/
+int lcd_vmenuselect(lcd_handle *handle, int index) ;
+
+/**
+ * lcd_vmenugetsel
+ * @handle: handle of virtual menu
+ *
+ * This function returns the selected entry's index, or -1.
+ **/
+int lcd_vmenugetsel(lcd_handle *handle) ;
 
 /*************************
  * Frame Access / Control Functions
@@ -249,6 +476,18 @@ lcd_handle *lcd_framecreate() ;
  **/
 int lcd_framesetline(lcd_handle *handle, int line, char *str) ;
 
+/**
+ * lcd_framesetlinen
+ * @handle: handle of screen buffer
+ * @line: line number to set
+ * @str: text for the line, need not be NUL terminated
+ * @len: length of str in bytes
+ *
+ * As lcd_framesetline(), for text that is not NUL terminated.
+ * The function returns true on success, and false if out of memory.
+ **/
+int lcd_framesetlinen(lcd_handle *handle, int line, const char *str, int len) ;
+
 /**
  * lcd_frameprintf
  * @handle: handle of screen buffer
@@ -323,8 +562,9 @@ enum slcd_e_status lcd_framestatus(lcd_handle *handle, int line, enum slcd_e_sta
  * with the top line having a scrolling selection e.g. "abcd <e> fghi".
  * The function automatically adds DEL LEFT RIGHT and END
  * strings to the selection, and populates the result line with
- * the contents of result as a preset. result is kept up-to-date
- * with the current contents of the display.
+ * the contents of result as a preset.  The text is edited in the
+ * handle, and copied back to result when END is selected, or
+ * when lcd_inputgetresult() is called.
  * This function returns a handle, which is used for future 
  * screen operations, or NULL in the case of an error.
  */
@@ -346,6 +586,16 @@ lcd_handle *lcd_inputcreate(char *selection, char *result, int maxlen) ;
  **/
 int lcd_inputcontrol(lcd_handle *handle, enum slcd_e_inputctl cmd) ;
 
+/**
+ * lcd_inputgetresult
+ * @handle: handle of screen buffer
+ *
+ * Copies the text entered so far to the result buffer given
+ * to lcd_inputcreate(), and returns the buffer, or NULL in
+ * the case of an error.
+ **/
+char *lcd_inputgetresult(lcd_handle *handle) ;
+
 /**
  * lcd_inputsetline
  * @handle: handle of screen buffer
@@ -462,7 +712,8 @@ void lcd_delete(lcd_handle *handle) ;
  *
  * This function transfers the contents of
  * the screen buffer identified by the provided
- * handle to the LCD.
+ * handle to the LCD.  It may be called from any
+ * thread, the display lock serialises the updates.
  **/
 void lcd_refresh(lcd_handle *handle) ;
 
@@ -470,10 +721,64 @@ void lcd_refresh(lcd_handle *handle) ;
  * lcd_tick
  *
  * lcd_tick animates the currently displayed
- * screen.
+ * screen, whichever thread it belongs to.
  **/
 void lcd_tick() ;
 
+/**
+ * lcd_tickwait
+ *
+ * lcd_tickwait returns the number of milliseconds until the
+ * currently displayed screen next changes by itself, i.e. a
+ * scroll step, or a new minute on a clock or status row.  It
+ * returns 0 if lcd_tick() is due now, and -1 if nothing on the
+ * screen will change until the application changes it.
+ * Scrolling slows to the idle rate when lcd_refresh() has not been
+ * called for a while, and stops while the backlight is off.
+ **/
+int lcd_tickwait() ;
+
+/**
+ * lcd_tickauto
+ *
+ * lcd_tickauto calls lcd_tick() if it is due, and returns the
+ * time until it is next due, as lcd_tickwait().  A main loop
+ * can sleep for that long (or until a key arrives) instead of
+ * calling lcd_tick() on a fixed timer.
+ **/
+int lcd_tickauto() ;
+
+/**
+ * lcd_tickrate
+ * @scrollms: milliseconds between scroll steps
+ * @idlems: milliseconds between scroll steps when idle, 0 to stop
+ * @idleafter: milliseconds without lcd_refresh() calls before the
+ *             display is idle, 0 for never
+ *
+ * lcd_tickrate sets the rates used by lcd_tickwait().  The
+ * defaults are 300ms, 1000ms and one minute.
+ **/
+void lcd_tickrate(int scrollms, int idlems, int idleafter) ;
+
+/**
+ * lcd_fetch
+ * handle: unused, may be NULL
+ * buf: buffer for current screen output
+ * max: maximum buffer size
+ *
+ * lcd_fetch copies to buf a text string which represents the 
+ * current screen contents, in the format of lcd_dumpscreen().
+ * The text is read from the POSIX shared memory segment which
+ * lcd_refresh() updates (named by the LCD_MIRROR environment
+ * variable, default /sharpfin-lcd, empty to disable), so it may
+ * be called from any process without disturbing the display.
+ * Only one process writes the segment, the first to refresh while
+ * no other holds it; the screens of the others are not mirrored.
+ * The function returns true on success, or false if the buffer is
+ * too small, or no screen has been published.
+ **/
+int lcd_fetch(lcd_handle *handle, char *buf, int max) ;
+
 /**
  * lcd_dumpscreen
  **/
@@ -513,4 +818,8 @@ struct bitmap_data*lcd_grab_region(int top,int left,int width,int height) ;
 #define SLCD_UCHR_LOCK		"\xee\x80\x8f"  /* 0xe00f */
 #define SLCD_UCHR_MUTE		"M"
 #define SLCD_USTR_INPUTMENU	SLCD_UCHR_DEL1 SLCD_UCHR_DEL2 SLCD_UCHR_DEL3 SLCD_UCHR_LEFT SLCD_UCHR_RIGHT SLCD_UCHR_END1 SLCD_UCHR_END2 SLCD_UCHR_END3
+
+#ifdef __cplusplus
+}
+#endif
 #endif
@@ -0,0 +1,72 @@
+/* 
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github 
+ *
+ * This file is part of the sharpfin project
+ *  
+ * This Library is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Access to the headless (HARDWARE=virtual) LCD and key backends,
+ * for automated tests and benchmarks without radio hardware.
+ */
+#ifndef _lcd_virtual_h
+#define _lcd_virtual_h
+#include <stdio.h>
+#include "key.h"
+
+/**
+ * struct lcd_virtual_stats
+ *
+ * Counters of what would have been sent to the LCD driver
+ **/
+struct lcd_virtual_stats {
+	unsigned long refreshes ;	/* IOC_LCD_DRAW_SCREEN equivalents */
+	unsigned long ioctls ;		/* All driver transfers */
+	unsigned long bytes ;		/* Payload bytes of all transfers */
+} ;
+
+void lcd_virtual_getstats(struct lcd_virtual_stats *stats) ;
+void lcd_virtual_resetstats() ;
+const unsigned int *lcd_virtual_getframe() ;
+const unsigned char *lcd_virtual_getbitmap(int *width, int *height) ;
+void lcd_virtual_dumpframe(FILE *f) ;
+
+/**
+ * key_virtual_script
+ * @script: whitespace separated key names
+ *
+ * Queues scripted key presses, which are returned by key_poll().
+ * Names are 1-5, shift, back, select, reply, power, left, right,
+ * volup, voldn, browse; "name*N" repeats a key N times, and "dump"
+ * writes the current frame to stdout when it is reached.
+ * The KEY_VIRTUAL_SCRIPT environment variable is queued by key_init().
+ * Scripted keys are given their time when key_poll() returns them.
+ * Returns the number of keys queued, or -1 on a bad name.
+ **/
+int key_virtual_script(char *script) ;
+
+/**
+ * key_virtual_push
+ *
+ * Queues a single key event, timed now.  Returns false if the queue
+ * is full.
+ **/
+int key_virtual_push(enum key_id id, enum key_state state) ;
+#endif
@@ -0,0 +1,183 @@
+/*
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github
+ *
+ * This file is part of the sharpfin project
+ * LCD bitmap drawing
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Bitmap surfaces for displays with SLCD_HAS_GRAPHICS.
+ *
+ * A surface is a 1bpp pixel buffer.  Drawing into a screen surface
+ * records the changed areas as dirty rectangles, and lcd_bitmapflush()
+ * sends just those areas to the display, so an animated widget only
+ * costs the pixels that actually change.
+ *
+ * A surface belongs to one thread at a time; lcd_bitmapflush() takes
+ * the display lock for each rectangle it sends.
+ */
+#ifndef lcdbitmap_h_defined
+#define lcdbitmap_h_defined
+#include "lcdhw.h"
+
+#define SLCD_BITMAP_MAXDIRTY 8		/* Dirty rectangles kept before merging */
+#define SLCD_BITMAP_FONTWID 6		/* Text cell width, including spacing */
+#define SLCD_BITMAP_FONTHEI 8		/* Text cell height, including spacing */
+#define SLCD_BITMAP_ICONSIZE 8		/* Icons are square */
+
+/**
+ * enum slcd_e_pixel
+ *
+ * How drawing operations change the pixels
+ **/
+enum slcd_e_pixel {
+	SLCD_PIXEL_OFF=0,		/* Clear pixels */
+	SLCD_PIXEL_ON=1,		/* Set pixels */
+	SLCD_PIXEL_INVERT=2		/* Invert pixels */
+} ;
+
+/**
+ * struct slcd_s_rect
+ *
+ * Rectangle, in pixels
+ **/
+struct slcd_s_rect {
+	int x, y ;
+	int w, h ;
+} ;
+
+/**
+ * struct lcd_bitmap
+ *
+ * Bitmap surface.  Each row is packed MSB first into stride bytes.
+ **/
+typedef struct slcd_s_bitmap {
+	int width, height ;			/* Size in pixels */
+	int stride ;				/* Bytes per row */
+	unsigned char *pixels ;			/* Pixel data */
+	int screen ;				/* True if flushed to the display */
+	int ndirty ;				/* Number of dirty rectangles */
+	struct slcd_s_rect dirty[SLCD_BITMAP_MAXDIRTY] ;
+	unsigned char *packbuf ;		/* Reused buffer for flushing */
+	int packsize ;				/* Size of packbuf */
+} lcd_bitmap ;
+
+/**
+ * lcd_bitmapcreate
+ * @width: width in pixels, or 0 for the display
+ * @height: height in pixels, or 0 for the display
+ *
+ * Creates a cleared surface.  With a zero size, the surface covers
+ * the graphics display, and lcd_bitmapflush() sends it there.
+ * Otherwise it is an off-screen surface, e.g. for icons or album
+ * art, to be drawn with lcd_bitmapblit().
+ * Returns NULL if out of memory, or if a screen surface is
+ * requested from a display without SLCD_HAS_GRAPHICS.
+ **/
+lcd_bitmap *lcd_bitmapcreate(int width, int height) ;
+
+/**
+ * lcd_bitmapdelete
+ * @bm: surface
+ *
+ * Frees the surface and its pixels.
+ **/
+void lcd_bitmapdelete(lcd_bitmap *bm) ;
+
+/**
+ * lcd_bitmapfill
+ * @bm: surface
+ * @x, @y, @w, @h: area to fill, clipped to the surface
+ * @mode: SLCD_PIXEL_ON, SLCD_PIXEL_OFF or SLCD_PIXEL_INVERT
+ *
+ * Fills a rectangle.
+ **/
+void lcd_bitmapfill(lcd_bitmap *bm, int x, int y, int w, int h, enum slcd_e_pixel mode) ;
+
+/**
+ * lcd_bitmapblit
+ * @dst: destination surface
+ * @dx, @dy: destination position
+ * @src: source surface
+ * @sx, @sy, @w, @h: source area
+ *
+ * Copies an area of one surface to another, clipped to both.
+ **/
+void lcd_bitmapblit(lcd_bitmap *dst, int dx, int dy, lcd_bitmap *src, int sx, int sy, int w, int h) ;
+
+/**
+ * lcd_bitmapdraw
+ * @bm: surface
+ * @x, @y: destination position
+ * @data: 1bpp pixels, each row packed MSB first into (w+7)/8 bytes
+ * @w, @h: size of the data in pixels
+ *
+ * Copies packed pixel data onto the surface.
+ **/
+void lcd_bitmapdraw(lcd_bitmap *bm, int x, int y, const unsigned char *data, int w, int h) ;
+
+/**
+ * lcd_bitmaptext
+ * @bm: surface
+ * @x, @y: position of the top left of the first character
+ * @str: UTF8 text
+ * @mode: SLCD_PIXEL_ON for dark on light, SLCD_PIXEL_OFF for light
+ *        on dark, or SLCD_PIXEL_INVERT to invert the glyph pixels only
+ *
+ * Renders text with the built in 5x7 font, in cells of
+ * SLCD_BITMAP_FONTWID x SLCD_BITMAP_FONTHEI pixels, which are
+ * cleared first unless inverting.  Characters outside ASCII
+ * are drawn as '?'.
+ * Returns the x position following the text.
+ **/
+int lcd_bitmaptext(lcd_bitmap *bm, int x, int y, char *str, enum slcd_e_pixel mode) ;
+
+/**
+ * lcd_bitmapicon
+ * @bm: surface
+ * @x, @y: destination position
+ * @icon: icon to draw
+ * @mode: as for lcd_bitmaptext()
+ *
+ * Draws one of the radio's icons in a SLCD_BITMAP_ICONSIZE square.
+ * Returns false if there is no bitmap for the icon.
+ **/
+int lcd_bitmapicon(lcd_bitmap *bm, int x, int y, enum slcd_e_icons icon, enum slcd_e_pixel mode) ;
+
+/**
+ * lcd_bitmapflush
+ * @bm: screen surface
+ *
+ * Sends the dirty rectangles of a screen surface to the display,
+ * one lcd_hwdrawbitmap() each, and marks the surface clean.
+ * Returns true on success, or false if the surface is off-screen
+ * or the display rejected a rectangle.
+ **/
+int lcd_bitmapflush(lcd_bitmap *bm) ;
+
+/**
+ * lcd_bitmapinvalidate
+ * @bm: surface
+ *
+ * Marks the whole surface dirty, e.g. after the text screen has
+ * been drawn over it.
+ **/
+void lcd_bitmapinvalidate(lcd_bitmap *bm) ;
+#endif
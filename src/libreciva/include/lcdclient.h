@@ -0,0 +1,106 @@
+/*
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github
+ *
+ * This file is part of the sharpfin project
+ * LCD compositor client
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Clients of the lcdd compositor daemon.
+ *
+ * lcdd owns the LCD.  Each client sends layers of text rows over a
+ * Unix datagram socket; lcdd shows, for every row, the text of the
+ * highest priority layer that sets it, and refreshes the display
+ * at most once per frame.  A client that finds no daemon running
+ * can fall back to lcd_init() and drive the display itself.
+ */
+#ifndef lcdclient_h_defined
+#define lcdclient_h_defined
+
+#define LCDD_SOCKET "/tmp/lcdd.sock"	/* Default socket, LCDD_SOCKET overrides */
+#define LCDD_MAGIC 0x4c434431		/* "LCD1" */
+#define LCDD_MAXROWS 8			/* Rows in a layer */
+#define LCDD_ROWLEN 64			/* Bytes per row, including terminator */
+
+/**
+ * enum lcdd_e_cmd
+ *
+ * Requests a client can send
+ **/
+enum lcdd_e_cmd {
+	LCDD_SET=1,		/* Create or replace a layer */
+	LCDD_CLEAR=2		/* Remove a layer */
+} ;
+
+/**
+ * struct lcdd_msg
+ *
+ * One datagram, carrying a whole layer
+ **/
+struct lcdd_msg {
+	unsigned int magic ;			/* LCDD_MAGIC */
+	int cmd ;				/* enum lcdd_e_cmd */
+	int layer ;				/* Layer identifier, chosen by the client */
+	int priority ;				/* Higher priority layers are shown on top */
+	int timeout ;				/* Milliseconds until removed, 0 for never */
+	unsigned int mask ;			/* Bit n set if row n is set, others show through */
+	char rows[LCDD_MAXROWS][LCDD_ROWLEN] ;	/* UTF8 text for each row */
+} ;
+
+/**
+ * lcd_clientopen
+ *
+ * Connects to the lcdd daemon.  Returns a socket to pass to
+ * the other lcd_client functions, or -1 if lcdd is not running.
+ **/
+int lcd_clientopen() ;
+
+/**
+ * lcd_clientset
+ * @fd: socket from lcd_clientopen()
+ * @layer: layer identifier
+ * @priority: layer priority, higher is on top
+ * @timeout: milliseconds until the layer is removed, or 0
+ * @rows: text for each row, NULL to let lower layers show through
+ * @nrows: number of entries in rows, up to LCDD_MAXROWS
+ *
+ * Creates or replaces a layer.  Rows longer than LCDD_ROWLEN-1
+ * bytes are truncated.  Returns true on success.
+ **/
+int lcd_clientset(int fd, int layer, int priority, int timeout, char **rows, int nrows) ;
+
+/**
+ * lcd_clientclear
+ * @fd: socket from lcd_clientopen()
+ * @layer: layer identifier
+ *
+ * Removes a layer.  Returns true on success.
+ **/
+int lcd_clientclear(int fd, int layer) ;
+
+/**
+ * lcd_clientclose
+ * @fd: socket from lcd_clientopen()
+ *
+ * Disconnects from lcdd.  The client's layers stay until they
+ * time out or are cleared.
+ **/
+void lcd_clientclose(int fd) ;
+#endif
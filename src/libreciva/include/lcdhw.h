@@ -36,6 +36,10 @@
 #ifndef lcd_h_defined
 #define lcd_h_defined
 #include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 /**
  * enum slcd_e_status
  *
@@ -123,7 +127,8 @@ enum slcd_e_clkmode {
  * lcd_init() initialises the LCD hardware, allocating memory, 
  * clearing the screen, and setting the initial states of the 
  * cursor and backlight.  lcd_init() must be called before
- * any of the lcd functions can be used.
+ * any of the lcd functions can be used, and before other
+ * threads are started.
  * Returns true on success, or false on memory allocation failure.
  **/ 
 int lcd_init() ;
@@ -136,6 +141,34 @@ int lcd_init() ;
  **/
 void lcd_exit() ;
 
+/**
+ * lcd_lock
+ *
+ * Takes the display lock, which serialises access to the display
+ * and the screen buffer behind the lcd_hw* functions.  The lcd
+ * library takes it itself where needed, and it may be taken again
+ * by the thread holding it.  A thread calling the lcd_hw* functions
+ * directly should hold it from the first call to lcd_hwrefresh(),
+ * so that other threads cannot draw in between.
+ **/
+void lcd_lock() ;
+
+/**
+ * lcd_unlock
+ *
+ * Releases the display lock taken by lcd_lock().
+ **/
+void lcd_unlock() ;
+
+/**
+ * lcd_tickbacklight
+ * @level: new brightness level (0-100)
+ *
+ * Called by each backend's lcd_brightness(), so that lcd_tickwait()
+ * can stop scrolling while the backlight is off.
+ **/
+void lcd_tickbacklight(int level) ;
+
 /**
  * lcd_capabilities
  *
@@ -291,4 +324,43 @@ char ** lcd_hwgetscreen() ;
  * the next lcd_hwrefresh()
  **/
 enum slcd_e_arrows * lcd_hwgetselrows() ;
+
+/**
+ * lcd_hwgraphicsize
+ * @width: set to the graphics display width in pixels
+ * @height: set to the graphics display height in pixels
+ *
+ * Returns true if the display has SLCD_HAS_GRAPHICS, or false
+ * (with both sizes set to zero) if it only shows text.
+ **/
+int lcd_hwgraphicsize(int *width, int *height) ;
+
+/**
+ * lcd_hwdrawbitmap
+ * @left, @top: position of the region on the display in pixels
+ * @width, @height: size of the region in pixels
+ * @data: 1bpp pixels, each row packed MSB first into (width+7)/8 bytes
+ *
+ * Sends a region of pixels straight to the display with one
+ * IOC_LCD_DRAW_BITMAP.  Returns true on success.
+ **/
+int lcd_hwdrawbitmap(int left, int top, int width, int height, unsigned char *data) ;
+
+/**
+ * lcd_hwgrabbitmap
+ * @data: destination, 1bpp rows packed MSB first into (width+7)/8 bytes
+ * @size: size of data in bytes
+ * @width, @height: set to the graphics display size in pixels
+ *
+ * Reads the whole graphics display back with one
+ * IOC_LCD_GRAB_SCREEN_REGION.  This works without lcd_init(), so
+ * it can capture what another program shows; call it with a NULL
+ * data to find the size needed.  Returns true if the pixels were
+ * read, or false if the display has no graphics or data is too small.
+ **/
+int lcd_hwgrabbitmap(unsigned char *data, int size, int *width, int *height) ;
+
+#ifdef __cplusplus
+}
+#endif
 #endif
@@ -26,6 +26,7 @@
 enum log_to {
 	LOG_TO_STDERR = 1,
 	LOG_TO_SYSLOG = 2,
+	LOG_ASYNC = 4,		/* Queue lines, written by a background flusher */
 };
 
 enum log_level {
@@ -36,8 +37,19 @@ enum log_level {
 	LG_DBG,
 };
 
-#define logf(level, args...) log_entry(level, __FUNCTION__, args )
+/*
+ * Log lines above LOG_LEVEL_MAX are removed at compile time, e.g.
+ * build with CFLAGS+=-DLOG_LEVEL_MAX=LG_WRN for release firmware
+ */
+#ifndef LOG_LEVEL_MAX
+#define LOG_LEVEL_MAX LG_DBG
+#endif
+
+#define logf(level, args...) do { \
+	if ((level) <= LOG_LEVEL_MAX) log_entry(level, __FUNCTION__, args ); \
+} while (0)
 void log_init(char *progname, enum log_to to, enum log_level level, int color);
+void log_flush(void);
 void log_entry(enum log_level level, const char *func, char *fmt, ...)  __attribute__((format(printf, 3, 4)));
 void log_hexdump(char *txt, unsigned char *data, int len);
 #endif
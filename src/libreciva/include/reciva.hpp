@@ -0,0 +1,392 @@
+/*
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github
+ *
+ * This file is part of the sharpfin project
+ * C++ interface to libreciva
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Header only C++17 layer over lcd.h, key.h and dog.h.
+ *
+ * Each class owns one C handle, is move-only, and releases the
+ * handle in its destructor.  Every member is an inline call of
+ * the C function it wraps, so using the classes costs nothing
+ * over calling the C API by hand.  Like the C API, nothing
+ * throws but std::string copies: creation yields an empty object
+ * on failure, which tests false.
+ *
+ *	reciva::display lcd ;
+ *	reciva::menu m=reciva::menu::create() ;
+ *	m.assign(stations, [](auto &s) { return s.id ; },
+ *		[](auto &s) { return std::string_view(s.name) ; }) ;
+ *	m.refresh() ;
+ */
+#ifndef reciva_hpp_defined
+#define reciva_hpp_defined
+#if __cplusplus < 201703L
+#error "reciva.hpp needs C++17"
+#endif
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "lcd.h"
+#include "key.h"
+#include "dog.h"
+
+namespace reciva {
+
+namespace detail {
+/* Text for the C API, which takes "" but not NULL for an empty string */
+inline const char *text(std::string_view s) noexcept { return s.empty() ? "" : s.data() ; }
+}
+
+/**
+ * class display
+ *
+ * Initialises the LCD for the lifetime of the object.
+ **/
+class display {
+public:
+	display() noexcept : ok_(lcd_init()) { }
+	~display() { if (ok_) lcd_exit() ; }
+	display(const display &)=delete ;
+	display &operator=(const display &)=delete ;
+	explicit operator bool() const noexcept { return ok_ ; }
+	int width() const noexcept { return lcd_width() ; }
+	int height() const noexcept { return lcd_height() ; }
+	enum slcd_e_caps capabilities() const noexcept { return lcd_capabilities() ; }
+	void brightness(int level) const noexcept { lcd_brightness(level) ; }
+	void contrast(int level) const noexcept { lcd_contrast(level) ; }
+	bool icon(enum slcd_e_icons icon, bool on) const noexcept {
+		return lcd_seticon(icon, on ? SLCD_ON : SLCD_OFF) ;
+	}
+	void tick() const noexcept { lcd_tick() ; }
+	/* Milliseconds until tick() is next needed, or -1 */
+	int tick_wait() const noexcept { return lcd_tickwait() ; }
+	int tick_auto() const noexcept { return lcd_tickauto() ; }
+private:
+	bool ok_ ;
+} ;
+
+/**
+ * struct display_mutex
+ *
+ * The display lock, for std::lock_guard / std::unique_lock.
+ **/
+struct display_mutex {
+	void lock() noexcept { lcd_lock() ; }
+	void unlock() noexcept { lcd_unlock() ; }
+} ;
+
+/**
+ * class screen
+ *
+ * Owns an lcd_handle.  Base of the screen types below.
+ **/
+class screen {
+public:
+	screen() noexcept : h_(nullptr) { }
+	explicit screen(lcd_handle *h) noexcept : h_(h) { }
+	~screen() { if (h_!=nullptr) lcd_delete(h_) ; }
+	screen(const screen &)=delete ;
+	screen &operator=(const screen &)=delete ;
+	screen(screen &&o) noexcept : h_(o.h_) { o.h_=nullptr ; }
+	screen &operator=(screen &&o) noexcept {
+		if (this!=&o) {
+			if (h_!=nullptr) lcd_delete(h_) ;
+			h_=o.h_ ;
+			o.h_=nullptr ;
+		}
+		return *this ;
+	}
+	explicit operator bool() const noexcept { return h_!=nullptr ; }
+	lcd_handle *get() const noexcept { return h_ ; }
+	lcd_handle *release() noexcept { lcd_handle *h=h_ ; h_=nullptr ; return h ; }
+	void refresh() const noexcept { lcd_refresh(h_) ; }
+protected:
+	lcd_handle *h_ ;
+} ;
+
+/**
+ * class menu_base
+ *
+ * What stored and virtual menus have in common: moving and reading
+ * the selection.
+ **/
+class menu_base : public screen {
+public:
+	bool up() noexcept { return lcd_menucontrol(h_, SLCD_UP) ; }
+	bool down() noexcept { return lcd_menucontrol(h_, SLCD_DOWN) ; }
+	int selected_id() const noexcept { return lcd_menugetselid(h_) ; }
+	/* A copy, as lcd_menugetsels() only lasts until its next call */
+	std::string selected_text() const { return lcd_menugetsels(h_) ; }
+protected:
+	menu_base() noexcept { }
+	explicit menu_base(lcd_handle *h) noexcept : screen(h) { }
+} ;
+
+/**
+ * class menu
+ *
+ * A menu of text entries, each with an ID number.  Text is copied
+ * once, straight from the caller's string into the menu.
+ **/
+class menu : public menu_base {
+public:
+	menu() noexcept { }
+	static menu create() noexcept { return menu(lcd_menucreate()) ; }
+
+	bool add(int id, std::string_view text, bool selected=false) noexcept {
+		return lcd_menuaddentryn(h_, id, detail::text(text), (int)text.size(),
+			selected ? SLCD_SELECTED : SLCD_NOTSELECTED) ;
+	}
+
+	/* Replaces the entries with one per element of range */
+	template <class Range, class IdOf, class TextOf>
+	bool assign(const Range &range, IdOf id_of, TextOf text_of) {
+		lcd_menuclear(h_) ;
+		for (const auto &e : range) {
+			if (!add(id_of(e), text_of(e))) return false ;
+		}
+		return true ;
+	}
+
+	/* Replaces the entries with the strings of range, numbered from 0 */
+	template <class Range>
+	bool assign(const Range &range) {
+		int id=0 ;
+		lcd_menuclear(h_) ;
+		for (const auto &e : range) {
+			if (!add(id++, std::string_view(e))) return false ;
+		}
+		return true ;
+	}
+
+	/* Entries by ID number, see lcd_menusetentry() */
+	bool set(int id, std::string_view text) noexcept {
+		return lcd_menusetentryn(h_, id, detail::text(text), (int)text.size()) ;
+	}
+	bool remove(int id) noexcept { return lcd_menuremoveentry(h_, id) ; }
+	bool move(int id, int before_id=-1) noexcept { return lcd_menumoveentry(h_, id, before_id) ; }
+
+	bool clear() noexcept { return lcd_menuclear(h_) ; }
+	bool compact() noexcept { return lcd_menucompact(h_) ; }
+	void sort() noexcept { lcd_menusort(h_) ; }
+private:
+	explicit menu(lcd_handle *h) noexcept : menu_base(h) { }
+} ;
+
+/**
+ * class vmenu
+ *
+ * A virtual menu, producing entries on demand.  The source is any
+ * callable std::string_view(int index, int &id) which stays alive
+ * as long as the menu; its text is copied into the menu's cache.
+ * Entries cannot be added, changed or removed one by one.
+ **/
+class vmenu : public menu_base {
+public:
+	vmenu() noexcept { }
+
+	template <class Source>
+	static vmenu create(int count, Source &source) noexcept {
+		return vmenu(lcd_vmenucreate(count, &vmenu::fetch<Source>, &source)) ;
+	}
+	static vmenu create(const char *table, const int *offsets, int count) noexcept {
+		return vmenu(lcd_vmenucreatetable(table, offsets, count)) ;
+	}
+
+	bool set_count(int count) noexcept { return lcd_vmenusetcount(h_, count) ; }
+	bool select(int index) noexcept { return lcd_vmenuselect(h_, index) ; }
+	int selected() const noexcept { return lcd_vmenugetsel(h_) ; }
+private:
+	explicit vmenu(lcd_handle *h) noexcept : menu_base(h) { }
+
+	template <class Source>
+	static int fetch(void *data, int index, int *idnumber, char *buf, int maxlen) {
+		std::string_view s=(*static_cast<Source *>(data))(index, *idnumber) ;
+		size_t n=(s.size()<(size_t)maxlen) ? s.size() : (size_t)maxlen-1 ;
+		std::memcpy(buf, s.data(), n) ;
+		buf[n]='\0' ;
+		return SLCD_TRUE ;
+	}
+} ;
+
+/**
+ * class frame
+ *
+ * A screen of free text, one string per line.
+ **/
+class frame : public screen {
+public:
+	frame() noexcept { }
+	static frame create() noexcept { return frame(lcd_framecreate()) ; }
+
+	bool set_line(int line, std::string_view text) noexcept {
+		return lcd_framesetlinen(h_, line, detail::text(text), (int)text.size()) ;
+	}
+	/* As lcd_frameprintf(), with the format checked by the compiler */
+	bool printf(int line, const char *fmt, ...) noexcept __attribute__((format(printf, 3, 4))) {
+		char buf[256] ;
+		va_list va ;
+		int r ;
+		va_start(va, fmt) ;
+		r=std::vsnprintf(buf, sizeof(buf), fmt, va) ;
+		va_end(va) ;
+		if (r<0 || r>=(int)sizeof(buf)) return false ;
+		return lcd_framesetlinen(h_, line, buf, r) ;
+	}
+	bool bar(int line, int min, int max, int progress, enum slcd_e_bartype type) noexcept {
+		return lcd_framebar(h_, line, min, max, progress, type) ;
+	}
+	bool status(int line, bool showicons) noexcept {
+		return lcd_framestatus(h_, line, showicons ? SLCD_ON : SLCD_OFF)==SLCD_TRUE ;
+	}
+private:
+	explicit frame(lcd_handle *h) noexcept : screen(h) { }
+} ;
+
+/**
+ * class input
+ *
+ * Text entry into a caller's buffer, see lcd_inputcreate().
+ **/
+class input : public screen {
+public:
+	input() noexcept { }
+	static input create(char *selection, char *result, int maxlen) noexcept {
+		return input(lcd_inputcreate(selection, result, maxlen)) ;
+	}
+	/* Returns true when END is chosen */
+	bool control(enum slcd_e_inputctl cmd) noexcept { return lcd_inputcontrol(h_, cmd) ; }
+	/* Copies the text so far to the result buffer, and returns it */
+	char *result() noexcept { return lcd_inputgetresult(h_) ; }
+private:
+	explicit input(lcd_handle *h) noexcept : screen(h) { }
+} ;
+
+/**
+ * class yesno
+ *
+ * Choice between options, see lcd_yesnocreate().
+ **/
+class yesno : public screen {
+public:
+	yesno() noexcept { }
+	static yesno create(char *options, char *title, int defopt=0) noexcept {
+		return yesno(lcd_yesnocreate(options, title, defopt)) ;
+	}
+	bool control(enum slcd_e_inputctl cmd) noexcept { return lcd_yesnocontrol(h_, cmd) ; }
+	int result() const noexcept { return lcd_yesnoresult(h_) ; }
+private:
+	explicit yesno(lcd_handle *h) noexcept : screen(h) { }
+} ;
+
+/**
+ * class clock
+ *
+ * Clock screen, see lcd_clockcreate().
+ **/
+class clock : public screen {
+public:
+	clock() noexcept { }
+	static clock create(char *title) noexcept { return clock(lcd_clockcreate(title)) ; }
+	void set_alarm(struct tm *alm, bool on) noexcept {
+		lcd_clocksetalarm(h_, alm, on ? SLCD_ON : SLCD_OFF) ;
+	}
+private:
+	explicit clock(lcd_handle *h) noexcept : screen(h) { }
+} ;
+
+/**
+ * class keys
+ *
+ * Owns a key_handler.
+ **/
+class keys {
+public:
+	keys() noexcept : h_(nullptr) { }
+	static keys open() noexcept { return keys(key_init()) ; }
+	~keys() { if (h_!=nullptr) key_exit(h_) ; }
+	keys(const keys &)=delete ;
+	keys &operator=(const keys &)=delete ;
+	keys(keys &&o) noexcept : h_(o.h_) { o.h_=nullptr ; }
+	keys &operator=(keys &&o) noexcept {
+		if (this!=&o) {
+			if (h_!=nullptr) key_exit(h_) ;
+			h_=o.h_ ;
+			o.h_=nullptr ;
+		}
+		return *this ;
+	}
+	explicit operator bool() const noexcept { return h_!=nullptr ; }
+	struct key_handler *get() const noexcept { return h_ ; }
+
+	/* Returns 1 with a key in ev, 0 if none is waiting, or -1 on error */
+	int poll(struct key &ev) noexcept { return key_poll(h_, &ev) ; }
+private:
+	explicit keys(struct key_handler *h) noexcept : h_(h) { }
+	struct key_handler *h_ ;
+} ;
+
+/**
+ * class watchdog
+ *
+ * Opens the watchdog for the lifetime of the object.
+ **/
+class watchdog {
+public:
+	watchdog() noexcept : ok_(dog_init()) { }
+	~watchdog() { if (ok_) dog_exit() ; }
+	watchdog(const watchdog &)=delete ;
+	watchdog &operator=(const watchdog &)=delete ;
+	explicit operator bool() const noexcept { return ok_ ; }
+	bool enable() const noexcept { return dog_enable()==0 ; }
+	bool disable() const noexcept { return dog_disable()==0 ; }
+	bool enabled() const noexcept { return dog_isenabled() ; }
+	bool kick() const noexcept { return dog_kick()==0 ; }
+private:
+	bool ok_ ;
+} ;
+
+/**
+ * class kick_scope
+ *
+ * Kicks the watchdog on entering and on leaving a scope, so that
+ * slow work up to one watchdog period long cannot reset the radio,
+ * however the scope is left.
+ **/
+class kick_scope {
+public:
+	explicit kick_scope(const watchdog &dog) noexcept : dog_(dog) { dog_.kick() ; }
+	~kick_scope() { dog_.kick() ; }
+	kick_scope(const kick_scope &)=delete ;
+	kick_scope &operator=(const kick_scope &)=delete ;
+private:
+	const watchdog &dog_ ;
+} ;
+
+static_assert(sizeof(menu)==sizeof(lcd_handle *), "menu must be a bare handle") ;
+static_assert(sizeof(keys)==sizeof(struct key_handler *), "keys must be a bare handle") ;
+
+}
+#endif
@@ -0,0 +1,188 @@
+/*
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github
+ *
+ * This file is part of the sharpfin project
+ * Station directory index
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Binary station index.
+ *
+ * stationdb_build() turns a text station list, one station per line as
+ *
+ *   id|name|genre,genre,...|url
+ *
+ * (e.g. written by xmlparse), into an index file holding a sorted string
+ * table, the stations sorted by name, a hash on the station ID, a first
+ * letter index on the names and a station list per genre.  The file is
+ * mmap()ed read-only by stationdb_open(), and nothing is parsed or
+ * copied: lookups by ID are constant time, by name prefix or genre
+ * logarithmic.
+ *
+ * Stations are numbered 0 to stationdb_count()-1 in name order, ignoring
+ * ASCII case, and genres 0 to stationdb_genrecount()-1 in name order.
+ * Returned strings point into the mapping and stay valid until
+ * stationdb_close().
+ */
+#ifndef stationdb_h_defined
+#define stationdb_h_defined
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct stationdb stationdb ;
+
+/**
+ * stationdb_build
+ * @in: station list, see above
+ * @fname: index file to write
+ *
+ * Builds an index file.  It is written next to fname and renamed over
+ * it, so readers that have the old index open are not disturbed.  Lines
+ * that are empty or start with '#' are skipped, as are lines without a
+ * name, and stations with an ID that was seen before.
+ * This function returns the number of stations, or -1 on error.
+ **/
+int stationdb_build(FILE *in, const char *fname) ;
+
+/**
+ * stationdb_open
+ * @fname: index file
+ *
+ * Maps an index file.
+ * This function returns a handle, or NULL in the event of an error.
+ **/
+stationdb *stationdb_open(const char *fname) ;
+
+/**
+ * stationdb_close
+ * @db: handle
+ *
+ * Unmaps the index and frees the handle.
+ **/
+void stationdb_close(stationdb *db) ;
+
+/**
+ * stationdb_count
+ * @db: handle
+ *
+ * Returns the number of stations.
+ **/
+int stationdb_count(stationdb *db) ;
+
+/**
+ * stationdb_id
+ * stationdb_name
+ * stationdb_url
+ * @db: handle
+ * @station: station number
+ *
+ * Return a station's fields, or NULL if there is no such station.
+ **/
+const char *stationdb_id(stationdb *db, int station) ;
+const char *stationdb_name(stationdb *db, int station) ;
+const char *stationdb_url(stationdb *db, int station) ;
+
+/**
+ * stationdb_stationgenres
+ * @db: handle
+ * @station: station number
+ * @genres: set to the station's genre numbers
+ *
+ * Returns the number of genres of the station.
+ **/
+int stationdb_stationgenres(stationdb *db, int station, const unsigned int **genres) ;
+
+/**
+ * stationdb_find
+ * @db: handle
+ * @id: station ID
+ *
+ * Returns the number of the station with this ID, or -1.
+ **/
+int stationdb_find(stationdb *db, const char *id) ;
+
+/**
+ * stationdb_prefix
+ * @db: handle
+ * @prefix: start of a name, ASCII case is ignored
+ * @first: set to the number of the first matching station
+ *
+ * The stations are sorted by name, so the matches are numbered
+ * *first onwards.
+ * Returns the number of stations whose name starts with prefix.
+ **/
+int stationdb_prefix(stationdb *db, const char *prefix, int *first) ;
+
+/**
+ * stationdb_genrecount
+ * @db: handle
+ *
+ * Returns the number of genres.
+ **/
+int stationdb_genrecount(stationdb *db) ;
+
+/**
+ * stationdb_genrename
+ * @db: handle
+ * @genre: genre number
+ *
+ * Returns the name of a genre, or NULL if there is no such genre.
+ **/
+const char *stationdb_genrename(stationdb *db, int genre) ;
+
+/**
+ * stationdb_findgenre
+ * @db: handle
+ * @name: genre name
+ *
+ * Returns the number of the genre with this name, or -1.
+ **/
+int stationdb_findgenre(stationdb *db, const char *name) ;
+
+/**
+ * stationdb_genrestations
+ * @db: handle
+ * @genre: genre number
+ * @stations: set to the genre's station numbers, in name order
+ *
+ * Returns the number of stations in the genre.
+ **/
+int stationdb_genrestations(stationdb *db, int genre, const unsigned int **stations) ;
+
+/**
+ * stationdb_strings
+ * stationdb_nameoffsets
+ * @db: handle
+ *
+ * The string table, and the offset of each station's name in it.  These
+ * can be given to lcd_vmenucreatetable() to browse all stations with the
+ * station numbers as entry IDs.
+ **/
+const char *stationdb_strings(stationdb *db) ;
+const int *stationdb_nameoffsets(stationdb *db) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -32,6 +32,7 @@
 #include <linux/watchdog.h>
 #include "dog.h"
 #include "log.h"
+#include "hwtrace.h"
 
 static int wd_fd=-1 ;
 static int wd_enabled=0 ;
@@ -72,12 +73,15 @@ void dog_exit() {
 
 int dog_enable() {
 	int r;
+	long long t0;
 	if (wd_fd==(-1)) {
 		logf(LG_ERR, "Unable to enable the dog, bad handle") ;
 		return -1 ;
 	} else {
 		wd_enabled=1 ;
+		t0 = HWTRACE_START();
 		r = ioctl(wd_fd, WDIOS_ENABLECARD);
+		HWTRACE_END("dog", WDIOS_ENABLECARD, 0, t0);
 		if(r != 0) {
 			logf(LG_WRN, "Error enabling watchdog: %s\n", strerror(errno));
 			return -1;
@@ -91,12 +95,15 @@ int dog_enable() {
  */
 int dog_disable() {
 	int r;
+	long long t0;
 	if (wd_fd==(-1)) {
 		logf(LG_ERR, "Unable to disable the dog, bad handle") ;
 		return -1 ;
 	} else {
 		wd_enabled=0 ;
+		t0 = HWTRACE_START();
 		r = ioctl(wd_fd, WDIOS_DISABLECARD);
+		HWTRACE_END("dog", WDIOS_DISABLECARD, 0, t0);
 		if(r != 0) {
 			logf(LG_WRN, "Error disabling watchdog: %s\n", strerror(errno));
 			return -1;
@@ -118,11 +125,14 @@ int dog_isenabled() {
 
 int dog_kick() {
 	char kick = '1';
+	long long t0;
 	if (wd_fd==(-1)) {
 		logf(LG_ERR, "Enable to kick the dog, bad handle") ;
 		return -1 ;
 	} else {
+		t0 = HWTRACE_START();
 		write(wd_fd, &kick, sizeof(kick));
+		HWTRACE_END("dog", HWTRACE_OP_WRITE, sizeof(kick), t0);
 		return 0 ;
 	}
 }
@@ -60,6 +60,7 @@
 #include "log.h"
 #include "key.h"
 #include "scr_devel.h"
+#include "lcdhw.h"
 #include <ncurses.h>
 
 static int translate_key(int chr, struct key *ev);
@@ -110,6 +111,9 @@ int key_poll(struct key_handler *eh, struct key *ev)
 	int sleepcount=0 ;
 	int r ;
 
+	/* Keyboard arrows are never coalesced, so every move is one row */
+	ev->count=1 ;
+
 	/* Simulate holding a key down */
 	if (sleepcount>0) {
 		sleepcount-- ;
@@ -129,6 +133,7 @@ int key_poll(struct key_handler *eh, struct key *ev)
 		/* Get the next key from the queue */
 		ev->id=qk[queuepos].id ;
 		ev->state=qk[queuepos].state ;
+		ev->time=qk[queuepos].time ;
 
 		queuepos++ ;
 		if (queuepos==queuesize) {
@@ -141,21 +146,28 @@ int key_poll(struct key_handler *eh, struct key *ev)
 
 	} else {
 
-		/* Handle input Keystrokes */
+		/* Handle input Keystrokes, ncurses is shared with the display */
 
+		lcd_lock() ;
 		r=getch() ;
+		gettimeofday(&ev->time, NULL) ;
+		if (r!=ERR) {
+			/* redraw everything to stop screen corruptions - NASTY HACK*/
+			touchwin(scr_get_lcdw()) ;
+			touchwin(scr_get_lcdl()) ;
+			touchwin(scr_get_logw()) ;
+			touchwin(scr_get_helpw()) ;
+			wrefresh(scr_get_helpw()) ;
+			wrefresh(scr_get_logw()) ;
+			wrefresh(scr_get_lcdl()) ;
+			wrefresh(scr_get_lcdw()) ;
+			refresh() ;
+		}
+		lcd_unlock() ;
 		if (r==ERR) return 0 ; /* No data waiting */
-	
-		/* redraw everything to stop screen corruptions - NASTY HACK*/
-		touchwin(scr_get_lcdw()) ;
-		touchwin(scr_get_lcdl()) ;
-		touchwin(scr_get_logw()) ;
-		touchwin(scr_get_helpw()) ;
-		wrefresh(scr_get_helpw()) ;
-		wrefresh(scr_get_logw()) ;
-		wrefresh(scr_get_lcdl()) ;
-		wrefresh(scr_get_lcdw()) ;
-		refresh() ;
+
+		/* The keys queued below were all pressed with this one */
+		qk[0].time=qk[1].time=qk[2].time=ev->time ;
 
 		switch (translate_key(r, ev)) {
 		case KEYPRESSED:
@@ -201,6 +213,11 @@ int key_poll(struct key_handler *eh, struct key *ev)
 	return -1 ;
 }
 
+void key_exit(struct key_handler *eh)
+{
+	free(eh) ;
+}
+
 
 int translate_key(int ch, struct key *k)
 {
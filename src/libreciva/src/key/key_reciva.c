@@ -32,9 +32,31 @@
 #include <sys/select.h>
 #include <linux/input.h>
 #include "../../include/key.h"
+#include "../../include/hwtrace.h"
 #define PATH_EVDEV "/dev/input/event%d"
 
+#define KEY_READ_BATCH 32
+#define IE_TYPE_BUTTON 1
+#define IE_TYPE_WHEEL 2
+
+/*
+ * Rotary acceleration curve: a tick arriving within 'ms' of the
+ * previous tick in the same direction moves 'rows' rows
+ */
+static const struct {
+	int ms;
+	int rows;
+} key_accel[] = {
+	{ 15, 8 },
+	{ 30, 4 },
+	{ 60, 2 },
+	{ -1, 1 }
+};
+
 static int translate_key(struct input_event *ie, struct key *ev);
+static void key_wheel(struct key_handler *eh, struct input_event *ie);
+static void key_queue(struct key_handler *eh, enum key_id id, enum key_state state, int count, struct timeval *time);
+static void key_queuewheel(struct key_handler *eh);
 
 /*
  * ident
@@ -62,53 +84,85 @@ struct key_handler *key_init(void) {
 	return eh;
 }
 
+void key_exit(struct key_handler *eh) {
+	int i;
+
+	if(eh == NULL) return;
+	for(i=0; i<EVENT_FD_COUNT; i++) {
+		if(eh->fd[i] != -1) close(eh->fd[i]);
+	}
+	free(eh);
+}
+
 int key_poll(struct key_handler *eh, struct key *ev) {
 	fd_set fds;
-	int i;
+	int i, j, n;
 	int fd_max = 0;
 	struct timeval tv;
 	int r;
-	struct input_event ie;
-
-	/*
-	 * Add all key file descriptors to the select's fd_set 
-	 */
-	FD_ZERO(&fds);
-	for(i=0; i<EVENT_FD_COUNT; i++) {
-		if(eh->fd[i] != -1) {
-			FD_SET(eh->fd[i], &fds);
-			if(eh->fd[i] > fd_max) fd_max = eh->fd[i];
+	struct input_event ie[KEY_READ_BATCH];
+	struct key k;
+	long long t0;
+
+	/* Keys left over from the last batch are returned first */
+	if(eh->queuelen == 0) {
+
+		/*
+		 * Add all key file descriptors to the select's fd_set 
+		 */
+		FD_ZERO(&fds);
+		for(i=0; i<EVENT_FD_COUNT; i++) {
+			if(eh->fd[i] != -1) {
+				FD_SET(eh->fd[i], &fds);
+				if(eh->fd[i] > fd_max) fd_max = eh->fd[i];
+			}
 		}
-	}
-	/* Wait 0 seconds: return right away */
-	tv.tv_sec = 0;
-	tv.tv_usec = 0;
-	/* Check if any data is available on the file descriptors */
-	r = select(fd_max+1, &fds, NULL, NULL, &tv);
-	/* Error or no data: return right away */
-	if(r == -1) return -1;	/* Select returned error */
-	if(r == 0) return 0;	/* Timeout, no data waiting */
-
-	/* One or more keys are waiting: read from key device and translate to
-	 * key struct */
-	for(i=0; i<EVENT_FD_COUNT; i++) {
-		if(eh->fd[i] != -1) {
-			if(FD_ISSET(eh->fd[i], &fds)) {
-				r = read(eh->fd[i], &ie, sizeof(ie));
-				if(r < sizeof(ie)) return -1;
-				return translate_key(&ie, ev);
-
+		/* Wait 0 seconds: return right away */
+		tv.tv_sec = 0;
+		tv.tv_usec = 0;
+		/* Check if any data is available on the file descriptors */
+		t0 = HWTRACE_START();
+		r = select(fd_max+1, &fds, NULL, NULL, &tv);
+		HWTRACE_END("key", HWTRACE_OP_SELECT, 0, t0);
+		/* Error or no data: return right away */
+		if(r == -1) return -1;	/* Select returned error */
+		if(r == 0) return 0;	/* Timeout, no data waiting */
+
+		/* Drain every waiting device with one read each, translating
+		 * buttons in order and adding up the wheel ticks */
+		for(i=0; i<EVENT_FD_COUNT; i++) {
+			if(eh->fd[i] != -1 && FD_ISSET(eh->fd[i], &fds)) {
+				t0 = HWTRACE_START();
+				r = read(eh->fd[i], ie, sizeof(ie));
+				HWTRACE_END("key", HWTRACE_OP_READ, r > 0 ? r : 0, t0);
+				if(r < (int)sizeof(ie[0])) return -1;
+				n = r / sizeof(ie[0]);
+				for(j=0; j<n; j++) {
+					if(ie[j].type == IE_TYPE_WHEEL) {
+						key_wheel(eh, &ie[j]);
+					} else if(translate_key(&ie[j], &k)) {
+						/* Keep the wheel move ahead of the button */
+						key_queuewheel(eh);
+						key_queue(eh, k.id, k.state, 1, &k.time);
+					}
+				}
 			}
 		}
+
+		/* One aggregated wheel move for the whole batch */
+		key_queuewheel(eh);
+		if(eh->queuelen == 0) return 0;
 	}
-	return 0;
+
+	*ev = eh->queue[eh->queuehead];
+	eh->queuehead = (eh->queuehead + 1) % KEY_QUEUE_LEN;
+	eh->queuelen--;
+	return 1;
 }
 
 /*
  * Translate a linux HID input key to a reciva-key
  */
-#define IE_TYPE_BUTTON 1
-#define IE_TYPE_WHEEL 2
 #define IE_CODE_SHIFT 309
 #define IE_CODE_BACK 265
 #define IE_CODE_SELECT 263
@@ -137,15 +191,8 @@ static int translate_key(struct input_event *ie, struct key *key) {
 				default: return 0; break;
 			}
 			key->state = ie->value;
-			return 1;
-		case IE_TYPE_WHEEL:
-
-			if(ie->value == -1) {
-				key->id = KEY_ID_LEFT;
-			} else {
-				key->id = KEY_ID_RIGHT;
-			}
-			key->state = KEY_STATE_PRESSED;
+			key->count = 1;
+			key->time = ie->time;
 			return 1;
 		default:
 			return 0;
@@ -153,3 +200,46 @@ static int translate_key(struct input_event *ie, struct key *key) {
 	return 0;
 }
 
+/*
+ * Add one wheel tick to the pending move, scaled by how quickly
+ * it followed the previous tick in the same direction
+ */
+static void key_wheel(struct key_handler *eh, struct input_event *ie) {
+	long now;
+	int dir, i;
+
+	now = ie->time.tv_sec * 1000L + ie->time.tv_usec / 1000;
+	dir = (ie->value < 0) ? -1 : 1;
+
+	/* A change of direction stops any acceleration */
+	if(dir != eh->wheeldir) {
+		key_queuewheel(eh);
+		eh->wheeldir = dir;
+		i = sizeof(key_accel)/sizeof(key_accel[0]) - 1;
+	} else {
+		for(i=0; key_accel[i].ms >= 0 && now - eh->wheellast >= key_accel[i].ms; i++) ;
+	}
+	eh->wheellast = now;
+	/* The move is as old as its first tick */
+	if(eh->wheel == 0) eh->wheeltime = ie->time;
+	eh->wheel += dir * key_accel[i].rows;
+}
+
+/* Queue a translated key, dropping it if the queue is full */
+static void key_queue(struct key_handler *eh, enum key_id id, enum key_state state, int count, struct timeval *time) {
+	struct key *k;
+	if(eh->queuelen == KEY_QUEUE_LEN) return;
+	k = &eh->queue[(eh->queuehead + eh->queuelen) % KEY_QUEUE_LEN];
+	k->id = id;
+	k->state = state;
+	k->count = count;
+	k->time = *time;
+	eh->queuelen++;
+}
+
+/* Turn the pending wheel ticks into a single LEFT/RIGHT key */
+static void key_queuewheel(struct key_handler *eh) {
+	if(eh->wheel < 0) key_queue(eh, KEY_ID_LEFT, KEY_STATE_PRESSED, -eh->wheel, &eh->wheeltime);
+	if(eh->wheel > 0) key_queue(eh, KEY_ID_RIGHT, KEY_STATE_PRESSED, eh->wheel, &eh->wheeltime);
+	eh->wheel = 0;
+}
@@ -0,0 +1,196 @@
+/* 
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github 
+ *
+ * This file is part of the sharpfin project
+ *  
+ * This Library is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Scripted key input for the headless (virtual) backend.
+ *
+ * Keys are queued with key_virtual_script() / key_virtual_push(),
+ * or from the KEY_VIRTUAL_SCRIPT environment variable at key_init(),
+ * and handed out one per key_poll() call.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "log.h"
+#include "key.h"
+#include "lcd_virtual.h"
+
+#define KEY_DUMPFRAME (-1)
+
+static struct key *queue=NULL ;
+static int queuesize=0, queuelen=0, queuepos=0 ;
+static pthread_mutex_t queuelock=PTHREAD_MUTEX_INITIALIZER ;	/* Keys may be pushed from any thread */
+
+static const struct {
+	char *name ;
+	enum key_id id ;
+} keynames[] = {
+	{ "1", KEY_ID_1 },
+	{ "2", KEY_ID_2 },
+	{ "3", KEY_ID_3 },
+	{ "4", KEY_ID_4 },
+	{ "5", KEY_ID_5 },
+	{ "shift", KEY_ID_SHIFT },
+	{ "back", KEY_ID_BACK },
+	{ "select", KEY_ID_SELECT },
+	{ "reply", KEY_ID_REPLY },
+	{ "power", KEY_ID_POWER },
+	{ "left", KEY_ID_LEFT },
+	{ "right", KEY_ID_RIGHT },
+	{ "volup", KEY_ID_VOLUP },
+	{ "voldn", KEY_ID_VOLDN },
+	{ "browse", KEY_ID_BROWSE },
+	{ NULL, 0 }
+} ;
+
+static int key_enqueue(int id, enum key_state state, int stamp) ;
+
+/*
+ * ident
+ */
+
+char *key_ident() {
+        return "$Id: key_virtual.c 233 2012-01-01 00:00:00Z  $" ;
+}
+
+struct key_handler *key_init(void) {
+	struct key_handler *eh;
+	char *script ;
+	int i ;
+
+	/* We don't need this structure, but allocate anyway */
+	eh = calloc(sizeof *eh, 1);
+	if (eh==NULL) return NULL ;
+	for (i=0; i<EVENT_FD_COUNT; i++) eh->fd[i]=-1 ;
+
+	script=getenv("KEY_VIRTUAL_SCRIPT") ;
+	if (script!=NULL && key_virtual_script(script)<0) {
+		logf(LG_ERR, "bad KEY_VIRTUAL_SCRIPT") ;
+	}
+	return eh;
+}
+
+void key_exit(struct key_handler *eh)
+{
+	free(eh) ;
+}
+
+int key_poll(struct key_handler *eh, struct key *ev)
+{
+	int found ;
+
+	while (1) {
+		pthread_mutex_lock(&queuelock) ;
+		found=(queuepos<queuelen) ;
+		if (found) {
+			*ev=queue[queuepos++] ;
+			if (queuepos==queuelen) {
+				queuepos=0 ;
+				queuelen=0 ;
+			}
+		}
+		pthread_mutex_unlock(&queuelock) ;
+		/* Scripted keys are pressed as soon as they are reached */
+		if (found && !timerisset(&ev->time)) gettimeofday(&ev->time, NULL) ;
+		if (found && (int)ev->id==KEY_DUMPFRAME) {
+			lcd_virtual_dumpframe(stdout) ;
+			continue ;
+		}
+		return found ;
+	}
+}
+
+int key_virtual_push(enum key_id id, enum key_state state)
+{
+	return key_enqueue(id, state, (1==1)) ;
+}
+
+int key_virtual_script(char *script)
+{
+	char name[16] ;
+	int n, i, r, count=0 ;
+	char *p ;
+
+	if (script==NULL) return 0 ;
+	for (p=script; *p!='\0'; ) {
+		/* Extract the next word */
+		while (*p==' ' || *p=='\t' || *p=='\n') p++ ;
+		if (*p=='\0') break ;
+		for (i=0; *p!='\0' && *p!=' ' && *p!='\t' && *p!='\n' && *p!='*'; p++) {
+			if (i<(int)sizeof(name)-1) name[i++]=*p ;
+		}
+		name[i]='\0' ;
+		n=1 ;
+		if (*p=='*') {
+			n=strtol(p+1, &p, 10) ;
+			if (n<1) return -1 ;
+		}
+
+		/* Queue it n times */
+		if (strcmp(name, "dump")==0) {
+			for (r=0; r<n; r++) if (!key_enqueue(KEY_DUMPFRAME, KEY_STATE_PRESSED, (1==0))) return -1 ;
+			continue ;
+		}
+		for (i=0; keynames[i].name!=NULL && strcmp(keynames[i].name, name)!=0; i++) ;
+		if (keynames[i].name==NULL) {
+			logf(LG_ERR, "unknown key '%s'", name) ;
+			return -1 ;
+		}
+		for (r=0; r<n; r++, count++) {
+			if (!key_enqueue(keynames[i].id, KEY_STATE_PRESSED, (1==0))) return -1 ;
+			/* The wheel has no release, buttons do */
+			if (keynames[i].id!=KEY_ID_LEFT && keynames[i].id!=KEY_ID_RIGHT &&
+				!key_enqueue(keynames[i].id, KEY_STATE_RELEASED, (1==0))) return -1 ;
+		}
+	}
+	return count ;
+}
+
+/* Appends a key to the queue, growing it as needed; unstamped keys get their time when polled */
+static int key_enqueue(int id, enum key_state state, int stamp)
+{
+	struct key *q ;
+	pthread_mutex_lock(&queuelock) ;
+	if (queuelen==queuesize) {
+		q=realloc(queue, sizeof(struct key)*(queuesize+64)) ;
+		if (q==NULL) {
+			pthread_mutex_unlock(&queuelock) ;
+			logf(LG_FTL, "memory allocation failure") ;
+			return (1==0) ;
+		}
+		queue=q ;
+		queuesize+=64 ;
+	}
+	queue[queuelen].id=id ;
+	queue[queuelen].state=state ;
+	queue[queuelen].count=1 ;
+	timerclear(&queue[queuelen].time) ;
+	if (stamp) gettimeofday(&queue[queuelen].time, NULL) ;
+	queuelen++ ;
+	pthread_mutex_unlock(&queuelock) ;
+	return (1==1) ;
+}
@@ -32,6 +32,12 @@
 #include <time.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <pthread.h>
 /*************************
  * Local Variables, defs and types
  *************************/
@@ -43,20 +49,134 @@
  * (if any) scrolling is required.
  **/
 static lcd_handle *lcd_currentscreen=NULL ;
+
+/**
+ * lcd_drawnscreen
+ *
+ * The menu whose rows are in the display buffer, if any, so that
+ * lcd_refresh() only needs to redraw the rows marked dirty.
+ **/
+static lcd_handle *lcd_drawnscreen=NULL ;
+
+/**
+ * lcd_tickgov
+ *
+ * State of the tick governor (see lcd_tickwait()), protected by
+ * the display lock.  Times are in monotonic milliseconds.
+ **/
+static struct {
+	int scrollms, idlems, idleafter ;	/* Rates, see lcd_tickrate() */
+	long lastscroll ;			/* Last refresh, which steps scrolling rows */
+	long lastactivity ;			/* Last lcd_refresh() not from lcd_tick() */
+	time_t shownmin ;			/* Minute (time()/60) last drawn */
+	int backlightoff ;			/* Scrolling is paused */
+	int ticking ;				/* Inside lcd_tick() */
+} lcd_tickgov={300, 1000, 60000, 0, 0, -1, SLCD_FALSE, SLCD_FALSE} ;
+
+/**
+ * lcd_displaylock
+ *
+ * Recursive lock serialising the display, the current screen
+ * and the mirror.  Handles have their own lock, always taken
+ * after this one.
+ **/
+static pthread_mutex_t lcd_displaylock ;
+static pthread_mutexattr_t lcd_lockattr ;
+static pthread_once_t lcd_lockonce=PTHREAD_ONCE_INIT ;
+static void lcd_lockinit() ;
+
+/**
+ * struct slcd_s_mirror
+ *
+ * Text copy of the screen, kept in a POSIX shared memory segment
+ * so that other processes can read it with lcd_fetch() without
+ * touching the display.  seq is a seqlock generation counter: it
+ * is odd while the text is being rewritten.
+ *
+ * The seqlock only works with one writer, so the first process to
+ * publish takes an exclusive flock() on the segment and keeps it
+ * until it exits.  Other processes only read it, and try for the
+ * lock again at most once a second.
+ **/
+#define SLCD_MIRROR_NAME "/sharpfin-lcd"
+#define SLCD_MIRROR_MAGIC 0x4c43444d
+#define SLCD_MIRROR_TEXTSIZE 2048
+#define SLCD_MIRROR_RETRIES 100
+struct slcd_s_mirror {
+	unsigned int magic ;			/* SLCD_MIRROR_MAGIC once initialised */
+	volatile unsigned int seq ;		/* Generation, odd while writing */
+	int len ;				/* Bytes of text, excluding terminator */
+	char text[SLCD_MIRROR_TEXTSIZE] ;	/* lcd_dumpscreen() output */
+} ;
+static struct slcd_s_mirror *lcd_mirror=NULL ;		/* Segment written by this process */
+static struct slcd_s_mirror *lcd_mirrorreader=NULL ;	/* Segment read by this process */
+static int lcd_mirrorfailed=SLCD_FALSE ;
+static int lcd_mirrorfd=-1 ;				/* Holds the writer's flock() */
+static time_t lcd_mirrortried=0 ;			/* Last try for the writer's lock */
+static char *lcd_mirrorname() ;
+static struct slcd_s_mirror *lcd_mirrormap(int writable) ;
+static void lcd_mirrorpublish() ;
+static void *lcd_arenaalloc(lcd_handle *handle, int size) ;
+static struct slcd_s_arena *lcd_arenafree(struct slcd_s_arena *arena, int keep) ;
+static int lcd_arenaused(lcd_handle *handle) ;
+static int lcd_rowtextsize(struct slcd_s_row *row) ;
+static int lcd_rowsettext(lcd_handle *handle, struct slcd_s_row *row, const char *str, int bytes) ;
+static void lcd_rowdecode(int *cpoff, char *s, int len) ;
+static struct slcd_s_row *lcd_vmenurow(lcd_handle *handle, int index) ;
+static int lcd_vmenutable(void *data, int index, int *idnumber, char *buf, int maxlen) ;
+static void lcd_vmenuflush(lcd_handle *handle, int release) ;
+static int lcd_menuindex(lcd_handle *handle) ;
+static unsigned int lcd_menuhash(int idnumber, int size) ;
+static void lcd_menuindexadd(lcd_handle *handle, struct slcd_s_row *row) ;
+static void lcd_menuindexdel(lcd_handle *handle, struct slcd_s_row *row) ;
+static struct slcd_s_row *lcd_menufind(lcd_handle *handle, int idnumber) ;
+static void lcd_menuunlink(lcd_handle *handle, struct slcd_s_row *row) ;
+static int lcd_menurowpos(lcd_handle *handle, struct slcd_s_row *row) ;
+static void lcd_menuview(lcd_handle *handle) ;
+static void lcd_menureclaim(lcd_handle *handle) ;
+static long lcd_tickclock() ;
+static int lcd_tickscrolls(lcd_handle *handle) ;
 static char *lcd_textbuildscrollingline(struct slcd_s_row *row) ;
-static char *lcd_inputbuildscrollingline(char *selstr, int selection) ;
-static char *lcd_inputbuildinputline(char *src, int bol, int cursor) ;
+static char *lcd_inputbuildscrollingline(lcd_handle *handle) ;
+static char *lcd_inputbuildinputline(lcd_handle *handle) ;
+static int lcd_inputdecode(struct slcd_s_inputcell *cells, int n, char *str) ;
+static void lcd_inputstep(lcd_handle *handle, int dir) ;
+static void lcd_inputedit(lcd_handle *handle, struct slcd_s_inputcell *cell) ;
 static int lcd_getnextcharacterpos(char *str, int curpos) ;
-static int lcd_getprevcharacterpos(char *str, int curpos)  ;
-static int lcd_insertchar(char *str, int pos, char ch, int maxlen) ;
 static int lcd_strcatc(char *buf, int maxlen, char c) ;
 static int lcd_strlen(char *buf) ;
-static char * lcd_getutf8char(char *str, int pos) ;
+static int lcd_strnlen(const char *buf, int bytes) ;
+static char * lcd_getutf8char(char *str, int pos, char *utf8) ;
 static char *lcd_parsespecial(char *t) ;
 //static void lcd_dumpvars(lcd_handle *handle, char *comment, int n) ;
 #define SLCD_PRINTF_BUFSIZE 256
 #define SLCD_TEXTBUF_MAXLEN 128
 #define SLCD_TABSIZE 4
+#define SLCD_UTF8_MAXLEN 3	/* Longest character lcd_getutf8char() returns */
+#define SLCD_ARENA_BLKSIZE 16384
+#define SLCD_ARENA_ALIGN(n) (((n)+sizeof(double)-1)&~(sizeof(double)-1))
+#define SLCD_INDEX_MINSIZE 64
+#define SLCD_DIRTY_ALL (~0U)
+
+/*
+ * Character of an input screen's selection, decoded once by
+ * lcd_inputcreate() so that moving the chooser and rendering
+ * it need no UTF8 parsing or string compares.
+ */
+enum slcd_e_inputact {
+	SLCD_INPUT_INSERT = 0,
+	SLCD_INPUT_DEL,
+	SLCD_INPUT_LEFT,
+	SLCD_INPUT_RIGHT,
+	SLCD_INPUT_END
+} ;
+struct slcd_s_inputcell {
+	char u8[SLCD_UTF8_MAXLEN+1] ;		/* Character inserted */
+	char glyph[SLCD_UTF8_MAXLEN+1] ;	/* Character shown in the chooser */
+	unsigned char len, glyphlen ;		/* Bytes in u8 and glyph */
+	unsigned char action ;			/* enum slcd_e_inputact */
+	unsigned char stop ;			/* False for the ND and EL cells */
+} ;
 
 /*
  * ident
@@ -88,15 +208,34 @@ lcd_handle *lcd_menucreate() {
 	}
 	
 	h->type=SLCD_MENU ;
+	pthread_once(&lcd_lockonce, lcd_lockinit) ;
+	pthread_mutex_init(&h->lock, &lcd_lockattr) ;
 	h->top=NULL ;
 	h->end=NULL ;
 	h->tsc=NULL ;
 	h->curl=NULL ;
 	h->numrows=0 ;
-
-	h->linebuf=malloc(sizeof(char)*lcd_width()*3+1) ;
+	h->arena=NULL ;
+	h->arenawaste=0 ;
+	h->idindex=NULL ;
+	h->idindexsize=0 ;
+	h->dirty=SLCD_DIRTY_ALL ;
+	h->vcount=0 ;
+	h->vtop=0 ;
+	h->vsel=0 ;
+	h->vfunc=NULL ;
+	h->vdata=NULL ;
+	h->vtable=NULL ;
+	h->voffsets=NULL ;
+	h->vclock=0 ;
+	h->vcache=NULL ;
+	h->selcopy=NULL ;
+	h->selcopysize=0 ;
+
+	h->linebuf=malloc(sizeof(char)*lcd_width()*4+1) ;
 	if (h->linebuf==NULL) {
 		logf(LG_FTL, "memory allocation failure") ;
+		pthread_mutex_destroy(&h->lock) ;
 		free(h) ;
 		return NULL ;
 	}
@@ -115,7 +254,11 @@ lcd_handle *lcd_menucreate() {
 	h->inputcursorpos=0 ;
 	h->inputbolpos=0 ;
 	h->result=NULL ;
-	h->selectopts=NULL ;
+	h->inputcells=NULL ;
+	h->inputncells=0 ;
+	h->inputtext=NULL ;
+	h->inputgap=0 ;
+	h->inputgapend=0 ;
 	h->maxlen=0 ;
 	
 	/* YesNo specific parameters */
@@ -135,26 +278,96 @@ lcd_handle *lcd_menucreate() {
  *
  **/
 int lcd_menuclear(lcd_handle *handle) {
-	struct slcd_s_row *p, *q ;
 	if (handle==NULL) {
 		logf(LG_ERR, "attempt to clear NULL menu") ;
 		return SLCD_FALSE ;
 	}
 
-	/* Free up linked list memory */
-	p=handle->top ;
+	/* Drop the linked list, and release its storage in one go, */
+	/* keeping a block to rebuild the menu in */
+	pthread_mutex_lock(&handle->lock) ;
 	handle->tsc=NULL ;
 	handle->curl=NULL ;
 	handle->top=NULL ;
-	handle->numrows=0 ;
-	if (handle->end!=NULL) handle->end->next=NULL ;
 	handle->end=NULL ;
-	while (p!=NULL) {
-		if (p->str!=NULL) free(p->str) ;
-		q=p ;
-		p=p->next ;
-		free(q) ;
+	handle->numrows=0 ;
+	handle->arena=lcd_arenafree(handle->arena, SLCD_TRUE) ;
+	handle->arenawaste=0 ;
+	if (handle->idindex!=NULL) memset(handle->idindex, 0, handle->idindexsize*sizeof(struct slcd_s_row *)) ;
+	handle->dirty=SLCD_DIRTY_ALL ;
+	pthread_mutex_unlock(&handle->lock) ;
+	return SLCD_TRUE ;
+}
+
+/**
+ * lcd_menucompact
+ * @handle: handle of screen buffer
+ *
+ * This function copies the rows still in use into fresh storage,
+ * and releases the space held by text that has since been replaced.
+ * It is called automatically once replaced and removed text takes
+ * more space than the live rows, so it is rarely needed.
+ * The function returns true on success, and false if out of memory.
+ **/
+int lcd_menucompact(lcd_handle *handle) {
+	struct slcd_s_arena *old ;
+	struct slcd_s_row *p, *q, *first=NULL, *last=NULL ;
+	struct slcd_s_row *tsc=NULL, *curl=NULL ;
+	int r, size ;
+
+	if (handle==NULL) {
+		logf(LG_ERR, "attempt to compact NULL menu") ;
+		return SLCD_FALSE ;
 	}
+	pthread_mutex_lock(&handle->lock) ;
+	if (handle->top==NULL) {
+		pthread_mutex_unlock(&handle->lock) ;
+		return SLCD_TRUE ;
+	}
+
+	/* Copy the rows in list order into a new arena */
+	old=handle->arena ;
+	handle->arena=NULL ;
+	for (r=0, p=handle->top; r<handle->numrows; r++, p=p->next) {
+		size=lcd_rowtextsize(p) ;
+		q=lcd_arenaalloc(handle, sizeof(struct slcd_s_row)) ;
+		if (q!=NULL) q->cpoff=lcd_arenaalloc(handle, size) ;
+		if (q!=NULL) q->cpsize=SLCD_ARENA_ALIGN(size) ;
+		if (q==NULL || q->cpoff==NULL) {
+			/* Leave the menu as it was */
+			lcd_arenafree(handle->arena, SLCD_FALSE) ;
+			handle->arena=old ;
+			pthread_mutex_unlock(&handle->lock) ;
+			return SLCD_FALSE ;
+		}
+		memcpy(q->cpoff, p->cpoff, size) ;
+		q->str=(char *)&q->cpoff[p->len+1] ;
+		q->idnumber=p->idnumber ;
+		q->scrollpos=p->scrollpos ;
+		q->len=p->len ;
+		if (p==handle->tsc) tsc=q ;
+		if (p==handle->curl) curl=q ;
+		if (first==NULL) first=q ;
+		else last->next=q ;
+		q->prev=last ;
+		last=q ;
+	}
+	first->prev=last ;
+	last->next=first ;
+
+	handle->top=first ;
+	handle->end=last ;
+	handle->tsc=tsc ;
+	handle->curl=curl ;
+	handle->arenawaste=0 ;
+	lcd_arenafree(old, SLCD_FALSE) ;
+
+	/* The rows have moved, so index them again */
+	if (handle->idindex!=NULL) {
+		memset(handle->idindex, 0, handle->idindexsize*sizeof(struct slcd_s_row *)) ;
+		for (r=0, p=handle->top; r<handle->numrows; r++, p=p->next) lcd_menuindexadd(handle, p) ;
+	}
+	pthread_mutex_unlock(&handle->lock) ;
 	return SLCD_TRUE ;
 }
  
@@ -173,24 +386,43 @@ int lcd_menuclear(lcd_handle *handle) {
  * The function returns true on success, and false if out of memory.
  **/
 int lcd_menuaddentry(lcd_handle *handle, int idnumber, char *str, enum slcd_e_select selected) {
+	if (str==NULL) return SLCD_FALSE ;
+	return lcd_menuaddentryn(handle, idnumber, str, strlen(str), selected) ;
+}
+
+/**
+ * lcd_menuaddentryn
+ * @handle: handle of screen buffer
+ * @idnumber: user's reference number
+ * @str: text of the entry, need not be NUL terminated
+ * @len: length of str in bytes
+ * @selected: entry is the currently selected line
+ *
+ * As lcd_menuaddentry(), for text that is not NUL terminated,
+ * e.g. part of a larger buffer.  The text is copied once, straight
+ * into the menu's storage.  It ends at the first NUL, if any.
+ * The function returns true on success, and false if out of memory.
+ **/
+int lcd_menuaddentryn(lcd_handle *handle, int idnumber, const char *str, int len, enum slcd_e_select selected) {
 	struct slcd_s_row *row ;
-	if (handle==NULL || str==NULL) return SLCD_FALSE ;
-	/* Allocate and fill new row data */
-	row=malloc(sizeof(struct slcd_s_row)) ;
-	if (row==NULL) {
-		logf(LG_FTL, "memory allocation failure") ;
+	if (handle==NULL || str==NULL || len<0) return SLCD_FALSE ;
+	if (handle->type==SLCD_VMENU) {
+		logf(LG_ERR, "cannot add entries to a virtual menu") ;
 		return SLCD_FALSE ;
 	}
-	row->idnumber=idnumber ;
-	row->scrollpos=0 ;
-	row->str=malloc(strlen(str)+1) ;
-	if (row->str==NULL) {
-		logf(LG_FTL, "memory allocation failure") ;
-		free(row) ;
+	/* Allocate and fill new row data */
+	pthread_mutex_lock(&handle->lock) ;
+	row=lcd_arenaalloc(handle, sizeof(struct slcd_s_row)) ;
+	if (row!=NULL) {
+		row->idnumber=idnumber ;
+		row->str=NULL ;
+		row->cpoff=NULL ;
+		row->cpsize=0 ;
+	}
+	if (row==NULL || !lcd_rowsettext(handle, row, str, len)) {
+		pthread_mutex_unlock(&handle->lock) ;
 		return SLCD_FALSE ;
 	}
-	strcpy(row->str, str) ;
-	row->len=lcd_strlen(str) ;
 	
 	/* Create the linked list - note that the linked list is designed to be */
 	/* circular, so that the menu entries wrap around with the minimum */
@@ -218,6 +450,9 @@ int lcd_menuaddentry(lcd_handle *handle, int idnumber, char *str, enum slcd_e_se
 	
 	/* Increment the row count and return */
 	handle->numrows++ ;
+	if (handle->idindex!=NULL) lcd_menuindexadd(handle, row) ;
+	handle->dirty=SLCD_DIRTY_ALL ;
+	pthread_mutex_unlock(&handle->lock) ;
 	return SLCD_TRUE ;
 }
 
@@ -236,8 +471,14 @@ void lcd_menusort(lcd_handle *handle) {
 		logf(LG_FTL, "NULL handle passed to function") ;
 		return ;
 	}
+	if (handle->type==SLCD_VMENU) {
+		logf(LG_ERR, "cannot sort a virtual menu") ;
+		return ;
+	}
+	pthread_mutex_lock(&handle->lock) ;
 	if (handle->top==NULL || handle->numrows<2) {
 		logf(LG_INF, "Screen has insufficient lines") ;
+		pthread_mutex_unlock(&handle->lock) ;
 		return ;
 	}
 	
@@ -270,6 +511,8 @@ void lcd_menusort(lcd_handle *handle) {
 	}
 	/* put current line at top of screen */
 	handle->tsc=handle->curl ;
+	handle->dirty=SLCD_DIRTY_ALL ;
+	pthread_mutex_unlock(&handle->lock) ;
 }
  
 /**
@@ -291,10 +534,37 @@ int lcd_menucontrol(lcd_handle *handle, enum slcd_e_menuctl cmd) {
 		logf(LG_FTL, "NULL handle passed to function") ;
 		return SLCD_FALSE ;
 	}
+
+	/* Virtual menus move by index, wrapping in the same way */
+	pthread_mutex_lock(&handle->lock) ;
+	if (handle->type==SLCD_VMENU) {
+		if (handle->vcount==0) {
+			logf(LG_INF, "screen has no lines") ;
+			pthread_mutex_unlock(&handle->lock) ;
+			return SLCD_FALSE ;
+		}
+		lcd_vmenurow(handle, handle->vsel)->scrollpos=0 ;
+		switch (cmd) {
+		case SLCD_UP:
+			if (handle->vcount>lcd_height() && handle->vsel==handle->vtop)
+				handle->vtop=(handle->vtop+handle->vcount-1)%handle->vcount ;
+			handle->vsel=(handle->vsel+handle->vcount-1)%handle->vcount ;
+			break ;
+		case SLCD_DOWN:
+			if (handle->vcount>lcd_height() && 
+					handle->vsel==(handle->vtop+lcd_height()-1)%handle->vcount)
+				handle->vtop=(handle->vtop+1)%handle->vcount ;
+			handle->vsel=(handle->vsel+1)%handle->vcount ;
+			break ;
+		}
+		pthread_mutex_unlock(&handle->lock) ;
+		return SLCD_TRUE ;
+	}
 	
 	/* The screen has no lines, so return */
 	if (handle->curl==NULL) {
 		logf(LG_INF, "screen has no lines") ;
+		pthread_mutex_unlock(&handle->lock) ;
 		return SLCD_FALSE ;
 	}
 	
@@ -321,6 +591,8 @@ int lcd_menucontrol(lcd_handle *handle, enum slcd_e_menuctl cmd) {
 		handle->curl=handle->curl->next ;
 		break ;
 	}
+	handle->dirty=SLCD_DIRTY_ALL ;
+	pthread_mutex_unlock(&handle->lock) ;
 	return SLCD_TRUE ;
 }
 
@@ -331,43 +603,369 @@ int lcd_menucontrol(lcd_handle *handle, enum slcd_e_menuctl cmd) {
  * This function returns the selected line's idnumber.
  **/
 int lcd_menugetselid(lcd_handle *handle) {
+	int id=-1 ;
 	/* Invalid pointer, so return */
 	if (handle==NULL) {
 		logf(LG_FTL, "NULL handle passed to function") ;
 		return -1 ;
 	}
+	pthread_mutex_lock(&handle->lock) ;
+	if (handle->type==SLCD_VMENU) {
+		if (handle->vcount>0) id=lcd_vmenurow(handle, handle->vsel)->idnumber ;
+	}
 	/* The screen has no lines, so return */
 	else if (handle->curl==NULL) {
 		logf(LG_INF, "screen has no lines") ;
-		return -1 ;
 	}
-	else return handle->curl->idnumber ;
+	else id=handle->curl->idnumber ;
+	pthread_mutex_unlock(&handle->lock) ;
+	return id ;
 }
 
 /**
  * lcd_menugetsels
  * @handle: handle of the screen buffer
  *
- * This function returns a pointer to selected line's string
+ * This function returns a pointer to a copy of the selected line's
+ * string, valid until the next call for the same handle.
  **/
 char *lcd_menugetsels(lcd_handle *handle) {
+	char *str="" ;
+	char *p ;
+	int size ;
 	/* Invalid pointer, so return */
 	if (handle==NULL) {
 		logf(LG_FTL, "NULL handle passed to function") ;
 		return "" ;
 	}
+	pthread_mutex_lock(&handle->lock) ;
+	if (handle->type==SLCD_VMENU) {
+		if (handle->vcount>0) str=lcd_vmenurow(handle, handle->vsel)->str ;
+	}
 	/* The screen has no lines, so return */
 	else if (handle->curl==NULL) {
 		logf(LG_INF, "screen has no lines") ;
-		return "" ;
 	}
 	/* Memory pointers all wrong ... */
 	else if (handle->curl->str==NULL) {
 		logf(LG_FTL, "current line invalid.  Was there a memory allocation error?") ;
-		return "" ;
 	}
-	else return handle->curl->str ;
+	else str=handle->curl->str ;
+
+	/* Copy it out, as the row may be rewritten, compacted or evicted from the cache */
+	size=strlen(str)+1 ;
+	if (size>handle->selcopysize) {
+		p=realloc(handle->selcopy, size) ;
+		if (p==NULL) {
+			logf(LG_FTL, "memory allocation failure") ;
+			pthread_mutex_unlock(&handle->lock) ;
+			return "" ;
+		}
+		handle->selcopy=p ;
+		handle->selcopysize=size ;
+	}
+	memcpy(handle->selcopy, str, size) ;
+	str=handle->selcopy ;
+	pthread_mutex_unlock(&handle->lock) ;
+	return str ;
+}
+
+/**
+ * lcd_menusetentry
+ * @handle: handle of screen buffer
+ * @idnumber: ID number of the entry
+ * @str: new text for the entry
+ *
+ * This function replaces the text of the menu entry with the
+ * given ID number, found through an index rather than a search,
+ * so that live lists can be kept up to date cheaply.  The
+ * selection does not move, and the next lcd_refresh() only
+ * redraws the entry's row.  ID numbers should be unique for this
+ * and the other by-ID functions.  The new text overwrites the old
+ * where it fits, otherwise the old text's space is reclaimed later
+ * by an automatic lcd_menucompact().
+ * The function returns true on success, and false if there is
+ * no such entry, or out of memory.
+ **/
+int lcd_menusetentry(lcd_handle *handle, int idnumber, char *str) {
+	if (str==NULL) return SLCD_FALSE ;
+	return lcd_menusetentryn(handle, idnumber, str, strlen(str)) ;
+}
+
+/**
+ * lcd_menusetentryn
+ * @handle: handle of screen buffer
+ * @idnumber: ID number of the entry
+ * @str: new text for the entry, need not be NUL terminated
+ * @len: length of str in bytes
+ *
+ * As lcd_menusetentry(), for text that is not NUL terminated.
+ **/
+int lcd_menusetentryn(lcd_handle *handle, int idnumber, const char *str, int len) {
+	struct slcd_s_row *row ;
+	int pos, ok ;
+
+	if (handle==NULL || str==NULL || len<0 || handle->type!=SLCD_MENU) {
+		logf(LG_ERR, "NULL / non-menu handle or NULL text passed to function") ;
+		return SLCD_FALSE ;
+	}
+	pthread_mutex_lock(&handle->lock) ;
+	row=lcd_menufind(handle, idnumber) ;
+	ok=(row!=NULL && lcd_rowsettext(handle, row, str, len)) ;
+	if (ok) {
+		pos=lcd_menurowpos(handle, row) ;
+		if (pos>=0) handle->dirty|=1U<<pos ;
+		lcd_menureclaim(handle) ;
+	}
+	pthread_mutex_unlock(&handle->lock) ;
+	return ok ;
+}
+
+/**
+ * lcd_menuremoveentry
+ * @handle: handle of screen buffer
+ * @idnumber: ID number of the entry
+ *
+ * This function removes the menu entry with the given ID number.
+ * If it was selected, the entry below it is selected (or above,
+ * for the last entry); otherwise the selection does not move.
+ * The function returns true on success, and false if there is
+ * no such entry.
+ **/
+int lcd_menuremoveentry(lcd_handle *handle, int idnumber) {
+	struct slcd_s_row *row ;
+	int pos ;
+
+	if (handle==NULL || handle->type!=SLCD_MENU) {
+		logf(LG_ERR, "NULL / non-menu handle passed to function") ;
+		return SLCD_FALSE ;
+	}
+	pthread_mutex_lock(&handle->lock) ;
+	row=lcd_menufind(handle, idnumber) ;
+	if (row==NULL) {
+		pthread_mutex_unlock(&handle->lock) ;
+		return SLCD_FALSE ;
+	}
+
+	/* Rows below it on the screen move up */
+	pos=lcd_menurowpos(handle, row) ;
+	handle->dirty|=(pos>=0) ? ~((1U<<pos)-1) : SLCD_DIRTY_ALL ;
+
+	if (row==handle->curl) {
+		row->scrollpos=0 ;
+		handle->curl=(row==handle->end) ? row->prev : row->next ;
+	}
+	lcd_menuindexdel(handle, row) ;
+	lcd_menuunlink(handle, row) ;
+	handle->numrows-- ;
+	if (handle->numrows==0) {
+		handle->top=NULL ;
+		handle->end=NULL ;
+		handle->tsc=NULL ;
+		handle->curl=NULL ;
+	}
+	lcd_menuview(handle) ;
+
+	/* The row stays in the arena until it is compacted */
+	handle->arenawaste+=SLCD_ARENA_ALIGN(sizeof(struct slcd_s_row))+row->cpsize ;
+	lcd_menureclaim(handle) ;
+	pthread_mutex_unlock(&handle->lock) ;
+	return SLCD_TRUE ;
+}
+
+/**
+ * lcd_menumoveentry
+ * @handle: handle of screen buffer
+ * @idnumber: ID number of the entry to move
+ * @beforeid: ID number of the entry to put it in front of, or -1
+ *
+ * This function moves the menu entry with ID number idnumber in
+ * front of the entry with ID number beforeid, or to the bottom of
+ * the menu if beforeid is -1.  The selected entry stays selected.
+ * The function returns true on success, and false if either entry
+ * does not exist.
+ **/
+int lcd_menumoveentry(lcd_handle *handle, int idnumber, int beforeid) {
+	struct slcd_s_row *row, *before=NULL ;
+	int pos, pos2 ;
+
+	if (handle==NULL || handle->type!=SLCD_MENU) {
+		logf(LG_ERR, "NULL / non-menu handle passed to function") ;
+		return SLCD_FALSE ;
+	}
+	pthread_mutex_lock(&handle->lock) ;
+	row=lcd_menufind(handle, idnumber) ;
+	if (beforeid!=-1) before=lcd_menufind(handle, beforeid) ;
+	if (row==NULL || (beforeid!=-1 && before==NULL)) {
+		pthread_mutex_unlock(&handle->lock) ;
+		return SLCD_FALSE ;
+	}
+	if (row==before || (before==NULL && row==handle->end) || 
+			(row->next==before && before!=handle->top)) {
+		pthread_mutex_unlock(&handle->lock) ;
+		return SLCD_TRUE ;
+	}
+
+	/* Rows from the higher of the two places on the screen shift */
+	pos=lcd_menurowpos(handle, row) ;
+	pos2=(before!=NULL) ? lcd_menurowpos(handle, before) : -1 ;
+	if (pos<0 || (pos2>=0 && pos2<pos)) pos=pos2 ;
+	handle->dirty|=(pos>=0) ? ~((1U<<pos)-1) : SLCD_DIRTY_ALL ;
+
+	/* Take it out, and link it in again in front of before (or top, which is after end) */
+	lcd_menuunlink(handle, row) ;
+	if (before==NULL) before=handle->top ;
+	row->prev=before->prev ;
+	row->next=before ;
+	before->prev->next=row ;
+	before->prev=row ;
+	if (beforeid==-1) handle->end=row ;
+	else if (before==handle->top) handle->top=row ;
+	lcd_menuview(handle) ;
+	pthread_mutex_unlock(&handle->lock) ;
+	return SLCD_TRUE ;
+}
+
+/*************************
+ * Virtual Menu Control Functions
+ *************************/
+
+/**
+ * lcd_vmenucreate
+ * @count: number of entries
+ * @func: callback producing an entry's text and ID number
+ * @data: passed to func
+ *
+ * The lcd_vmenucreate function creates a menu whose entries are
+ * not stored, but produced by func when they come on screen, and
+ * kept in a small cache.  Opening and scrolling the menu therefore
+ * costs the same whatever its size.
+ * This function returns a handle, or NULL in the event of an error.
+ **/
+lcd_handle *lcd_vmenucreate(int count, lcd_vmenufunc func, void *data) {
+	lcd_handle *h ;
+	int i ;
+
+	if (func==NULL || count<0) {
+		logf(LG_ERR, "invalid virtual menu") ;
+		return NULL ;
+	}
+	h=lcd_menucreate() ;
+	if (h==NULL) return NULL ;
+	h->type=SLCD_VMENU ;
+	h->vcount=count ;
+	h->vfunc=func ;
+	h->vdata=data ;
+
+	h->vcache=malloc(sizeof(struct slcd_s_vslot)*SLCD_VMENU_CACHE) ;
+	if (h->vcache==NULL) {
+		logf(LG_FTL, "memory allocation failure") ;
+		lcd_delete(h) ;
+		return NULL ;
+	}
+	for (i=0; i<SLCD_VMENU_CACHE; i++) {
+		h->vcache[i].index=-1 ;
+		h->vcache[i].used=0 ;
+		h->vcache[i].size=0 ;
+		h->vcache[i].row.cpoff=NULL ;
+	}
+	return h ;
+}
+
+/**
+ * lcd_vmenucreatetable
+ * @table: block of NUL terminated UTF8 strings, e.g. an mmap()ed file
+ * @offsets: byte offset of each entry's string in table
+ * @count: number of entries
+ *
+ * Creates a virtual menu reading its entries in place from a string
+ * table, which must stay valid until the handle is deleted.  The ID
+ * number of each entry is its index.
+ * This function returns a handle, or NULL in the event of an error.
+ **/
+lcd_handle *lcd_vmenucreatetable(const char *table, const int *offsets, int count) {
+	lcd_handle *h ;
 
+	if (table==NULL || offsets==NULL) {
+		logf(LG_ERR, "invalid string table") ;
+		return NULL ;
+	}
+	h=lcd_vmenucreate(count, lcd_vmenutable, NULL) ;
+	if (h==NULL) return NULL ;
+	h->vdata=h ;
+	h->vtable=table ;
+	h->voffsets=offsets ;
+	return h ;
+}
+
+/**
+ * lcd_vmenusetcount
+ * @handle: handle of virtual menu
+ * @count: new number of entries
+ *
+ * Tells the menu that its entries have changed, discarding any
+ * cached text, and keeping the selection where possible.
+ * The function returns true on success.
+ **/
+int lcd_vmenusetcount(lcd_handle *handle, int count) {
+	if (handle==NULL || handle->type!=SLCD_VMENU || count<0) {
+		logf(LG_ERR, "invalid virtual menu") ;
+		return SLCD_FALSE ;
+	}
+	pthread_mutex_lock(&handle->lock) ;
+	lcd_vmenuflush(handle, SLCD_FALSE) ;
+	handle->vcount=count ;
+	if (handle->vsel>=count) handle->vsel=(count>0) ? count-1 : 0 ;
+	if (handle->vtop>handle->vsel || count<=lcd_height()) handle->vtop=0 ;
+	if (count>0) lcd_vmenuselect(handle, handle->vsel) ;
+	pthread_mutex_unlock(&handle->lock) ;
+	return SLCD_TRUE ;
+}
+
+/**
+ * lcd_vmenuselect
+ * @handle: handle of virtual menu
+ * @index: entry to select
+ *
+ * Selects an entry, scrolling the menu to show it if necessary.
+ * The function returns true on success, or false if index is
+ * out of range.
+ **/
+int lcd_vmenuselect(lcd_handle *handle, int index) {
+	if (handle==NULL || handle->type!=SLCD_VMENU) {
+		logf(LG_ERR, "invalid virtual menu") ;
+		return SLCD_FALSE ;
+	}
+	pthread_mutex_lock(&handle->lock) ;
+	if (index<0 || index>=handle->vcount) {
+		pthread_mutex_unlock(&handle->lock) ;
+		return SLCD_FALSE ;
+	}
+	handle->vsel=index ;
+	if (handle->vcount<=lcd_height()) {
+		handle->vtop=0 ;
+	} else if ((index-handle->vtop+handle->vcount)%handle->vcount>=lcd_height()) {
+		/* Off screen, so bring it to the top, or the bottom near the end */
+		handle->vtop=index ;
+		if (index>handle->vcount-lcd_height()) handle->vtop=handle->vcount-lcd_height() ;
+	}
+	pthread_mutex_unlock(&handle->lock) ;
+	return SLCD_TRUE ;
+}
+
+/**
+ * lcd_vmenugetsel
+ * @handle: handle of virtual menu
+ *
+ * This function returns the selected entry's index, or -1.
+ **/
+int lcd_vmenugetsel(lcd_handle *handle) {
+	int sel ;
+	if (handle==NULL || handle->type!=SLCD_VMENU) return -1 ;
+	pthread_mutex_lock(&handle->lock) ;
+	sel=(handle->vcount>0) ? handle->vsel : -1 ;
+	pthread_mutex_unlock(&handle->lock) ;
+	return sel ;
 }
 
 /*************************
@@ -412,35 +1010,45 @@ lcd_handle *lcd_framecreate() {
  * The function returns true on success, and false if out of memory.
  **/
 int lcd_framesetline(lcd_handle *handle, int line, char *str) {
+	if (str==NULL) {
+		logf(LG_FTL, "NULL text passed to function") ;
+		return SLCD_FALSE ;
+	}
+	return lcd_framesetlinen(handle, line, str, strlen(str)) ;
+}
+
+/**
+ * lcd_framesetlinen
+ * @handle: handle of screen buffer
+ * @line: line number to set
+ * @str: text for the line, need not be NUL terminated
+ * @len: length of str in bytes
+ *
+ * As lcd_framesetline(), for text that is not NUL terminated.
+ * The function returns true on success, and false if out of memory.
+ **/
+int lcd_framesetlinen(lcd_handle *handle, int line, const char *str, int len) {
 	struct slcd_s_row *p ;
-	int len ;
+	int ok ;
 	/* Invalid pointer, so return */
-	if (handle==NULL || str==NULL) {
+	if (handle==NULL || str==NULL || len<0) {
 		logf(LG_FTL, "NULL handle / text passed to function") ;
 		return SLCD_FALSE ;
 	}
+	pthread_mutex_lock(&handle->lock) ;
 	/* The screen has no lines, so return */
-	else if (handle->top==NULL) {
+	if (handle->top==NULL) {
 		logf(LG_INF, "screen has no lines") ;
+		pthread_mutex_unlock(&handle->lock) ;
 		return SLCD_FALSE ;
 	}
 	/* Scan through list, looking for line (idnumber) */
 	for (p=handle->top; p!=handle->end && p->idnumber!=line; p=p->next) ;
-	if (p->idnumber!=line) return SLCD_FALSE ;
-	/* re-allocate memory */
-	if (p->str!=NULL) free(p->str) ;
-	len=strlen(str)+1 ;
-	p->str=malloc(len) ;
-	if (p->str==NULL) {
-		logf(LG_FTL, "memory allocation failure") ;
-		return SLCD_FALSE ;
-	}
-	p->str[0]='\0' ;
-	/* copy string */
-	strcpy(p->str, str) ;
-	p->scrollpos=0 ;
-	p->len=lcd_strlen(p->str) ;
-	return SLCD_TRUE ;
+	/* copy string (and decode it for scrolling) */
+	ok=(p->idnumber==line && lcd_rowsettext(handle, p, str, len)) ;
+	if (ok) lcd_menureclaim(handle) ;
+	pthread_mutex_unlock(&handle->lock) ;
+	return ok ;
 }
 
 /**
@@ -488,7 +1096,7 @@ int lcd_frameprintf(lcd_handle *handle, int line, char *fmt, ...) {
  **/
 int lcd_framebar(lcd_handle *handle, int line, int min, int max, int progress, enum slcd_e_bartype type)
 {
-	int i, l ;
+	int i, l, r ;
 	char half[4], whole[4] ;
 
 	/* Invalid pointer, so return */
@@ -510,6 +1118,7 @@ int lcd_framebar(lcd_handle *handle, int line, int min, int max, int progress, e
 	
 	l= ( ( ( lcd_width()-2 ) * 2 * (progress-min) ) / (max-min) ) ;
 	
+	pthread_mutex_lock(&handle->lock) ;
 	strcpy(handle->linebuf,"|") ;
 	for (i=0; i<(l-2); i+=2) {
 		strcat(handle->linebuf, whole) ;
@@ -530,7 +1139,9 @@ int lcd_framebar(lcd_handle *handle, int line, int min, int max, int progress, e
 	while (lcd_strlen(handle->linebuf)<(lcd_width()-1)) strcat(handle->linebuf," ") ;
 	strcat(handle->linebuf,"|") ;
 
-	return lcd_framesetline(handle, line, handle->linebuf) ;
+	r=lcd_framesetline(handle, line, handle->linebuf) ;
+	pthread_mutex_unlock(&handle->lock) ;
+	return r ;
 }
 
 /**
@@ -566,8 +1177,10 @@ enum slcd_e_status lcd_framestatus(lcd_handle *handle, int line, enum slcd_e_sta
 		logf(LG_FTL, "NULL handle passed to function") ;
 		return SLCD_FALSE ;
 	}
+	pthread_mutex_lock(&handle->lock) ;
 	handle->statusrow=line ;
 	handle->showicons=showicons ;
+	pthread_mutex_unlock(&handle->lock) ;
 	return SLCD_TRUE ;
 }
 
@@ -586,14 +1199,16 @@ enum slcd_e_status lcd_framestatus(lcd_handle *handle, int line, enum slcd_e_sta
  * with the top line having a scrolling selection e.g. "abcd <e> fghi".
  * The function automatically adds DEL LEFT RIGHT and END
  * strings to the selection, and populates the result line with
- * the contents of result as a preset. result is kept up-to-date
- * with the current contents of the display.
+ * the contents of result as a preset.  The text is edited in the
+ * handle, and copied back to result when END is selected, or
+ * when lcd_inputgetresult() is called.
  * This function returns a handle, which is used for future 
  * screen operations, or NULL in the case of an error.
  */
 lcd_handle *lcd_inputcreate(char *selection, char *result, int maxlen)
 {
 	lcd_handle *h ;
+	int n, len ;
 	
 	/* Invalid pointer, so return */
 	if (result==NULL || selection==NULL) {
@@ -606,26 +1221,33 @@ lcd_handle *lcd_inputcreate(char *selection, char *result, int maxlen)
 		return NULL ;
 	}
 	
-	/* Check that the selection is not too long */
-	if (strlen(selection)>(SLCD_TEXTBUF_MAXLEN-strlen(SLCD_USTR_INPUTMENU)-1)) {
-		logf(LG_ERR, "selection too long") ;
-		return NULL ;
-	}
-	
 	/* Allocate / Create the a lcdif_handle structure */
 	h=lcd_framecreate() ;
 	if (h==NULL) return NULL ;
 	h->type=SLCD_INPUT ;
 
-	/* Store the selection */
-	h->selectopts=malloc(strlen(selection)+strlen(SLCD_USTR_INPUTMENU)+1) ;
-	if (h->selectopts==NULL) {
+	/* Decode the selection, followed by DEL LEFT RIGHT and END */
+	n=lcd_inputdecode(NULL, 0, selection)+lcd_inputdecode(NULL, 0, SLCD_USTR_INPUTMENU) ;
+	h->inputcells=malloc(n*sizeof(struct slcd_s_inputcell)) ;
+	/* The text is kept in a gap buffer, with the gap at the cursor */
+	h->inputtext=malloc(maxlen) ;
+	if (h->inputcells==NULL || h->inputtext==NULL) {
 		logf(LG_FTL, "memory allocation failure") ;
 		lcd_delete(h) ;
 		return NULL ;
 	}
-	strcpy(h->selectopts, selection) ;
-	strcat(h->selectopts, SLCD_USTR_INPUTMENU) ;
+	n=lcd_inputdecode(h->inputcells, 0, selection) ;
+	h->inputncells=lcd_inputdecode(h->inputcells, n, SLCD_USTR_INPUTMENU) ;
+
+	/* Preset the text from result, cut to a whole character, cursor at the end */
+	len=strlen(result) ;
+	if (len>maxlen-1) {
+		len=maxlen-1 ;
+		while (len>0 && (result[len]&'\xC0')=='\x80') len-- ;
+	}
+	memcpy(h->inputtext, result, len) ;
+	h->inputgap=len ;
+	h->inputgapend=maxlen-1 ;
 
 	/* Store a pointer to result */
 	h->result=result ;
@@ -707,16 +1329,17 @@ int lcd_inputprintf(lcd_handle *handle, int line, char *fmt, ...)
  **/
 int lcd_inputcontrol(lcd_handle *handle, enum slcd_e_inputctl cmd)
 {
-	char *u8 ;
+	struct slcd_s_inputcell *cell ;
 		
 	if (handle==NULL) {
 		logf(LG_ERR, "NULL handle passed to function") ;
 		return SLCD_TRUE ; /* Return as if END found */
 	}
+	pthread_mutex_lock(&handle->lock) ;
 	
 	/* Initialise cursor position */
 	if (handle->inputbolpos<0) {
-		handle->inputcursorpos=strlen(handle->result) ;
+		handle->inputcursorpos=lcd_strnlen(handle->inputtext, handle->inputgap) ;
 		if (handle->inputcursorpos < lcd_width()) {
 			handle->inputbolpos=0 ;
 		} else {
@@ -724,72 +1347,20 @@ int lcd_inputcontrol(lcd_handle *handle, enum slcd_e_inputctl cmd)
 		}
 	}
 	
-	if (cmd==SLCD_LEFT) {
-		/* Move MENU Chooser String to the Left */
-		handle->inputselectedopt=lcd_getprevcharacterpos(handle->selectopts, 
-			handle->inputselectedopt) ;
-		/* Skip ND and EL */
-		u8=lcd_getutf8char(handle->selectopts, handle->inputselectedopt) ;
-		while (strcmp(u8, SLCD_UCHR_END2)==0 || strcmp(u8, SLCD_UCHR_END3)==0 ||
-				strcmp(u8, SLCD_UCHR_DEL2)==0 || strcmp(u8, SLCD_UCHR_DEL3)==0) {
-			handle->inputselectedopt=lcd_getprevcharacterpos(
-				handle->selectopts, handle->inputselectedopt) ;
-			u8=lcd_getutf8char(handle->selectopts, handle->inputselectedopt) ;
-		}
-	}
-	
-	if (cmd==SLCD_RIGHT) {
-		/* Move MENU Chooser String to the Right */
-		handle->inputselectedopt=lcd_getnextcharacterpos(handle->selectopts,
-			handle->inputselectedopt) ;
-
-		/* Skip ND and EL */
-		u8=lcd_getutf8char(handle->selectopts, handle->inputselectedopt) ;
-		while (strcmp(u8, SLCD_UCHR_END2)==0 || strcmp(u8, SLCD_UCHR_END3)==0 ||
-				strcmp(u8, SLCD_UCHR_DEL2)==0 || strcmp(u8, SLCD_UCHR_DEL3)==0) {
-			handle->inputselectedopt=lcd_getnextcharacterpos(
-				handle->selectopts, handle->inputselectedopt) ;
-			u8=lcd_getutf8char(handle->selectopts, handle->inputselectedopt) ;
-		}
-	}
+	/* Move MENU Chooser String, skipping ND and EL */
+	if (cmd==SLCD_LEFT) lcd_inputstep(handle, -1) ;
+	if (cmd==SLCD_RIGHT) lcd_inputstep(handle, 1) ;
 	
 	if (cmd==SLCD_ENTER) {
 		/* Act on selected character in MENU Chooser */
-		u8=lcd_getutf8char(handle->selectopts, handle->inputselectedopt) ;
-		if (strcmp(u8, SLCD_UCHR_END1)==0) {
+		cell=&handle->inputcells[handle->inputselectedopt] ;
+		if (cell->action==SLCD_INPUT_END) {
 			/* END Selected, Return True */
+			lcd_inputgetresult(handle) ;
+			pthread_mutex_unlock(&handle->lock) ;
 			return SLCD_TRUE ;
-		} else if (strcmp(u8, SLCD_UCHR_DEL1)==0) {
-			/* DEL char to the left of Selected */
-			if (handle->inputcursorpos>=1) {
-				handle->inputcursorpos=
-					lcd_insertchar(handle->result, 
-					handle->inputcursorpos, '\x0',
-					handle->maxlen) ;			
-			}
-		} else if (strcmp(u8, SLCD_UCHR_LEFT)==0) {
-			/* Move Cursor Left */
-			if (handle->inputcursorpos>0) {
-				/* Adjust actual cursor position */
-				handle->inputcursorpos-- ;				
-				/* If moved off beginning of screen, move BOL back too */
-				if (handle->inputcursorpos<handle->inputbolpos)
-					handle->inputbolpos=handle->inputcursorpos ;
-			}
-		} else if (strcmp(u8, SLCD_UCHR_RIGHT)==0) {
-			/* Move Cursor Right */
-			if (handle->inputcursorpos<strlen(handle->result)) {
-				/* Adjust actual cursor position */
-				handle->inputcursorpos++ ;
-				/* if moved off end of screen, advance BOL to ensure cursor remains viewable */
-				if ((handle->inputcursorpos-handle->inputbolpos)>lcd_width())
-					handle->inputbolpos=handle->inputcursorpos-lcd_width() ;
-			}
-		} else {
-			/* Insert Character at cursorpos */
-			handle->inputcursorpos=lcd_insertchar(handle->result, 
-				handle->inputcursorpos, u8[0], handle->maxlen) ;
 		}
+		lcd_inputedit(handle, cell) ;
 	}
 	
 	/* Adjust the beginning of line */
@@ -798,9 +1369,35 @@ int lcd_inputcontrol(lcd_handle *handle, enum slcd_e_inputctl cmd)
 	if (handle->inputcursorpos>(handle->inputbolpos+lcd_width()))
 		handle->inputbolpos=handle->inputcursorpos-lcd_width()+1 ;
 	
+	pthread_mutex_unlock(&handle->lock) ;
 	return SLCD_FALSE ;
 }
 
+/**
+ * lcd_inputgetresult
+ * @handle: handle of screen buffer
+ *
+ * Copies the text entered so far to the result buffer given
+ * to lcd_inputcreate(), and returns the buffer, or NULL in
+ * the case of an error.
+ **/
+char *lcd_inputgetresult(lcd_handle *handle)
+{
+	int tail ;
+
+	if (handle==NULL || handle->type!=SLCD_INPUT) {
+		logf(LG_ERR, "NULL / non-input handle passed to function") ;
+		return NULL ;
+	}
+	pthread_mutex_lock(&handle->lock) ;
+	tail=handle->maxlen-1-handle->inputgapend ;
+	memcpy(handle->result, handle->inputtext, handle->inputgap) ;
+	memcpy(handle->result+handle->inputgap, handle->inputtext+handle->inputgapend, tail) ;
+	handle->result[handle->inputgap+tail]='\0' ;
+	pthread_mutex_unlock(&handle->lock) ;
+	return handle->result ;
+}
+
 /*************************
  * YesNo Access / control Functions
  *************************/
@@ -871,10 +1468,14 @@ int lcd_yesnocontrol(lcd_handle *handle, enum slcd_e_inputctl cmd)
 	
 	switch (cmd) {
 	case SLCD_LEFT:
+		pthread_mutex_lock(&handle->lock) ;
 		if (handle->yesnoopt>0) handle->yesnoopt-- ;
+		pthread_mutex_unlock(&handle->lock) ;
 		break ;
 	case SLCD_RIGHT:
+		pthread_mutex_lock(&handle->lock) ;
 		if (handle->yesnoopt<handle->yesnomax) handle->yesnoopt++ ;
+		pthread_mutex_unlock(&handle->lock) ;
 		break ;
 	default:
 		logf(LG_ERR, "incorrect command passed to function") ;
@@ -928,7 +1529,7 @@ lcd_handle *lcd_clockcreate(char *title)
 
 	/* framebuffer's top line used to store title, all others are automagically re-generated in lcd_refresh() */
 	if (!lcd_framesetline(h, 0, title)) {
-		free(h) ;
+		lcd_delete(h) ;
 		return NULL ;
 	} else {
 		return h ;
@@ -956,8 +1557,10 @@ void lcd_clocksetalarm(lcd_handle *handle, struct tm *alm, enum slcd_e_status al
 		logf(LG_ERR, "NULL handle / alm passed to function") ;
 		return ;
 	}
+	pthread_mutex_lock(&handle->lock) ;
 	handle->almon=alarmon ;
 	memcpy((void *)&(handle->alm), (void *)alm, sizeof(struct tm)) ;
+	pthread_mutex_unlock(&handle->lock) ;
 }
 
 
@@ -980,13 +1583,28 @@ void lcd_delete(lcd_handle *handle)
 		return ;
 	}	
 
+	/* Stop lcd_tick() from animating it */
+	lcd_lock() ;
+	if (lcd_currentscreen==handle) lcd_currentscreen=NULL ;
+	if (lcd_drawnscreen==handle) lcd_drawnscreen=NULL ;
+	lcd_unlock() ;
+
 	/* Remove any lines in the screen */
 	lcd_menuclear(handle) ;
+	if (handle->vcache!=NULL) {
+		lcd_vmenuflush(handle, SLCD_TRUE) ;
+		free(handle->vcache) ;
+	}
 
 	/* Release memory */
+	lcd_arenafree(handle->arena, SLCD_FALSE) ;
 	if (handle->linebuf!=NULL) free(handle->linebuf) ;
-	if (handle->selectopts!=NULL) free(handle->selectopts) ;
+	if (handle->selcopy!=NULL) free(handle->selcopy) ;
+	if (handle->idindex!=NULL) free(handle->idindex) ;
+	if (handle->inputcells!=NULL) free(handle->inputcells) ;
+	if (handle->inputtext!=NULL) free(handle->inputtext) ;
 	if (handle->yesnoopts!=NULL) free(handle->yesnoopts) ;
+	pthread_mutex_destroy(&handle->lock) ;
 	free(handle) ;
 }
 
@@ -1003,25 +1621,54 @@ void lcd_refresh(lcd_handle *handle)
 	int r=0, i, j ;
 	struct slcd_s_row *p=NULL ;
 	time_t rawtime ;
-	struct tm *timeinfo ;
+	struct tm *timeinfo, tmbuf ;
 
 	/* There is nothing in the buffers, so clear the screen and leave */
 	if (handle==NULL) {
 		logf(LG_ERR, "NULL handle passed to function") ;
+		lcd_lock() ;
 		lcd_hwclearscr() ;
+		lcd_drawnscreen=NULL ;
+		lcd_mirrorpublish() ;
+		lcd_unlock() ;
 		return ;
 	}
-	if (handle->tsc==NULL) {
+	lcd_lock() ;
+	pthread_mutex_lock(&handle->lock) ;
+	if (handle->type==SLCD_VMENU ? handle->vcount==0 : handle->tsc==NULL) {
 		lcd_hwclearscr() ;
+		lcd_drawnscreen=NULL ;
+		lcd_mirrorpublish() ;
+		pthread_mutex_unlock(&handle->lock) ;
+		lcd_unlock() ;
 		return ;
 	}
 
 	switch (handle->type) {
 	case SLCD_MENU:
 		lcd_hwcursor(0, 0, SLCD_OFF) ;
+		/* If the menu is still on the display, only changed rows and the scrolling one are redrawn */
+		if (lcd_drawnscreen!=handle) handle->dirty=SLCD_DIRTY_ALL ;
 		for (r=0, p=handle->tsc; r<handle->numrows && r<lcd_height(); r++, p=p->next) {
 			if (p==handle->curl) {
 				lcd_hwputline(r, lcd_textbuildscrollingline(p), SLCD_SEL_ARROWS) ;
+			} else if (handle->dirty&(1U<<r)) {
+				lcd_hwputline(r, p->str, SLCD_SEL_NOARROWS) ;
+			}
+		}
+		for (; r<lcd_height(); r++) {
+			if (handle->dirty&(1U<<r)) lcd_hwputline(r, "", SLCD_SEL_NOARROWS) ;
+		}
+		handle->dirty=0 ;
+		break ;
+
+	case SLCD_VMENU:
+		lcd_hwcursor(0, 0, SLCD_OFF) ;
+		for (r=0; r<handle->vcount && r<lcd_height(); r++) {
+			i=(handle->vtop+r)%handle->vcount ;
+			p=lcd_vmenurow(handle, i) ;
+			if (i==handle->vsel) {
+				lcd_hwputline(r, lcd_textbuildscrollingline(p), SLCD_SEL_ARROWS) ;
 			} else {
 				lcd_hwputline(r, p->str, SLCD_SEL_NOARROWS) ;
 			}
@@ -1029,13 +1676,12 @@ void lcd_refresh(lcd_handle *handle)
 		for (; r<lcd_height(); r++) {
 			lcd_hwputline(r, "", SLCD_SEL_NOARROWS) ;
 		}
-		
 		break ;
 
 	case SLCD_CLOCK:
 		lcd_hwcursor(0, 0, SLCD_OFF) ;
 		time ( &rawtime );
-		timeinfo = localtime ( &rawtime );
+		timeinfo = localtime_r ( &rawtime, &tmbuf );
 		if ((lcd_capabilities()&SLCD_HAS_DRIVERCLOCK)!=0) {
 			logf(LG_DBG, "refreshing hardware clock, %02d:%02d", timeinfo->tm_hour, timeinfo->tm_min) ;
 			lcd_hwclock(timeinfo, handle->almon, &(handle->alm), 
@@ -1060,7 +1706,7 @@ void lcd_refresh(lcd_handle *handle)
 		/* Override Status Row with time and Icons */
 		if (handle->statusrow>=0) {
 			time ( &rawtime );
-			timeinfo = localtime ( &rawtime );
+			timeinfo = localtime_r ( &rawtime, &tmbuf );
 			if ((lcd_capabilities(handle)&SLCD_HAS_ICONS)==0 && handle->showicons) {
 				lcd_frameprintf(handle, handle->statusrow, "%s%s   %02d:%02d %s%s",
 					lcd_geticon(SLCD_ICON_REWIND)?SLCD_UCHR_REW:
@@ -1085,9 +1731,9 @@ void lcd_refresh(lcd_handle *handle)
 		break ;
 
 	case SLCD_INPUT:
-		lcd_hwputline(0, lcd_inputbuildscrollingline(handle->selectopts, handle->inputselectedopt), SLCD_SEL_ARROWS) ;
+		lcd_hwputline(0, lcd_inputbuildscrollingline(handle), SLCD_SEL_ARROWS) ;
 		lcd_hwcursor(handle->inputcursorpos-handle->inputbolpos-1, 1, SLCD_ON) ;
-		lcd_hwputline(1, lcd_inputbuildinputline(handle->result, handle->inputbolpos, handle->inputcursorpos), SLCD_SEL_NOARROWS) ;
+		lcd_hwputline(1, lcd_inputbuildinputline(handle), SLCD_SEL_NOARROWS) ;
 		break ;
 
 	case SLCD_YESNO:
@@ -1137,9 +1783,18 @@ void lcd_refresh(lcd_handle *handle)
 
 	}
 	lcd_hwrefresh() ;
+	lcd_mirrorpublish() ;
 	
 	/* Update screen that will be automatically refreshed by lcd_tick */
 	lcd_currentscreen=handle ;
+	lcd_drawnscreen=(handle->type==SLCD_MENU) ? handle : NULL ;
+
+	/* Scrolling rows have stepped, and the time shown is current */
+	lcd_tickgov.lastscroll=lcd_tickclock() ;
+	if (!lcd_tickgov.ticking) lcd_tickgov.lastactivity=lcd_tickgov.lastscroll ;
+	lcd_tickgov.shownmin=time(NULL)/60 ;
+	pthread_mutex_unlock(&handle->lock) ;
+	lcd_unlock() ;
 }
 
 /**
@@ -1150,50 +1805,323 @@ void lcd_refresh(lcd_handle *handle)
  **/
 void lcd_tick()
 {
-	static int lastmins=-1 ;
-	static time_t rawtime ;
-	static struct tm *timeinfo ;
-	
-	if (lcd_currentscreen==NULL) return ;
+	lcd_lock() ;
+	if (lcd_currentscreen==NULL) {
+		lcd_unlock() ;
+		return ;
+	}
+	lcd_tickgov.ticking=SLCD_TRUE ;
 	switch (lcd_currentscreen->type) {
 	case SLCD_MENU:
+	case SLCD_VMENU:
 	case SLCD_FRAME:
 		lcd_refresh(lcd_currentscreen) ;
-		lastmins=-1 ;
 		break ;
 	case SLCD_CLOCK:
 		/* Update screen if time has changed */
-		time (&rawtime) ;
-		timeinfo=localtime(&rawtime) ;
-		if (lastmins!=timeinfo->tm_min) {
-			lastmins=timeinfo->tm_min ;
+		if (lcd_tickgov.shownmin!=time(NULL)/60) {
 			lcd_refresh(lcd_currentscreen) ;
 		}
 		break ;
 	default:
 		break ;
 	}
+	lcd_tickgov.ticking=SLCD_FALSE ;
+	lcd_unlock() ;
+}
+
+/**
+ * lcd_tickwait
+ *
+ * lcd_tickwait returns the number of milliseconds until the
+ * currently displayed screen next changes by itself, i.e. a
+ * scroll step, or a new minute on a clock or status row.  It
+ * returns 0 if lcd_tick() is due now, and -1 if nothing on the
+ * screen will change until the application changes it.
+ * Scrolling slows to the idle rate when lcd_refresh() has not been
+ * called for a while, and stops while the backlight is off.
+ **/
+int lcd_tickwait()
+{
+	lcd_handle *h ;
+	struct timespec ts ;
+	long now, step, next, wait=-1 ;
+
+	lcd_lock() ;
+	h=lcd_currentscreen ;
+	if (h==NULL) {
+		lcd_unlock() ;
+		return -1 ;
+	}
+	pthread_mutex_lock(&h->lock) ;
+	now=lcd_tickclock() ;
+
+	/* The next scroll step, if anything on screen scrolls */
+	if (!lcd_tickgov.backlightoff && lcd_tickscrolls(h)) {
+		step=lcd_tickgov.scrollms ;
+		if (lcd_tickgov.idleafter>0 && now-lcd_tickgov.lastactivity>=lcd_tickgov.idleafter)
+			step=lcd_tickgov.idlems ;
+		if (step>0) {
+			wait=lcd_tickgov.lastscroll+step-now ;
+			if (wait<0) wait=0 ;
+		}
+	}
+
+	/* The next minute, for clocks and status rows */
+	if (h->type==SLCD_CLOCK || (h->type==SLCD_FRAME && h->statusrow>=0)) {
+		clock_gettime(CLOCK_REALTIME, &ts) ;
+		if (ts.tv_sec/60!=lcd_tickgov.shownmin) next=0 ;
+		else next=(60-ts.tv_sec%60)*1000L-ts.tv_nsec/1000000L ;
+		if (wait<0 || next<wait) wait=next ;
+	}
+	pthread_mutex_unlock(&h->lock) ;
+	lcd_unlock() ;
+	return wait ;
+}
+
+/**
+ * lcd_tickauto
+ *
+ * lcd_tickauto calls lcd_tick() if it is due, and returns the
+ * time until it is next due, as lcd_tickwait().  A main loop
+ * can sleep for that long (or until a key arrives) instead of
+ * calling lcd_tick() on a fixed timer.
+ **/
+int lcd_tickauto()
+{
+	int wait ;
+
+	lcd_lock() ;
+	wait=lcd_tickwait() ;
+	if (wait==0) {
+		lcd_tick() ;
+		wait=lcd_tickwait() ;
+	}
+	lcd_unlock() ;
+	return wait ;
+}
+
+/**
+ * lcd_tickrate
+ * @scrollms: milliseconds between scroll steps
+ * @idlems: milliseconds between scroll steps when idle, 0 to stop
+ * @idleafter: milliseconds without lcd_refresh() calls before the
+ *             display is idle, 0 for never
+ *
+ * lcd_tickrate sets the rates used by lcd_tickwait().  The
+ * defaults are 300ms, 1000ms and one minute.
+ **/
+void lcd_tickrate(int scrollms, int idlems, int idleafter)
+{
+	lcd_lock() ;
+	lcd_tickgov.scrollms=(scrollms>0) ? scrollms : 1 ;
+	lcd_tickgov.idlems=(idlems>0) ? idlems : 0 ;
+	lcd_tickgov.idleafter=(idleafter>0) ? idleafter : 0 ;
+	lcd_unlock() ;
+}
+
+/**
+ * lcd_tickbacklight
+ * @level: new brightness level (0-100)
+ *
+ * Called by each backend's lcd_brightness(), so that lcd_tickwait()
+ * can stop scrolling while the backlight is off.
+ **/
+void lcd_tickbacklight(int level)
+{
+	lcd_lock() ;
+	/* Turning the light on is someone using the radio */
+	if (lcd_tickgov.backlightoff && level>0) lcd_tickgov.lastactivity=lcd_tickclock() ;
+	lcd_tickgov.backlightoff=(level<=0) ;
+	lcd_unlock() ;
 }
 
 /**
  * lcd_fetch
+ * handle: unused, may be NULL
  * buf: buffer for current screen output
  * max: maximum buffer size
  *
  * lcd_fetch copies to buf a text string which represents the 
- * current screen buffer contents.
+ * current screen contents, in the format of lcd_dumpscreen().
+ * The text is read from the shared memory mirror updated by
+ * lcd_refresh(), so it may be called from any process, and does
+ * not disturb the display.
  * The function returns true on success, or false if the buffer is
- * too small, or there are memory allocation problems.
+ * too small, or no screen has been published.
  **/
 int lcd_fetch(lcd_handle *handle, char *buf, int max) 
 {
-	return SLCD_TRUE ;
+	struct slcd_s_mirror *m ;
+	unsigned int seq ;
+	int tries, len ;
+
+	if (buf==NULL || max<=0) return SLCD_FALSE ;
+
+	/* Read our own copy, or attach to the writer's */
+	lcd_lock() ;
+	m=lcd_mirror ;
+	if (m==NULL) {
+		if (lcd_mirrorreader==NULL) lcd_mirrorreader=lcd_mirrormap(SLCD_FALSE) ;
+		m=lcd_mirrorreader ;
+	}
+	lcd_unlock() ;
+	if (m==NULL) return SLCD_FALSE ;
+
+	/* Retry until the text is copied without a write overlapping it */
+	for (tries=0; tries<SLCD_MIRROR_RETRIES; tries++) {
+		seq=m->seq ;
+		__sync_synchronize() ;
+		if (seq&1) {
+			sched_yield() ;
+			continue ;
+		}
+		len=m->len ;
+		if (len<0 || len>=SLCD_MIRROR_TEXTSIZE) continue ;
+		if (len>=max) {
+			__sync_synchronize() ;
+			if (m->seq!=seq) continue ;
+			return SLCD_FALSE ;
+		}
+		memcpy(buf, m->text, len) ;
+		__sync_synchronize() ;
+		if (m->seq==seq) {
+			buf[len]='\0' ;
+			return SLCD_TRUE ;
+		}
+	}
+	logf(LG_WRN, "screen mirror busy, giving up") ;
+	return SLCD_FALSE ;
+}
+
+/**
+ * lcd_lock
+ *
+ * Takes the display lock, which serialises access to the display
+ * and the screen buffer behind the lcd_hw* functions.  The lock is
+ * recursive, so the lcd functions may be called while holding it.
+ **/
+void lcd_lock()
+{
+	pthread_once(&lcd_lockonce, lcd_lockinit) ;
+	pthread_mutex_lock(&lcd_displaylock) ;
+}
+
+/**
+ * lcd_unlock
+ *
+ * Releases the display lock taken by lcd_lock().
+ **/
+void lcd_unlock()
+{
+	pthread_mutex_unlock(&lcd_displaylock) ;
 }
 
 /**
  * Local support functions
  **/
 
+/* Creates the display lock, and the attributes for handle locks */
+void lcd_lockinit()
+{
+	pthread_mutexattr_init(&lcd_lockattr) ;
+	pthread_mutexattr_settype(&lcd_lockattr, PTHREAD_MUTEX_RECURSIVE) ;
+	pthread_mutex_init(&lcd_displaylock, &lcd_lockattr) ;
+}
+
+/* Returns the shared memory segment name, or NULL if disabled */
+char *lcd_mirrorname()
+{
+	char *name ;
+	name=getenv("LCD_MIRROR") ;
+	if (name==NULL) return SLCD_MIRROR_NAME ;
+	if (name[0]=='\0') return NULL ;
+	return name ;
+}
+
+/*
+ * Maps the screen mirror.  Writable, it is created if need be and only
+ * mapped if no other process holds the writer's lock.  Returns NULL on
+ * failure, setting lcd_mirrorfailed unless another process is the writer
+ */
+struct slcd_s_mirror *lcd_mirrormap(int writable)
+{
+	struct slcd_s_mirror *m ;
+	char *name ;
+	int fd ;
+
+	name=lcd_mirrorname() ;
+	if (name==NULL) {
+		if (writable) lcd_mirrorfailed=SLCD_TRUE ;
+		return NULL ;
+	}
+	fd=shm_open(name, writable?(O_RDWR|O_CREAT):O_RDONLY, 0644) ;
+	if (fd<0) {
+		if (writable) logf(LG_WRN, "unable to open screen mirror %s", name) ;
+		if (writable) lcd_mirrorfailed=SLCD_TRUE ;
+		return NULL ;
+	}
+	if (writable && flock(fd, LOCK_EX|LOCK_NB)!=0) {
+		logf(LG_DBG, "screen mirror %s is written by another process", name) ;
+		close(fd) ;
+		return NULL ;
+	}
+	if (writable && ftruncate(fd, sizeof(struct slcd_s_mirror))!=0) {
+		logf(LG_WRN, "unable to size screen mirror %s", name) ;
+		lcd_mirrorfailed=SLCD_TRUE ;
+		close(fd) ;
+		return NULL ;
+	}
+	m=mmap(NULL, sizeof(struct slcd_s_mirror), 
+		writable?(PROT_READ|PROT_WRITE):PROT_READ, MAP_SHARED, fd, 0) ;
+	if (m==MAP_FAILED) {
+		logf(LG_WRN, "unable to map screen mirror %s", name) ;
+		if (writable) lcd_mirrorfailed=SLCD_TRUE ;
+		close(fd) ;
+		return NULL ;
+	}
+
+	if (writable) {
+		/* Keep the descriptor, and the lock, for as long as we write */
+		lcd_mirrorfd=fd ;
+		m->magic=SLCD_MIRROR_MAGIC ;
+		return m ;
+	}
+	close(fd) ;
+	if (m->magic!=SLCD_MIRROR_MAGIC) {
+		munmap(m, sizeof(struct slcd_s_mirror)) ;
+		return NULL ;
+	}
+	return m ;
+}
+
+/* Copies the current screen to the mirror, if it has changed */
+void lcd_mirrorpublish()
+{
+	static char buf[SLCD_MIRROR_TEXTSIZE] ;
+	int len ;
+
+	if (lcd_mirror==NULL) {
+		if (lcd_mirrorfailed || time(NULL)==lcd_mirrortried) return ;
+		lcd_mirrortried=time(NULL) ;
+		lcd_mirror=lcd_mirrormap(SLCD_TRUE) ;
+		if (lcd_mirror==NULL) return ;
+	}
+
+	lcd_dumpscreen(buf, sizeof(buf)) ;
+	len=strlen(buf) ;
+	if ((lcd_mirror->seq&1)==0 && len==lcd_mirror->len &&
+	    memcmp(buf, lcd_mirror->text, len)==0) return ;
+
+	/* seq is only still odd here if the last writer died part way through */
+	if ((lcd_mirror->seq&1)==0) lcd_mirror->seq++ ;
+	__sync_synchronize() ;
+	memcpy(lcd_mirror->text, buf, len+1) ;
+	lcd_mirror->len=len ;
+	__sync_synchronize() ;
+	lcd_mirror->seq++ ;
+}
+
 /* Appends character to a string and returns length */
 int lcd_strcatc(char *buf, int maxlen, char c)
 {
@@ -1220,6 +2148,20 @@ int lcd_strlen(char *buf)
 	}
 	return l ;
 }
+
+/* Calculate UTF8 string length of the first bytes of buf, as lcd_strlen() */
+int lcd_strnlen(const char *buf, int bytes)
+{
+	int l, i ;
+	for (l=0,i=0; i<bytes;) {
+		if ((buf[i]&'\xC0')=='\xC0')
+			for (i++; i<bytes && (buf[i]&'\xC0')=='\x80'; i++) ;
+		else
+			i++ ;
+		l++ ;
+	}
+	return l ;
+}
 		
 /* Looks to the right of curpos, and returns the position of the next character (UTF8 aware) */
 int lcd_getnextcharacterpos(char *str, int curpos)
@@ -1230,104 +2172,442 @@ int lcd_getnextcharacterpos(char *str, int curpos)
 	return curpos ;
 }
 
-/* Looks to the left of curpos, and returns the position of the prev character (UTF8 aware) */
-int lcd_getprevcharacterpos(char *str, int curpos) 
+/*
+ * Allocates size bytes from the handle's arena, starting a new
+ * block when the newest one is full.  Returns NULL if out of memory.
+ */
+void *lcd_arenaalloc(lcd_handle *handle, int size)
 {
-	if (curpos==0) curpos=strlen(str)-1 ;
-	else curpos-- ;
-	while (curpos>0 && (str[curpos]&'\xC0')=='\x80') curpos-- ;
-	return curpos ;
+	struct slcd_s_arena *a ;
+	void *p ;
+	int blksize ;
+
+	size=SLCD_ARENA_ALIGN(size) ;
+	a=handle->arena ;
+	if (a==NULL || a->size-a->used<size) {
+		blksize=(size>SLCD_ARENA_BLKSIZE) ? size : SLCD_ARENA_BLKSIZE ;
+		a=malloc(sizeof(struct slcd_s_arena)+blksize) ;
+		if (a==NULL) {
+			logf(LG_FTL, "memory allocation failure") ;
+			return NULL ;
+		}
+		a->size=blksize ;
+		a->used=0 ;
+		a->next=handle->arena ;
+		handle->arena=a ;
+	}
+	p=(char *)a->data+a->used ;
+	a->used+=size ;
+	return p ;
+}
+
+/*
+ * Frees a list of arena blocks.  If keep is true, the newest block
+ * is emptied and kept for re-use (unless it is an oversized one).
+ * Returns the kept block, or NULL.
+ */
+struct slcd_s_arena *lcd_arenafree(struct slcd_s_arena *arena, int keep)
+{
+	struct slcd_s_arena *kept=NULL, *next ;
+	if (arena!=NULL && keep && arena->size==SLCD_ARENA_BLKSIZE) {
+		kept=arena ;
+		arena=arena->next ;
+		kept->used=0 ;
+		kept->next=NULL ;
+	}
+	while (arena!=NULL) {
+		next=arena->next ;
+		free(arena) ;
+		arena=next ;
+	}
+	return kept ;
+}
+
+/* Returns the number of bytes allocated from the handle's arena */
+int lcd_arenaused(lcd_handle *handle)
+{
+	struct slcd_s_arena *a ;
+	int used=0 ;
+	for (a=handle->arena; a!=NULL; a=a->next) used+=a->used ;
+	return used ;
+}
+
+/* Returns the size of the row's offset table and text */
+int lcd_rowtextsize(struct slcd_s_row *row)
+{
+	return sizeof(int)*(row->len+1)+row->cpoff[row->len]+1 ;
+}
+
+/*
+ * Copies str into the row, and decodes it once into a table of
+ * UTF8 character offsets, so that scrolling never has to rescan it.
+ * The table and the string share one arena allocation, table first,
+ * which is reused when the new text fits.  Returns true on success,
+ * false if out of memory.
+ */
+int lcd_rowsettext(lcd_handle *handle, struct slcd_s_row *row, const char *str, int bytes)
+{
+	int len, size ;
+	int *cpoff ;
+	char *s ;
+	const char *nul ;
+
+	/* The text ends at a NUL, as the decoded copy would */
+	nul=memchr(str, '\0', bytes) ;
+	if (nul!=NULL) bytes=nul-str ;
+	len=lcd_strnlen(str, bytes) ;
+	size=sizeof(int)*(len+1)+bytes+1 ;
+	if (row->cpoff!=NULL && size<=row->cpsize) {
+		/* Overwrite the old text, which str may be part of */
+		cpoff=row->cpoff ;
+		s=(char *)&cpoff[len+1] ;
+		memmove(s, str, bytes) ;
+	} else {
+		cpoff=lcd_arenaalloc(handle, size) ;
+		if (cpoff==NULL) return SLCD_FALSE ;
+		s=(char *)&cpoff[len+1] ;
+		memcpy(s, str, bytes) ;
+		/* The replaced text stays in the arena until it is compacted */
+		if (row->cpoff!=NULL) handle->arenawaste+=row->cpsize ;
+		row->cpsize=SLCD_ARENA_ALIGN(size) ;
+	}
+	s[bytes]='\0' ;
+	lcd_rowdecode(cpoff, s, len) ;
+	row->cpoff=cpoff ;
+	row->str=s ;
+	row->len=len ;
+	row->scrollpos=0 ;
+	return SLCD_TRUE ;
+}
+
+/* Fills in the offset of each of the len UTF8 characters in s, plus the end */
+void lcd_rowdecode(int *cpoff, char *s, int len)
+{
+	int i, c ;
+
+	/* Same character boundaries as lcd_strlen() */
+	for (c=0, i=0; s[i]!='\0'; c++) {
+		cpoff[c]=i ;
+		if ((s[i]&'\xC0')=='\xC0')
+			for (i++; (s[i]&'\xC0')=='\x80'; i++) ;
+		else
+			i++ ;
+	}
+	cpoff[len]=i ;
+}
+
+/*
+ * Builds the idnumber index of a menu on first use, so that menus
+ * never looked up by ID number do not pay for it.  Returns false
+ * if out of memory.
+ */
+int lcd_menuindex(lcd_handle *handle)
+{
+	struct slcd_s_row **idindex, *p ;
+	int size, r ;
+
+	if (handle->idindex!=NULL && handle->numrows<=handle->idindexsize) return SLCD_TRUE ;
+
+	/* (Re)build, with at least as many buckets as rows */
+	for (size=SLCD_INDEX_MINSIZE; size<handle->numrows; size*=2) ;
+	idindex=calloc(size, sizeof(struct slcd_s_row *)) ;
+	if (idindex==NULL) {
+		logf(LG_FTL, "memory allocation failure") ;
+		return SLCD_FALSE ;
+	}
+	if (handle->idindex!=NULL) free(handle->idindex) ;
+	handle->idindex=idindex ;
+	handle->idindexsize=size ;
+	for (r=0, p=handle->top; r<handle->numrows; r++, p=p->next) lcd_menuindexadd(handle, p) ;
+	return SLCD_TRUE ;
+}
+
+/* Returns the monotonic clock in milliseconds */
+long lcd_tickclock()
+{
+	struct timespec ts ;
+	clock_gettime(CLOCK_MONOTONIC, &ts) ;
+	return ts.tv_sec*1000L+ts.tv_nsec/1000000L ;
+}
+
+/* Returns true if lcd_tick() would scroll anything on the screen */
+int lcd_tickscrolls(lcd_handle *handle)
+{
+	struct slcd_s_row *p ;
+	int r ;
+
+	switch (handle->type) {
+	case SLCD_MENU:
+		return handle->curl!=NULL && handle->curl->len>lcd_width() ;
+	case SLCD_VMENU:
+		return handle->vcount>0 && lcd_vmenurow(handle, handle->vsel)->len>lcd_width() ;
+	case SLCD_FRAME:
+		for (r=0, p=handle->tsc; p!=NULL && r<lcd_height(); r++, p=p->next)
+			if (p->len>lcd_width()) return SLCD_TRUE ;
+		return SLCD_FALSE ;
+	default:
+		return SLCD_FALSE ;
+	}
+}
+
+/* Returns the index bucket for an ID number, mixing the bits so that runs of IDs spread out */
+unsigned int lcd_menuhash(int idnumber, int size)
+{
+	unsigned int h=(unsigned int)idnumber*2654435761U ;
+	return (h^(h>>15))&(size-1) ;
+}
+
+/* Adds a row to the idnumber index, growing it when it gets full */
+void lcd_menuindexadd(lcd_handle *handle, struct slcd_s_row *row)
+{
+	unsigned int b ;
+
+	if (handle->numrows>handle->idindexsize) {
+		/* Rebuilding adds this row too */
+		if (!lcd_menuindex(handle)) {
+			free(handle->idindex) ;
+			handle->idindex=NULL ;
+			handle->idindexsize=0 ;
+		}
+		return ;
+	}
+	b=lcd_menuhash(row->idnumber, handle->idindexsize) ;
+	row->hnext=handle->idindex[b] ;
+	handle->idindex[b]=row ;
+}
+
+/* Removes a row from the idnumber index */
+void lcd_menuindexdel(lcd_handle *handle, struct slcd_s_row *row)
+{
+	struct slcd_s_row **pp ;
+
+	pp=&handle->idindex[lcd_menuhash(row->idnumber, handle->idindexsize)] ;
+	while (*pp!=NULL && *pp!=row) pp=&(*pp)->hnext ;
+	if (*pp!=NULL) *pp=row->hnext ;
+}
+
+/* Returns the menu row with the given ID number, or NULL */
+struct slcd_s_row *lcd_menufind(lcd_handle *handle, int idnumber)
+{
+	struct slcd_s_row *p ;
+
+	if (handle->top==NULL || !lcd_menuindex(handle)) return NULL ;
+	p=handle->idindex[lcd_menuhash(idnumber, handle->idindexsize)] ;
+	while (p!=NULL && p->idnumber!=idnumber) p=p->hnext ;
+	return p ;
+}
+
+/* Takes a row out of the circular list, moving top, end and tsc off it */
+void lcd_menuunlink(lcd_handle *handle, struct slcd_s_row *row)
+{
+	if (row==handle->tsc) handle->tsc=row->next ;
+	if (row==handle->top) handle->top=row->next ;
+	if (row==handle->end) handle->end=row->prev ;
+	row->prev->next=row->next ;
+	row->next->prev=row->prev ;
+}
+
+/* Returns the screen row showing the given menu row, or -1 if it is not visible */
+int lcd_menurowpos(lcd_handle *handle, struct slcd_s_row *row)
+{
+	struct slcd_s_row *p ;
+	int r ;
+
+	for (r=0, p=handle->tsc; p!=NULL && r<handle->numrows && r<lcd_height(); r++, p=p->next)
+		if (p==row) return r ;
+	return -1 ;
+}
+
+/* Keeps the selected row on the screen after rows are removed or moved */
+void lcd_menuview(lcd_handle *handle)
+{
+	struct slcd_s_row *tsc=handle->tsc ;
+
+	if (handle->curl==NULL) return ;
+	if (handle->numrows<=lcd_height()) tsc=handle->top ;
+	else if (lcd_menurowpos(handle, handle->curl)<0) tsc=handle->curl ;
+	if (tsc!=handle->tsc) {
+		handle->tsc=tsc ;
+		handle->dirty=SLCD_DIRTY_ALL ;
+	}
+}
+
+/* Compacts the handle's arena once most of it holds replaced or removed text */
+void lcd_menureclaim(lcd_handle *handle)
+{
+	if (handle->arenawaste>SLCD_ARENA_BLKSIZE && 
+			handle->arenawaste*2>lcd_arenaused(handle)) {
+		lcd_menucompact(handle) ;
+	}
+}
+
+/*
+ * Returns the row for a virtual menu entry, from the cache if it is
+ * there, otherwise produced by the callback into the least recently
+ * used slot.  Never returns NULL: a failed entry shows as empty.
+ */
+struct slcd_s_row *lcd_vmenurow(lcd_handle *handle, int index)
+{
+	static struct slcd_s_row empty={NULL, NULL, "", NULL, 0, -1, 0, 0, NULL} ;
+	char buf[SLCD_PRINTF_BUFSIZE] ;
+	struct slcd_s_vslot *v, *lru ;
+	int i, id, bytes, len, size ;
+	int *cpoff ;
+
+	handle->vclock++ ;
+	for (i=0, lru=&handle->vcache[0]; i<SLCD_VMENU_CACHE; i++) {
+		v=&handle->vcache[i] ;
+		if (v->index==index) {
+			v->used=handle->vclock ;
+			return &v->row ;
+		}
+		if (v->used<lru->used) lru=v ;
+	}
+
+	/* Not cached, so produce it */
+	id=index ;
+	buf[0]='\0' ;
+	if (!handle->vfunc(handle->vdata, index, &id, buf, sizeof(buf))) buf[0]='\0' ;
+	buf[sizeof(buf)-1]='\0' ;
+
+	bytes=strlen(buf) ;
+	len=lcd_strlen(buf) ;
+	size=sizeof(int)*(len+1)+bytes+1 ;
+	if (size>lru->size) {
+		cpoff=realloc(lru->row.cpoff, size) ;
+		if (cpoff==NULL) {
+			logf(LG_FTL, "memory allocation failure") ;
+			return &empty ;
+		}
+		lru->row.cpoff=cpoff ;
+		lru->size=size ;
+	}
+	lru->index=index ;
+	lru->used=handle->vclock ;
+	lru->row.str=(char *)&lru->row.cpoff[len+1] ;
+	memcpy(lru->row.str, buf, bytes+1) ;
+	lcd_rowdecode(lru->row.cpoff, lru->row.str, len) ;
+	lru->row.idnumber=id ;
+	lru->row.len=len ;
+	lru->row.scrollpos=0 ;
+	lru->row.next=NULL ;
+	lru->row.prev=NULL ;
+	return &lru->row ;
+}
+
+/* Virtual menu callback for lcd_vmenucreatetable() */
+int lcd_vmenutable(void *data, int index, int *idnumber, char *buf, int maxlen)
+{
+	lcd_handle *h=data ;
+	strncpy(buf, h->vtable+h->voffsets[index], maxlen-1) ;
+	buf[maxlen-1]='\0' ;
+	*idnumber=index ;
+	return SLCD_TRUE ;
+}
+
+/* Empties the virtual menu cache, keeping the slots' memory unless release is set */
+void lcd_vmenuflush(lcd_handle *handle, int release)
+{
+	int i ;
+	for (i=0; i<SLCD_VMENU_CACHE; i++) {
+		if (release && handle->vcache[i].row.cpoff!=NULL) {
+			free(handle->vcache[i].row.cpoff) ;
+			handle->vcache[i].row.cpoff=NULL ;
+			handle->vcache[i].size=0 ;
+		}
+		handle->vcache[i].index=-1 ;
+		handle->vcache[i].used=0 ;
+	}
 }
 
 /* scrolls along, and returns string */
 char *lcd_textbuildscrollingline(struct slcd_s_row *row)
 {
-	int p ;
 	static char linebuf[SLCD_TEXTBUF_MAXLEN] ;
-	char *utf8char ;
+	int sp, wid, n, m ;
 
 /*FIXME: function assumes that SLCD_TEXTBUF_MAXLEN will always be larger than lcd_width() */
 	
 	if (row==NULL) return "" ;	/* paranoia check */
 
 	/* short line - no scrolling required */
-	if (row->len<=lcd_width()) {
-		strcpy(linebuf, row->str) ;
-		return linebuf ;
-	}
-
-	 /* Copy the string at the given offset */
-	p=row->scrollpos ;
-	strcpy(linebuf,"") ;
-	while (lcd_strlen(linebuf)<lcd_width()) {
-		utf8char=lcd_getutf8char(row->str, p) ;
-		p=lcd_getnextcharacterpos(row->str, p) ;
-		strcat(linebuf, utf8char) ;
+	wid=lcd_width() ;
+	if (row->len<=wid) return row->str ;
+
+	/* Copy the window at the given offset, wrapping round to the start */
+	sp=row->scrollpos ;
+	if (sp+wid<=row->len) {
+		n=row->cpoff[sp+wid]-row->cpoff[sp] ;
+		memcpy(linebuf, row->str+row->cpoff[sp], n) ;
+	} else {
+		n=row->cpoff[row->len]-row->cpoff[sp] ;
+		memcpy(linebuf, row->str+row->cpoff[sp], n) ;
+		m=row->cpoff[sp+wid-row->len] ;
+		memcpy(linebuf+n, row->str, m) ;
+		n+=m ;
 	}
+	linebuf[n]='\0' ;
 
-	row->scrollpos=lcd_getnextcharacterpos(row->str, row->scrollpos) ;
+	row->scrollpos=(sp+1)%row->len ;
 
 	return linebuf ;
 }
 
 /* returns input formatted string (doesn't scroll, that's someone elses job */
-char *lcd_inputbuildscrollingline(char *selstr, int selection)
+char *lcd_inputbuildscrollingline(lcd_handle *handle)
 {
-	int i, p ;
+	int i, p, n, preview, ncells ;
 	static char linebuf[SLCD_TEXTBUF_MAXLEN] ;
-	char *utf8char ;
-	int preview ;
+	struct slcd_s_inputcell *cells, *c ;
 	
 /*FIXME: function assumes that SLCD_TEXTBUF_MAXLEN will always be larger than lcd_width() */
 	
-	if (selstr==NULL) return "" ;	/* paranoia check */
+	cells=handle->inputcells ;
+	ncells=handle->inputncells ;
+	if (cells==NULL) return "" ;	/* paranoia check */
 
-	/* Clear the destination */
-	strcpy(linebuf,"") ;
-	
 	/* Calculate how many preview characters there will be */
 	preview=(lcd_width()-5)/2 ;
 
 	/* Work back along the line to identify screen-left */
-	for (p=selection, i=0; i<preview; i++) p=lcd_getprevcharacterpos(selstr, p) ;
+	p=(handle->inputselectedopt-preview)%ncells ;
+	if (p<0) p+=ncells ;
 
 	/* Copy the pre-centre string at the given offset */
-	for (i=0; i<preview; i++) {
-		utf8char=lcd_getutf8char(selstr, p) ;
-		strcat(linebuf, lcd_parsespecial(utf8char)) ;
-		p=lcd_getnextcharacterpos(selstr, p) ;
+	for (i=0, n=0; i<preview; i++) {
+		memcpy(linebuf+n, cells[p].glyph, cells[p].glyphlen) ;
+		n+=cells[p].glyphlen ;
+		if (++p==ncells) p=0 ;
 	}
 
 	/* Now do the selected character */
-	utf8char=lcd_getutf8char(selstr, p) ;
-	if (strcmp(utf8char, SLCD_UCHR_END1)==0) {
-		strcat(linebuf, " END ") ;
-		p=lcd_getnextcharacterpos(selstr, p) ;
-		p=lcd_getnextcharacterpos(selstr, p) ;
-		p=lcd_getnextcharacterpos(selstr, p) ;
-	} else if (strcmp(utf8char, SLCD_UCHR_DEL1)==0) {
-		strcat(linebuf, " DEL ") ;
-		p=lcd_getnextcharacterpos(selstr, p) ;
-		p=lcd_getnextcharacterpos(selstr, p) ;
-		p=lcd_getnextcharacterpos(selstr, p) ;
+	c=&cells[p] ;
+	if (c->action==SLCD_INPUT_END || c->action==SLCD_INPUT_DEL) {
+		memcpy(linebuf+n, (c->action==SLCD_INPUT_END) ? " END " : " DEL ", 5) ;
+		n+=5 ;
+		p=(p+3)%ncells ;
 	} else {
-		strcat(linebuf, " <") ;
-		strcat(linebuf, utf8char) ;
-		strcat(linebuf, "> ") ;
-		p=lcd_getnextcharacterpos(selstr, p) ;
+		linebuf[n++]=' ' ;
+		linebuf[n++]='<' ;
+		memcpy(linebuf+n, c->u8, c->len) ;
+		n+=c->len ;
+		linebuf[n++]='>' ;
+		linebuf[n++]=' ' ;
+		if (++p==ncells) p=0 ;
 	}
 
 	/* Now copy the post-centre string */
 	for (i=0; i<preview; i++) {
-		utf8char=lcd_getutf8char(selstr, p) ;
-		strcat(linebuf, lcd_parsespecial(utf8char)) ;
-		p=lcd_getnextcharacterpos(selstr, p) ;
+		memcpy(linebuf+n, cells[p].glyph, cells[p].glyphlen) ;
+		n+=cells[p].glyphlen ;
+		if (++p==ncells) p=0 ;
 	}
 
 	/* pad with space if needed (most likely) */
 	if (lcd_width() != (preview+5+preview)) {
-		strcat(linebuf," ") ;
+		linebuf[n++]=' ' ;
 	}
+	linebuf[n]='\0' ;
 	
 	return linebuf ;
 }
@@ -1335,6 +2615,8 @@ char *lcd_inputbuildscrollingline(char *selstr, int selection)
 /* parse special UTF8 chars into English */
 char *lcd_parsespecial(char *t)
 {
+	/* All the special characters are in the private use area */
+	if (t[0]!=SLCD_UCHR_END1[0]) return t ;
 	if (strcmp(t, SLCD_UCHR_END1)==0) return "E" ;
 	if (strcmp(t, SLCD_UCHR_END2)==0) return "N" ;
 	if (strcmp(t, SLCD_UCHR_END3)==0) return "D" ;
@@ -1344,17 +2626,139 @@ char *lcd_parsespecial(char *t)
 	return t ;
 }
 
-/* returns an input edit line  */
-char *lcd_inputbuildinputline(char *src, int bol, int cursor)
+/* returns the visible part of the input edit line, from the gap buffer */
+char *lcd_inputbuildinputline(lcd_handle *handle)
 {
-/*FIXME:  Need to pad line out with spaces if necessary */
-	return &src[bol] ;
+	char *text=handle->inputtext ;
+	int s, e, end, n, max, i ;
+
+	/* Characters between the beginning of line and the cursor come before the gap */
+	max=lcd_width()*4 ;
+	for (s=handle->inputgap, i=handle->inputcursorpos-handle->inputbolpos; i>0 && s>0; i--) {
+		s-- ;
+		while (s>0 && (text[s]&'\xC0')=='\x80') s-- ;
+	}
+	/* linebuf holds max bytes, keep the ones nearest the cursor, from a character start */
+	if (handle->inputgap-s>max) {
+		s=handle->inputgap-max ;
+		while (s<handle->inputgap && (text[s]&'\xC0')=='\x80') s++ ;
+	}
+	n=handle->inputgap-s ;
+	memcpy(handle->linebuf, text+s, n) ;
+
+	/* And the rest of the line after it */
+	end=handle->maxlen-1 ;
+	for (e=handle->inputgapend, i=lcd_width()-(handle->inputcursorpos-handle->inputbolpos); i>0 && e<end; i--) {
+		s=e++ ;
+		while (e<end && (text[e]&'\xC0')=='\x80') e++ ;
+		if (n+e-s>max) break ;
+		memcpy(handle->linebuf+n, text+s, e-s) ;
+		n+=e-s ;
+	}
+	handle->linebuf[n]='\0' ;
+	return handle->linebuf ;
+}
+
+/* Decodes str into cells from n onwards, returns the new number of cells (cells may be NULL to count) */
+int lcd_inputdecode(struct slcd_s_inputcell *cells, int n, char *str)
+{
+	struct slcd_s_inputcell *c ;
+	char *glyph ;
+	int p ;
+
+	if (str[0]=='\0') return n ;
+	p=0 ;
+	do {
+		if (cells!=NULL) {
+			c=&cells[n] ;
+			lcd_getutf8char(str, p, c->u8) ;
+			c->len=strlen(c->u8) ;
+			glyph=lcd_parsespecial(c->u8) ;
+			strcpy(c->glyph, glyph) ;
+			c->glyphlen=strlen(c->glyph) ;
+			c->stop=SLCD_TRUE ;
+			c->action=SLCD_INPUT_INSERT ;
+			if (strcmp(c->u8, SLCD_UCHR_END1)==0) c->action=SLCD_INPUT_END ;
+			else if (strcmp(c->u8, SLCD_UCHR_DEL1)==0) c->action=SLCD_INPUT_DEL ;
+			else if (strcmp(c->u8, SLCD_UCHR_LEFT)==0) c->action=SLCD_INPUT_LEFT ;
+			else if (strcmp(c->u8, SLCD_UCHR_RIGHT)==0) c->action=SLCD_INPUT_RIGHT ;
+			else if (strcmp(c->u8, SLCD_UCHR_END2)==0 || strcmp(c->u8, SLCD_UCHR_END3)==0 ||
+					strcmp(c->u8, SLCD_UCHR_DEL2)==0 || strcmp(c->u8, SLCD_UCHR_DEL3)==0)
+				c->stop=SLCD_FALSE ;
+		}
+		n++ ;
+		p=lcd_getnextcharacterpos(str, p) ;
+	} while (p!=0) ;
+	return n ;
+}
+
+/* Moves the input chooser one selectable cell left (dir -1) or right (dir 1) */
+void lcd_inputstep(lcd_handle *handle, int dir)
+{
+	int p=handle->inputselectedopt, n=handle->inputncells ;
+
+	do {
+		p+=dir ;
+		if (p<0) p=n-1 ;
+		else if (p>=n) p=0 ;
+	} while (!handle->inputcells[p].stop) ;
+	handle->inputselectedopt=p ;
+}
+
+/* Applies a chooser cell at the cursor, moving only the bytes of one character */
+void lcd_inputedit(lcd_handle *handle, struct slcd_s_inputcell *cell)
+{
+	char *text=handle->inputtext ;
+	int s, e, end=handle->maxlen-1 ;
+
+	switch (cell->action) {
+	case SLCD_INPUT_DEL:
+		/* DEL char to the left of the cursor */
+		if (handle->inputgap==0) return ;
+		s=handle->inputgap-1 ;
+		while (s>0 && (text[s]&'\xC0')=='\x80') s-- ;
+		handle->inputgap=s ;
+		handle->inputcursorpos-- ;
+		break ;
+	case SLCD_INPUT_LEFT:
+		/* Move the character before the cursor to after the gap */
+		if (handle->inputgap==0) return ;
+		s=handle->inputgap-1 ;
+		while (s>0 && (text[s]&'\xC0')=='\x80') s-- ;
+		handle->inputgapend-=handle->inputgap-s ;
+		memmove(text+handle->inputgapend, text+s, handle->inputgap-s) ;
+		handle->inputgap=s ;
+		handle->inputcursorpos-- ;
+		/* If moved off beginning of screen, move BOL back too */
+		if (handle->inputcursorpos<handle->inputbolpos)
+			handle->inputbolpos=handle->inputcursorpos ;
+		break ;
+	case SLCD_INPUT_RIGHT:
+		/* Move the character after the cursor to before the gap */
+		if (handle->inputgapend>=end) return ;
+		e=handle->inputgapend+1 ;
+		while (e<end && (text[e]&'\xC0')=='\x80') e++ ;
+		memmove(text+handle->inputgap, text+handle->inputgapend, e-handle->inputgapend) ;
+		handle->inputgap+=e-handle->inputgapend ;
+		handle->inputgapend=e ;
+		handle->inputcursorpos++ ;
+		/* if moved off end of screen, advance BOL to ensure cursor remains viewable */
+		if ((handle->inputcursorpos-handle->inputbolpos)>lcd_width())
+			handle->inputbolpos=handle->inputcursorpos-lcd_width() ;
+		break ;
+	default:
+		/* Insert the whole character at the cursor, if it fits */
+		if (handle->inputgapend-handle->inputgap<cell->len) return ;
+		memcpy(text+handle->inputgap, cell->u8, cell->len) ;
+		handle->inputgap+=cell->len ;
+		handle->inputcursorpos++ ;
+		break ;
+	}
 }
 
 /* Extracts and returns a UTF8 Character from the given string position */
-char * lcd_getutf8char(char *str, int pos)
+char * lcd_getutf8char(char *str, int pos, char *utf8)
 {
-	static char utf8[4] ;
 	int x ;
 
 	x=0 ;
@@ -1366,81 +2770,47 @@ char * lcd_getutf8char(char *str, int pos)
 		}
 	}
 	utf8[x]='\0' ;
-	return (char *)utf8 ;
-}
-
-  
-/* Insert character at the given position */
-/* Note this function does not handle editing of UTF8 strings */
-/* Returns the new pos */
-int lcd_insertchar(char *str, int pos, char ch, int maxlen)
-{
-	int i ;
-	int newlen ;
-
-	/* Calculate length of new row */
-	newlen=strlen(str) ;
-	if (ch=='\0') newlen-- ;
-	else newlen++ ;
-
-	/* Check that we have space to do insertion */
-	if (newlen>=SLCD_TEXTBUF_MAXLEN || newlen>=maxlen) return pos ;
-
-	if (ch=='\0') {
-		/* Check we are not at the beginning of the line */
-		if (pos==0) return pos ;
-
-		/* Delete character by copying second half of string */
-		for (i=pos-1; str[i]!='\0'; i++)
-			str[i]=str[i+1] ;
-		str[i]='\0' ;
-		pos-- ;
-	} else {
-		/* Insert character and copy second half */
-		str[strlen(str)+1]='\0' ;
-		for (i=strlen(str); i>pos; i--)
-			str[i]=str[i-1] ;
-		str[pos]=ch ;
-		pos++ ;
-	}
-return pos ;
-
+	return utf8 ;
 }
 
 void lcd_dumpscreen(char *buf, int maxlen)
 {
 	int r, c ;			/* row and column */
 	char **str, *u8 ;		/* line source and utf8 character */
+	char u8buf[SLCD_UTF8_MAXLEN+1] ;
 	int cc ;			/* character count */
+	int n ;				/* length of buf so far */
 	enum slcd_e_arrows *selr ;	/* select status for each row */
 
 /* FIXME: Need to do this properly, and centre each line as is done on the radio */
 
+	lcd_lock() ;
 	str=lcd_hwgetscreen() ;
 	selr=lcd_hwgetselrows() ;
 	
-	buf[0]='\0' ;
-	for (r=0; r<lcd_height() && strlen(buf)<maxlen-4; r++) {
+	n=0 ;
+	for (r=0; r<lcd_height() && n<maxlen-4; r++) {
 	
 		/* Add < Arrow */
-		if (selr[r]==SLCD_SEL_ARROWS) strcat(buf,"<") ;
-		else strcat(buf," ") ;
+		buf[n++]=(selr[r]==SLCD_SEL_ARROWS)?'<':' ' ;
 		
 		/* Copy Line */
-		for (c=0, cc=0; !(cc==0 && c>0) && c<lcd_width() && strlen(buf)<maxlen-3; c++) {
-			u8=lcd_getutf8char(str[r], cc) ;
+		for (c=0, cc=0; str[r][cc]!='\0' && !(cc==0 && c>0) && c<lcd_width() && n<maxlen-3; c++) {
+			u8=lcd_parsespecial(lcd_getutf8char(str[r], cc, u8buf)) ;
 			cc=lcd_getnextcharacterpos(str[r], cc) ;
-			strcat(buf, lcd_parsespecial(u8)) ;
+			while (*u8!='\0') buf[n++]=*u8++ ;
 		}
 		
 		/* Pad with spaces */
-		for (; c<lcd_width() && strlen(buf)<maxlen-2; c++)
-			strcat(buf," ") ;
+		for (; c<lcd_width() && n<maxlen-2; c++)
+			buf[n++]=' ' ;
 			
 		/* Add > Arrow */
-		if (selr[r]==SLCD_SEL_ARROWS) strcat(buf,">\n") ;
-		else strcat(buf," \n") ;
+		buf[n++]=(selr[r]==SLCD_SEL_ARROWS)?'>':' ' ;
+		buf[n++]='\n' ;
 	}
+	buf[n]='\0' ;
+	lcd_unlock() ;
 }
 
 /* Dumps the entire screen structure to stdout */
@@ -138,6 +138,7 @@ void lcd_exit()
 	int r ;
 
 	/* Free all allocated memory */
+	lcd_lock() ;
 	
 	if (lcd.scr.piArrows!=NULL) free(lcd.scr.piArrows) ;
 	lcd.scr.piArrows=NULL ;
@@ -154,6 +155,7 @@ void lcd_exit()
 	/* Close down ncurses system */
 	if (lcd.w!=NULL) delwin(lcd.w) ;
 	endwin() ;
+	lcd_unlock() ;
 }
 
 /**
@@ -234,6 +236,7 @@ int lcd_hwputline(int num, char *str, enum slcd_e_arrows sel)
  */
 void lcd_brightness(int level)
 {
+	lcd_tickbacklight(level) ;
 }
 
 
@@ -313,12 +316,14 @@ int lcd_seticon(enum slcd_e_icons icon, enum slcd_e_status state)
 		break ;
 	}
 	if (mask!=0) {
+		lcd_lock() ;
 		if (state==SLCD_ON) {
 			lcd.leds |= mask ;
 		} else {
 			lcd.leds |= mask ;
 			lcd.leds ^= mask ;
 		}
+		lcd_unlock() ;
 		return SLCD_TRUE ;
 	}
 
@@ -356,12 +361,14 @@ int lcd_seticon(enum slcd_e_icons icon, enum slcd_e_status state)
 		break ;
 	}
 	if (mask!=0) {
+		lcd_lock() ;
 		if (state==SLCD_ON) {
 			lcd.icons |= mask ;
 		} else {
 			lcd.icons |= mask ;
 			lcd.icons ^= mask ;
 		}
+		lcd_unlock() ;
 		return SLCD_TRUE ;
 	}
 	
@@ -629,3 +636,39 @@ char ** lcd_hwgetscreen() {
 enum slcd_e_arrows * lcd_hwgetselrows() {
 	return (enum slcd_e_arrows *) lcd.scr.piArrows ;
 }
+
+/**
+ * lcd_hwgraphicsize
+ * @width: set to the graphics display width in pixels
+ * @height: set to the graphics display height in pixels
+ *
+ * The curses display only shows text, so this always returns false.
+ **/
+int lcd_hwgraphicsize(int *width, int *height)
+{
+	*width=0 ;
+	*height=0 ;
+	return SLCD_FALSE ;
+}
+
+/**
+ * lcd_hwdrawbitmap
+ *
+ * The curses display only shows text, so this always returns false.
+ **/
+int lcd_hwdrawbitmap(int left, int top, int width, int height, unsigned char *data)
+{
+	return SLCD_FALSE ;
+}
+
+/**
+ * lcd_hwgrabbitmap
+ *
+ * The curses display only shows text, so this always returns false.
+ **/
+int lcd_hwgrabbitmap(unsigned char *data, int size, int *width, int *height)
+{
+	*width=0 ;
+	*height=0 ;
+	return SLCD_FALSE ;
+}
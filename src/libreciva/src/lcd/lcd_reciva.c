@@ -34,6 +34,7 @@
  */
 
 #include "log.h"
+#include "hwtrace.h"
 #include "lcdhw.h"
 #include "reciva_lcd.h"
 #include "reciva_leds.h"
@@ -51,6 +52,11 @@ struct {
 	int wid ;				/* Screen Width */
 	int hei ;				/* Screen Height */
 	enum slcd_e_caps cap ;			/* Display Capabilities */
+	int gwid, ghei ;			/* Graphics size in pixels */
+	unsigned char *grab ;			/* Reused buffer for screen grabs */
+	int grabsize ;				/* Size of grab */
+	unsigned char *draw ;			/* Reused buffer for bitmap draws */
+	int drawsize ;				/* Size of draw */
 	int icons ;				/* Icons mask */
 	int leds ;				/* LEDs mask */
 	struct lcd_draw_screen scr ;		/* Screen structure */
@@ -60,6 +66,8 @@ struct {
 
 /* local function definitions */
 static int lcd_hwdoioctl(int iot, void *arg) ;
+static int lcd_hwdoioctln(int iot, void *arg, int bytes) ;
+static int lcd_hwgrabraw(unsigned char *raw) ;
 
 /*
  * ident
@@ -99,6 +107,13 @@ int lcd_init()
 	if (!(!lcd_hwdoioctl(IOC_LCD_DRAW_ICONS, &tmp) && errno==ENOSYS)) lcd.cap|=SLCD_HAS_ICONS ;
 	if (!(!lcd_hwdoioctl(IOC_LCD_SET_AMPM_TEXT, &tmp) && errno==ENOSYS)) lcd.cap|=SLCD_HAS_DRIVERCLOCK ;
 
+	lcd.gwid=0 ;
+	lcd.ghei=0 ;
+	if ((lcd.cap&SLCD_HAS_GRAPHICS)!=0) {
+		lcd_hwdoioctl(IOC_LCD_GET_GRAPHICS_WIDTH, (void *)&lcd.gwid) ;
+		lcd_hwdoioctl(IOC_LCD_GET_GRAPHICS_HEIGHT, (void *)&lcd.ghei) ;
+	}
+
 	/* Set icons, LEDs, Brightness and Contrast */
 	
 	lcd.icons=0 ;
@@ -144,6 +159,7 @@ void lcd_exit()
 	int r ;
 
 	/* Free all allocated memory */
+	lcd_lock() ;
 	
 	if (lcd.scr.piArrows!=NULL) free(lcd.scr.piArrows) ;
 	lcd.scr.piArrows=NULL ;
@@ -156,6 +172,7 @@ void lcd_exit()
 	}
 	free(lcd.scr.acText) ;
 	lcd.scr.acText=NULL ;
+	lcd_unlock() ;
 }
 
 /**
@@ -239,6 +256,7 @@ void lcd_brightness(int level)
 	if ((lcd.cap&SLCD_HAS_BRIGHTNESS)==0) return ;
 	if (level<0) level=0 ;
 	if (level>100) level=100 ;
+	lcd_tickbacklight(level) ;
 	level *=31 ;
 	level /= 100 ;
 	lcd_hwdoioctl(IOC_LCD_BACKLIGHT, (void *)&level) ; 
@@ -325,6 +343,7 @@ int lcd_seticon(enum slcd_e_icons icon, enum slcd_e_status state)
 		break ;
 	}
 	if (mask!=0) {
+		lcd_lock() ;
 		if (state==SLCD_ON) {
 			lcd.leds |= mask ;
 		} else {
@@ -336,6 +355,7 @@ int lcd_seticon(enum slcd_e_icons icon, enum slcd_e_status state)
 			lcd_hwdoioctl(IOC_LCD_LED, (void *)&lcd.leds) ;
 		}
 		
+		lcd_unlock() ;
 		return SLCD_TRUE ;
 	}
 
@@ -373,6 +393,7 @@ int lcd_seticon(enum slcd_e_icons icon, enum slcd_e_status state)
 		break ;
 	}
 	if (mask!=0) {
+		lcd_lock() ;
 		if (state==SLCD_ON) {
 			lcd.icons |= mask ;
 		} else {
@@ -382,6 +403,7 @@ int lcd_seticon(enum slcd_e_icons icon, enum slcd_e_status state)
 		if ((lcd.cap&SLCD_HAS_ICONS)!=0) {
 			lcd_hwdoioctl(IOC_LCD_DRAW_ICONS, (void *)&lcd.icons) ;			
 		}
+		lcd_unlock() ;
 		return SLCD_TRUE ;
 	}
 	
@@ -483,7 +505,11 @@ int lcd_height()
  **/
 void lcd_hwrefresh()
 {
-	lcd_hwdoioctl(IOC_LCD_DRAW_SCREEN, &lcd.scr) ; 
+	int r, bytes ;
+
+	/* The driver reads each row's text and its arrow and contents words */
+	for (r=0, bytes=0; r<lcd.hei; r++) bytes+=strlen(lcd.scr.acText[r])+1+2*sizeof(int) ;
+	lcd_hwdoioctln(IOC_LCD_DRAW_SCREEN, &lcd.scr, bytes) ; 
 }
 
 /**
@@ -525,7 +551,7 @@ int lcd_hwclock(struct tm *clk, enum slcd_e_status almon, struct tm *alm,
 	/* Store the AM/PM text */
 	ampm.pcAM=am ;
 	ampm.pcPM=pm ;
-	lcd_hwdoioctl(IOC_LCD_SET_AMPM_TEXT, &ampm) ;
+	lcd_hwdoioctln(IOC_LCD_SET_AMPM_TEXT, &ampm, strlen(am)+strlen(pm)+2) ;
 
 	/* Set up the time and alarm structures */
 	tmp.iHours=clk->tm_hour ;
@@ -542,7 +568,7 @@ int lcd_hwclock(struct tm *clk, enum slcd_e_status almon, struct tm *alm,
 		tmp.iAlarmMinutes=0 ;
 	}
 	tmp.pcDateString=lcd.clktitle ;
-	return (lcd_hwdoioctl(IOC_LCD_DRAW_CLOCK, &tmp)!=(-1)) ;
+	return (lcd_hwdoioctln(IOC_LCD_DRAW_CLOCK, &tmp, sizeof(tmp)+strlen(lcd.clktitle)+1)!=(-1)) ;
 }
 
 /**
@@ -554,8 +580,22 @@ int lcd_hwclock(struct tm *clk, enum slcd_e_status almon, struct tm *alm,
  * or false on failure.
  **/
 int lcd_hwdoioctl(int iot, void *arg) {
+	return lcd_hwdoioctln(iot, arg, _IOC_SIZE(iot)) ;
+}
+
+/**
+ * lcd_hwdoioctln
+ * @iot: IOCTL
+ * @arg: argument
+ * @bytes: payload the driver copies, for the trace
+ *
+ * As lcd_hwdoioctl(), for ioctls whose argument points at more
+ * data than the argument structure itself.
+ **/
+int lcd_hwdoioctln(int iot, void *arg, int bytes) {
 	int fd;
 	int r;
+	long long t0 = HWTRACE_START();
 
 	fd = open("/dev/misc/lcd", O_RDWR);
 	if(fd == -1) {
@@ -564,6 +604,7 @@ int lcd_hwdoioctl(int iot, void *arg) {
 	}
 
 	r = ioctl(fd, iot, arg);
+	HWTRACE_END("lcd", iot, bytes, t0);
 
 	if (r==(-1)) {
 		logf(LG_INF, "SLCD_doioctl failed: dir=%d, type=%d, nr=%d, size=%d, err=%s\n", 
@@ -599,19 +640,179 @@ enum slcd_e_arrows * lcd_hwgetselrows() {
 	return (enum slcd_e_arrows *) lcd.scr.piArrows ;
 }
 
+/**
+ * lcd_hwgraphicsize
+ * @width: set to the graphics display width in pixels
+ * @height: set to the graphics display height in pixels
+ *
+ * Returns true if the display has SLCD_HAS_GRAPHICS, or false
+ * (with both sizes set to zero) if it only shows text.
+ **/
+int lcd_hwgraphicsize(int *width, int *height)
+{
+	*width=lcd.gwid ;
+	*height=lcd.ghei ;
+	return (lcd.gwid>0 && lcd.ghei>0) ;
+}
+
+/**
+ * lcd_hwdrawbitmap
+ * @left, @top: position of the region on the display in pixels
+ * @width, @height: size of the region in pixels
+ * @data: 1bpp pixels, each row packed MSB first into (width+7)/8 bytes
+ *
+ * Sends a region of pixels straight to the display with one
+ * IOC_LCD_DRAW_BITMAP.  The driver takes the region a column at a
+ * time, each column height bits long and packed LSB first straight
+ * after the one before, so the rows are repacked into that in a
+ * buffer that is kept for the next draw.  Returns true on success.
+ **/
+int lcd_hwdrawbitmap(int left, int top, int width, int height, unsigned char *data)
+{
+	struct bitmap_data bitmap ;
+	unsigned char *p ;
+	int x, y, bit, stride, size ;
+
+	if ((lcd.cap&SLCD_HAS_GRAPHICS)==0) return SLCD_FALSE ;
+	if (width<=0 || height<=0) return SLCD_FALSE ;
+
+	/* The driver copies width*height/8+1 bytes */
+	size=(width*height+7)/8+1 ;
+	if (size>lcd.drawsize) {
+		p=realloc(lcd.draw, size) ;
+		if (p==NULL) {
+			logf(LG_FTL, "memory allocation failure") ;
+			return SLCD_FALSE ;
+		}
+		lcd.draw=p ;
+		lcd.drawsize=size ;
+	}
+	memset(lcd.draw, 0, size) ;
+	stride=(width+7)/8 ;
+	for (x=0, bit=0; x<width; x++) {
+		for (y=0; y<height; y++, bit++) {
+			if (data[y*stride+x/8]&(0x80>>(x%8))) lcd.draw[bit/8]|=1<<(bit%8) ;
+		}
+	}
+
+	bitmap.left=left ;
+	bitmap.top=top ;
+	bitmap.width=width ;
+	bitmap.height=height ;
+	bitmap.data=lcd.draw ;
+	return lcd_hwdoioctln(IOC_LCD_DRAW_BITMAP, &bitmap, size) ;
+}
+
+/**
+ * lcd_hwgrabbitmap
+ * @data: destination, 1bpp rows packed MSB first into (width+7)/8 bytes
+ * @size: size of data in bytes
+ * @width, @height: set to the graphics display size in pixels
+ *
+ * Reads the whole graphics display back with one
+ * IOC_LCD_GRAB_SCREEN_REGION.  The driver returns its own display
+ * buffer, a column at a time with each byte holding eight pixels
+ * downwards, LSB at the top, which is repacked into rows.  The
+ * buffer for it is kept for the next grab.  Returns true on success.
+ **/
+int lcd_hwgrabbitmap(unsigned char *data, int size, int *width, int *height)
+{
+	int x, y, stride ;
+	unsigned char *col ;
+
+	if (lcd_hwgrabraw(NULL)<=0) {
+		*width=0 ;
+		*height=0 ;
+		return SLCD_FALSE ;
+	}
+	*width=lcd.gwid ;
+	*height=lcd.ghei ;
+	stride=(lcd.gwid+7)/8 ;
+	if (data==NULL || size<stride*lcd.ghei) return SLCD_FALSE ;
+	if (lcd_hwgrabraw(lcd.grab)<=0) return SLCD_FALSE ;
+
+	memset(data, 0, stride*lcd.ghei) ;
+	for (x=0; x<lcd.gwid; x++) {
+		col=&lcd.grab[(x*lcd.ghei)/8] ;
+		for (y=0; y<lcd.ghei; y++) {
+			if (col[y/8]&(1<<(y%8))) data[y*stride+x/8]|=0x80>>(x%8) ;
+		}
+	}
+	return SLCD_TRUE ;
+}
+
 /**
  * lcd_grab_region
  *
  * lcd_grab_region function grabs the contents of the screen
- * buffer 
+ * buffer, in the driver's format.  The driver always returns
+ * the whole screen, and sets the size.  Free the result and
+ * its data with free().
  **/
 struct bitmap_data*lcd_grab_region(int top,int left,int width,int height)
 {
-	struct bitmap_data*bitmap=(struct bitmap_data*)malloc(sizeof(struct bitmap_data));
+	struct bitmap_data*bitmap ;
+	int size=lcd_hwgrabraw(NULL) ;
+
+	if (size<=0) return NULL ;
+	bitmap=(struct bitmap_data*)malloc(sizeof(struct bitmap_data));
+	if (bitmap==NULL) return NULL ;
+	bitmap->data=malloc(size) ;
+	if (bitmap->data==NULL) {
+		free(bitmap) ;
+		return NULL ;
+	}
 	bitmap->top=top;
 	bitmap->left=left;
 	bitmap->width=width;
 	bitmap->height=height;
-	lcd_hwdoioctl(IOC_LCD_GRAB_SCREEN_REGION,bitmap); 
+	if (!lcd_hwdoioctln(IOC_LCD_GRAB_SCREEN_REGION, bitmap, size)) {
+		free(bitmap->data) ;
+		free(bitmap) ;
+		return NULL ;
+	}
 	return bitmap;
 }
+
+/*
+ * Grabs the driver's display buffer into raw, sized by the graphics size,
+ * which is read from the driver if lcd_init() has not been called.  With
+ * a NULL raw, only makes sure lcd.grab is big enough.  Returns the size
+ * of the buffer, or 0 if the display has no graphics.
+ */
+static int lcd_hwgrabraw(unsigned char *raw)
+{
+	struct bitmap_data bitmap ;
+	unsigned char *p ;
+	int size ;
+
+	if (lcd.gwid<=0 || lcd.ghei<=0) {
+		if (!lcd_hwdoioctl(IOC_LCD_GET_GRAPHICS_WIDTH, (void *)&lcd.gwid) ||
+				!lcd_hwdoioctl(IOC_LCD_GET_GRAPHICS_HEIGHT, (void *)&lcd.ghei) ||
+				lcd.gwid<=0 || lcd.ghei<=0) {
+			lcd.gwid=0 ;
+			lcd.ghei=0 ;
+			return 0 ;
+		}
+	}
+
+	/* The driver copies width*height/8+1 bytes */
+	size=lcd.gwid*((lcd.ghei+7)/8)+1 ;
+	if (size>lcd.grabsize) {
+		p=realloc(lcd.grab, size) ;
+		if (p==NULL) {
+			logf(LG_FTL, "memory allocation failure") ;
+			return 0 ;
+		}
+		lcd.grab=p ;
+		lcd.grabsize=size ;
+	}
+	if (raw==NULL) return size ;
+
+	bitmap.left=0 ;
+	bitmap.top=0 ;
+	bitmap.width=lcd.gwid ;
+	bitmap.height=lcd.ghei ;
+	bitmap.data=raw ;
+	return lcd_hwdoioctln(IOC_LCD_GRAB_SCREEN_REGION, &bitmap, size) ? size : 0 ;
+}
@@ -0,0 +1,814 @@
+/* 
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github 
+ *
+ * This file is part of the sharpfin project
+ *  
+ * This Library is free software: you can redistribute it and/or modify 
+ * it under the terms of the GNU General Public License as published by 
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * The LCD library contains interface functions to all of the
+ * LCD hardware features, and renders them into an in-memory
+ * frame buffer, so that it can run headless (e.g. for automated
+ * tests and benchmarks on a plain Linux host).
+ *
+ * The screen geometry defaults to 14x4, and can be changed with
+ * the LCD_VIRTUAL_GEOMETRY environment variable, e.g. "16x2".
+ * Setting LCD_VIRTUAL_GRAPHICS to a pixel size, e.g. "128x64",
+ * adds a graphics display (SLCD_HAS_GRAPHICS) of that size.
+ *
+ * It is essential that lcd_init() is called before any of these
+ * functions are used.
+ *
+ * Note that for the printing, cursor and select functions, 
+ * lcd_refresh() must be called to actually see a screen update.
+ *
+ */
+#include "log.h"
+#include "lcdhw.h"
+#include "lcd_virtual.h"
+#include "reciva_lcd.h"
+#include "reciva_leds.h"
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <stdio.h>
+
+#define SLCD_D_CLK_TITLE_LEN 32
+#define SLCD_D_WID 14
+#define SLCD_D_HEI 4
+struct {
+	int wid ;				/* Screen Width */
+	int hei ;				/* Screen Height */
+	enum slcd_e_caps cap ;			/* Display Capabilities */
+	int icons ;				/* Icons mask */
+	int leds ;				/* LEDs mask */
+	int brightness ;			/* Backlight level (0-100) */
+	int contrast ;				/* Contrast level (0-100) */
+	struct lcd_draw_screen scr ;		/* Screen structure */
+	enum slcd_e_clkmode clkmode ;		/* Clock display mode (12/24 hour) */
+	char clktitle[SLCD_D_CLK_TITLE_LEN] ;	/* Clock title - default='Sharpfin Radio' */
+	unsigned int *frame ;			/* Rendered display, hei rows of wid characters */
+	int *arrows ;				/* Rendered selection arrows for each row */
+	int cursorx, cursory, cursoron ;	/* Rendered cursor */
+	int gwid, ghei ;			/* Graphics size in pixels */
+	unsigned char *pixels ;			/* Graphics, 1bpp rows of (gwid+7)/8 bytes */
+	struct lcd_virtual_stats stats ;	/* Refresh / transfer counters */
+} lcd ;
+
+static void lcd_hwsend(int bytes) ;
+static unsigned int lcd_hwglyph(char *str, int *pos) ;
+
+/*
+ * ident
+ */
+
+char *lcdhw_ident()
+{
+        return "$Id: lcd_virtual.c 233 2012-01-01 00:00:00Z  $" ;
+}
+
+/**
+ * lcd_init
+ *
+ * lcd_init() initialises the LCD hardware, allocating memory, 
+ * clearing the screen, and setting the initial states of the 
+ * cursor and backlight.  lcd_init() must be called before
+ * any of the lcd functions can be used.
+ * Returns true on success, or false on memory allocation failure.
+ **/ 
+int lcd_init() 
+{
+	int r ;
+	char *geo ;
+
+	/* Find out what the radio can actually do */
+	lcd.cap=SLCD_HAS_ARROWS ;
+	lcd.wid=SLCD_D_WID ;
+	lcd.hei=SLCD_D_HEI ;
+	geo=getenv("LCD_VIRTUAL_GEOMETRY") ;
+	if (geo!=NULL && (sscanf(geo, "%dx%d", &lcd.wid, &lcd.hei)!=2 || 
+			lcd.wid<1 || lcd.hei<1)) {
+		logf(LG_WRN, "bad LCD_VIRTUAL_GEOMETRY '%s', using %dx%d", geo, SLCD_D_WID, SLCD_D_HEI) ;
+		lcd.wid=SLCD_D_WID ;
+		lcd.hei=SLCD_D_HEI ;
+	}
+
+	lcd.gwid=0 ;
+	lcd.ghei=0 ;
+	geo=getenv("LCD_VIRTUAL_GRAPHICS") ;
+	if (geo!=NULL && (sscanf(geo, "%dx%d", &lcd.gwid, &lcd.ghei)!=2 || 
+			lcd.gwid<1 || lcd.ghei<1)) {
+		logf(LG_WRN, "bad LCD_VIRTUAL_GRAPHICS '%s', text only", geo) ;
+		lcd.gwid=0 ;
+		lcd.ghei=0 ;
+	}
+	if (lcd.gwid>0) lcd.cap|=SLCD_HAS_GRAPHICS ;
+
+	/* Set icons, LEDs, Brightness and Contrast */
+	lcd.icons=0 ;
+	lcd.leds=0 ;
+	lcd.brightness=100 ;
+	lcd.contrast=50 ;
+	lcd_virtual_resetstats() ;
+
+	/* Allocate frame buffer */
+	lcd.frame=calloc(lcd.wid*lcd.hei, sizeof(unsigned int)) ;
+	lcd.arrows=calloc(lcd.hei, sizeof(int)) ;
+	if (lcd.frame==NULL || lcd.arrows==NULL) return SLCD_FALSE ;
+	if (lcd.gwid>0) {
+		lcd.pixels=calloc(lcd.ghei, (lcd.gwid+7)/8) ;
+		if (lcd.pixels==NULL) return SLCD_FALSE ;
+	}
+
+	/* Allocate screen memory */
+	lcd.scr.acText=malloc(sizeof(char *) * lcd.hei) ;
+	if (lcd.scr.acText==NULL) return SLCD_FALSE ;
+	lcd.scr.piArrows=malloc(sizeof(int) * lcd.hei) ;
+	if (lcd.scr.piArrows==NULL) return SLCD_FALSE ;
+	lcd.scr.piLineContents=malloc(sizeof(int) * lcd.hei) ;
+	if (lcd.scr.piLineContents==NULL) return SLCD_FALSE ;
+	for (r=0; r<lcd.hei; r++) {
+		/* Allow for each character on a line to be 3 unicode characters long */
+		lcd.scr.acText[r]=malloc( sizeof(char) * 3 * lcd.wid + 1 ) ;
+		if (lcd.scr.acText[r]==NULL) {
+			logf(LG_FTL, "memory allocation failure") ;
+			return SLCD_FALSE ;
+		}
+		lcd.scr.acText[r][0]='\0' ;
+		lcd.scr.piArrows[r]=LCD_ARROW_NONE ;
+		lcd.scr.piLineContents[r]=LCD_LINE_CONTENTS_TEXT ;
+	}
+	
+	/* Clear and update screen */
+	lcd_hwclearscr() ;
+	lcd_hwrefresh() ;
+
+	return SLCD_TRUE ;
+}
+
+/**
+ * lcd_exit
+ *
+ * This function closes down the LCD library
+ * and frees all associated memory.
+ **/
+void lcd_exit()
+{
+	int r ;
+
+	/* Free all allocated memory */
+	lcd_lock() ;
+	
+	if (lcd.scr.piArrows!=NULL) free(lcd.scr.piArrows) ;
+	lcd.scr.piArrows=NULL ;
+
+	if (lcd.scr.piLineContents!=NULL) free(lcd.scr.piLineContents) ;
+	lcd.scr.piLineContents=NULL ;
+
+	if (lcd.scr.acText!=NULL) for (r=0; r<lcd.hei; r++) {
+		if (lcd.scr.acText[r]!=NULL) free(lcd.scr.acText[r]) ;
+	}
+	free(lcd.scr.acText) ;
+	lcd.scr.acText=NULL ;
+
+	if (lcd.frame!=NULL) free(lcd.frame) ;
+	lcd.frame=NULL ;
+	if (lcd.arrows!=NULL) free(lcd.arrows) ;
+	lcd.arrows=NULL ;
+	if (lcd.pixels!=NULL) free(lcd.pixels) ;
+	lcd.pixels=NULL ;
+	lcd_unlock() ;
+}
+
+/**
+ * lcd_capabilities
+ *
+ * Returns a bitfield, which represents the capabilities of the LCD display.
+ **/
+enum slcd_e_caps lcd_capabilities()
+{
+	return lcd.cap ;
+}
+
+/**
+ * lcd_hwclearscr
+ *
+ * Clears the screen's working buffer. lcd_refresh must
+ * then be called to cause the LCD display contents to be
+ * updated to match. 
+ **/
+void lcd_hwclearscr()
+{
+	int r ;
+	if (lcd.scr.acText==NULL) return ;
+	for (r=0; r<lcd.hei; r++) {
+		lcd.scr.acText[r][0]='\0' ;
+		lcd.scr.piArrows[r]=LCD_ARROW_NONE ;
+	}
+	lcd_hwcursor(0, 0, SLCD_OFF) ;
+}
+
+
+/**
+ * lcd_hwputline
+ * num: line number of destination
+ * str: string to print on line (can contain unicode characters)
+ * sel: show selection arrows
+ *
+ * lcd_hwputline updates the given line in the display buffer.
+ * The line is left justified.  If sel is SLCD_ARROWS, selection
+ * arrows are displayed on the given line.
+ * lcd_refresh must be called to update the actual screen.
+ * The function returns true on success, or false if the
+ * target buffer does not exist.
+ **/
+int lcd_hwputline(int num, char *str, enum slcd_e_arrows sel)
+{
+	int i ;
+	if (num<0 || num>=lcd.hei) return SLCD_FALSE ;
+	
+	/* Copy the line */
+	for (i=0; i<(lcd.wid*3) && str[i]!='\0'; i++) 
+		lcd.scr.acText[num][i]=str[i] ;
+	lcd.scr.acText[num][i]='\0' ;
+	
+	/* Set the arrows requested */
+	switch (sel) {
+	case SLCD_SEL_ARROWS:
+		lcd.scr.piArrows[num]=LCD_ARROW_BOTH ;
+		break ;
+	case SLCD_SEL_NOARROWS:
+		lcd.scr.piArrows[num]=LCD_ARROW_NONE ;
+		break ;
+	default:
+		return SLCD_FALSE ;
+	}
+	
+	return SLCD_TRUE ;
+}
+
+
+/**
+ * lcd_brightness
+ * @level: Brightness level (0-100)
+ *
+ * lcd_brightness changes the screen's backlight level
+ * to the requested brightness.  This happens immediately
+ * and lcd_refresh is not required.
+ */
+void lcd_brightness(int level)
+{
+	if (level<0) level=0 ;
+	if (level>100) level=100 ;
+	lcd_tickbacklight(level) ;
+	lcd_lock() ;
+	lcd.brightness=level ;
+	lcd_hwsend(sizeof(int)) ;
+	lcd_unlock() ;
+}
+
+
+/**
+ * lcd_contrast
+ * @level: Contrast level (0-100)
+ *
+ * lcd_contrast changes the screen's contrast level
+ * to the requested value.  This happens immediately
+ * and lcd_refresh is not required.
+ */
+void lcd_contrast(int level)
+{
+	if (level<0) level=0 ;
+	if (level>100) level=100 ;
+	lcd_lock() ;
+	lcd.contrast=level ;
+	lcd_hwsend(sizeof(int)) ;
+	lcd_unlock() ;
+}
+
+
+/**
+ * lcd_hwcursor
+ * @x: Sets X position
+ * @y: Sets Y position
+ * @status: Defines whether cursor is on or off
+ *
+ * lcd_cursor moves the cursor to the specified X,Y
+ * position in the buffer.  It is turned on by setting
+ * the status to SLCD_ON and off with a status of SLCD_OFF.
+ * lcd_refresh must be called to see the cursor actually move.
+ * The function returns true on success, and false if
+ * the coordinates are out of range.
+ **/
+int lcd_hwcursor(int x,int y,enum slcd_e_status status)
+{
+	/* It appears that the drivers only let the cursor work on the first two rows */
+	if (x>=0 && x<lcd.wid && y>=0 && y<2 && y<lcd.hei) {
+		lcd.scr.iX=x ;
+		lcd.scr.iY=y ;
+		switch (status) {
+		case SLCD_ON:
+			lcd.scr.iCursorType=LCD_CURSOR_ON ;
+			break ;
+		case SLCD_OFF:
+			lcd.scr.iCursorType=LCD_CURSOR_OFF ;
+			break ;
+		}
+		return SLCD_TRUE ;
+	} else {
+		return SLCD_FALSE ;
+	}
+}	
+
+
+/**
+ * lcd_seticon
+ * @icon: Icon to set or clear
+ * @state: State to switch the icon to
+ * 
+ * This function is used to set or clear any of the icons or LEDs
+ * on the radio.  The icon is specified along with a state of SLCD_ON
+ * or SLCD_OFF.
+ * If the icons do not actually exist on the radio, this function stores the
+ * would-be state, which can be retrieved with the lcd_geticon function.
+ * The function returns true on success, and false in the case of mis-use.
+ **/
+int lcd_seticon(enum slcd_e_icons icon, enum slcd_e_status state)
+{
+	int mask ;
+	
+	/* Turn an LED On or Off */
+	switch (icon) {
+	case SLCD_ICON_MENU:
+		mask=RLED_MENU ;
+		break ;
+	case SLCD_ICON_VOLUME:
+		mask=RLED_VOLUME ;
+		break ;
+	default:
+		mask=0 ;
+		break ;
+	}
+	if (mask!=0) {
+		lcd_lock() ;
+		if (state==SLCD_ON) {
+			lcd.leds |= mask ;
+		} else {
+			lcd.leds |= mask ;
+			lcd.leds ^= mask ;
+		}
+		lcd_unlock() ;
+		return SLCD_TRUE ;
+	}
+
+	/* Turn an Icon On or Off */
+	mask=0 ;
+	switch (icon) {
+	case SLCD_ICON_SHIFT:
+		mask=LCD_BITMASK_SHIFT ;
+		break ;
+	case SLCD_ICON_IRADIO:
+		mask=LCD_BITMASK_IRADIO ;
+		break ;
+	case SLCD_ICON_MEDIA:
+		mask=LCD_BITMASK_MEDIA ;
+		break ;
+	case SLCD_ICON_SHUFFLE:
+		mask=LCD_BITMASK_SHUFFLE ;
+		break ;
+	case SLCD_ICON_REPEAT:
+		mask=LCD_BITMASK_REPEAT ;
+		break ;
+	case SLCD_ICON_SLEEP:
+		mask=LCD_BITMASK_SLEEP_TIMER ;
+		break ;
+	case SLCD_ICON_MUTE:
+		mask=LCD_BITMASK_MUTE ;
+		break ;
+	case SLCD_ICON_ALARM:
+		mask=LCD_BITMASK_ALARM ;
+		break ;
+	case SLCD_ICON_SNOOZE:
+		mask=LCD_BITMASK_SNOOZE ;
+		break ;
+	default:
+		break ;
+	}
+	if (mask!=0) {
+		lcd_lock() ;
+		if (state==SLCD_ON) {
+			lcd.icons |= mask ;
+		} else {
+			lcd.icons |= mask ;
+			lcd.icons ^= mask ;
+		}
+		lcd_unlock() ;
+		return SLCD_TRUE ;
+	}
+	
+	return SLCD_FALSE ;
+}
+
+
+/**
+ * lcd_geticon
+ * @icon: Icon
+ * 
+ * This function is used to query the current state of the specified
+ * icon.  This function reports the would-be state of the icon, in
+ * the event that the icon does not actually exist.
+ * This function returns SLCD_ON or SLCD_OFF.
+ **/
+enum slcd_e_icons lcd_geticon(enum slcd_e_icons icon)
+{
+	int mask ;
+	
+	/* Check LEDs */
+	switch (icon) {
+	case SLCD_ICON_MENU:
+		mask=RLED_MENU ;
+		break ;
+	case SLCD_ICON_VOLUME:
+		mask=RLED_VOLUME ;
+		break ;
+	default:
+		mask=0 ;
+		break ;
+	}
+	if (mask!=0) return (lcd.leds&mask)!=0 ;
+
+	/* Check Icons  */
+	mask=0 ;
+	switch (icon) {
+	case SLCD_ICON_SHIFT:
+		mask=LCD_BITMASK_SHIFT ;
+		break ;
+	case SLCD_ICON_IRADIO:
+		mask=LCD_BITMASK_IRADIO ;
+		break ;
+	case SLCD_ICON_MEDIA:
+		mask=LCD_BITMASK_MEDIA ;
+		break ;
+	case SLCD_ICON_SHUFFLE:
+		mask=LCD_BITMASK_SHUFFLE ;
+		break ;
+	case SLCD_ICON_REPEAT:
+		mask=LCD_BITMASK_REPEAT ;
+		break ;
+	case SLCD_ICON_SLEEP:
+		mask=LCD_BITMASK_SLEEP_TIMER ;
+		break ;
+	case SLCD_ICON_MUTE:
+		mask=LCD_BITMASK_MUTE ;
+		break ;
+	case SLCD_ICON_ALARM:
+		mask=LCD_BITMASK_ALARM ;
+		break ;
+	case SLCD_ICON_SNOOZE:
+		mask=LCD_BITMASK_SNOOZE ;
+		break ;
+	default:
+		break ;
+	}
+	if (mask!=0) return (lcd.icons&mask)!=0 ;
+	
+	return SLCD_FALSE ;
+}
+
+/**
+ * lcd_width
+*
+* Returns the LCD display width
+**/
+int lcd_width()
+{
+	return lcd.wid ;
+}
+
+/**
+ * lcd_height
+*
+* Returns the LCD display height
+**/
+int lcd_height()
+{
+	return lcd.hei ;
+}
+
+/**
+ * lcd_hwrefresh
+ *
+ * lcd_hwrefresh function causes the contents of the screen
+ * buffer to be written to the actual display.  this affects
+ * textual content, selection arrows and the cursor.
+ * Each line is centred, as the radio's driver does, with one
+ * character cell per UTF8 character.
+ **/
+void lcd_hwrefresh()
+{
+	int r, c, i, len, pad, bytes ;
+	unsigned int *row ;
+
+	bytes=sizeof(struct lcd_draw_screen) ;
+	for (r=0; r<lcd.hei; r++) {
+		row=&lcd.frame[r*lcd.wid] ;
+		bytes+=strlen(lcd.scr.acText[r])+1+2*sizeof(int) ;
+
+		/* Work out len & left pad size */
+		for (len=0, i=0; lcd.scr.acText[r][i]!='\0'; len++) lcd_hwglyph(lcd.scr.acText[r], &i) ;
+		pad=(len<lcd.wid) ? (lcd.wid-len)/2 : 0 ;
+
+		/* Render the row */
+		for (c=0; c<pad; c++) row[c]=' ' ;
+		for (i=0; c<lcd.wid && lcd.scr.acText[r][i]!='\0'; c++) 
+			row[c]=lcd_hwglyph(lcd.scr.acText[r], &i) ;
+		for (; c<lcd.wid; c++) row[c]=' ' ;
+		lcd.arrows[r]=lcd.scr.piArrows[r] ;
+	}
+	lcd.cursorx=lcd.scr.iX ;
+	lcd.cursory=lcd.scr.iY ;
+	lcd.cursoron=(lcd.scr.iCursorType==LCD_CURSOR_ON) ;
+
+	lcd.stats.refreshes++ ;
+	lcd_hwsend(bytes) ;
+}
+
+/**
+ * lcd_driverclock
+ * @clk: current date / time
+ * @almon: identifies whether alarm is on or off
+ * @alm: alarm date / time
+ * @clkmode: display mode for clock (12hr,24hr)
+ * @am: AM text
+ * @pm: PM text
+ * @title: clock title
+ * 
+ * lcd_driverclock function sets the clock display parameters,
+ * and then it will display the clock on the LCD screen.
+ * optionally, the alarm time can also be displayed - for this
+ * the alm function has to point to a time_t structure, and not
+ * be NULL, and the almon status must be SLCD_ON.
+ * This function will overwrite whatever has been displayed with the 
+ * lcd_refresh function.
+ **/
+int lcd_hwclock(struct tm *clk, enum slcd_e_status almon, struct tm *alm,
+	enum slcd_e_clkmode clkmode, char *am, char *pm, char *title) {
+	return SLCD_FALSE ;
+}
+
+/**
+ * lcd_hwgetscreen
+ *
+ * This function returns a pointer to a
+ * character array, with the current
+ * screen contents that will be shown on
+ * the next lcd_hwrefresh()
+ **/
+char ** lcd_hwgetscreen() {
+	return lcd.scr.acText ;
+}
+
+/**
+ * lcd_hwgetselrows
+ *
+ * This function returns a pointer to an
+ * integer array, identifying if the 
+ * corresponding row has <> selection
+ * arrows or not.  The s that will be shown on
+ * the next lcd_hwrefresh()
+ **/
+enum slcd_e_arrows * lcd_hwgetselrows() {
+	return (enum slcd_e_arrows *) lcd.scr.piArrows ;
+}
+
+/**
+ * lcd_hwgraphicsize
+ * @width: set to the graphics display width in pixels
+ * @height: set to the graphics display height in pixels
+ *
+ * Returns true if the display has SLCD_HAS_GRAPHICS, or false
+ * (with both sizes set to zero) if it only shows text.
+ **/
+int lcd_hwgraphicsize(int *width, int *height)
+{
+	*width=lcd.gwid ;
+	*height=lcd.ghei ;
+	return (lcd.gwid>0 && lcd.ghei>0) ;
+}
+
+/**
+ * lcd_hwdrawbitmap
+ * @left, @top: position of the region on the display in pixels
+ * @width, @height: size of the region in pixels
+ * @data: 1bpp pixels, each row packed MSB first into (width+7)/8 bytes
+ *
+ * Copies a region of pixels into the graphics display, and
+ * accounts for it as one IOC_LCD_DRAW_BITMAP.  Returns true
+ * on success.
+ **/
+int lcd_hwdrawbitmap(int left, int top, int width, int height, unsigned char *data)
+{
+	int x, y, sstride, dstride, bit ;
+	unsigned char *d ;
+
+	if (lcd.pixels==NULL || data==NULL) return SLCD_FALSE ;
+	sstride=(width+7)/8 ;
+	dstride=(lcd.gwid+7)/8 ;
+	for (y=0; y<height; y++) {
+		if (top+y<0 || top+y>=lcd.ghei) continue ;
+		for (x=0; x<width; x++) {
+			if (left+x<0 || left+x>=lcd.gwid) continue ;
+			bit=(data[y*sstride+x/8]>>(7-x%8))&1 ;
+			d=&lcd.pixels[(top+y)*dstride+(left+x)/8] ;
+			if (bit) *d|=0x80>>((left+x)%8) ;
+			else *d&=~(0x80>>((left+x)%8)) ;
+		}
+	}
+	lcd_hwsend(sizeof(struct bitmap_data)+height*sstride) ;
+	return SLCD_TRUE ;
+}
+
+/**
+ * lcd_hwgrabbitmap
+ * @data: destination, 1bpp rows packed MSB first into (width+7)/8 bytes
+ * @size: size of data in bytes
+ * @width, @height: set to the graphics display size in pixels
+ *
+ * Copies the graphics display out, and accounts for it as one
+ * IOC_LCD_GRAB_SCREEN_REGION.  The virtual display only exists in
+ * this process, so unlike the hardware it needs lcd_init().
+ * Returns true on success.
+ **/
+int lcd_hwgrabbitmap(unsigned char *data, int size, int *width, int *height)
+{
+	int bytes=((lcd.gwid+7)/8)*lcd.ghei ;
+
+	*width=lcd.gwid ;
+	*height=lcd.ghei ;
+	if (lcd.pixels==NULL || data==NULL || size<bytes) return SLCD_FALSE ;
+	lcd_lock() ;
+	memcpy(data, lcd.pixels, bytes) ;
+	lcd_unlock() ;
+	lcd_hwsend(sizeof(struct bitmap_data)+bytes) ;
+	return SLCD_TRUE ;
+}
+
+/*************************
+ * Virtual display access
+ *************************/
+
+/**
+ * lcd_virtual_getstats
+ * @stats: destination for the counters
+ *
+ * Copies the refresh and transfer counters, counted since
+ * lcd_init() or the last lcd_virtual_resetstats().
+ **/
+void lcd_virtual_getstats(struct lcd_virtual_stats *stats)
+{
+	if (stats==NULL) return ;
+	lcd_lock() ;
+	*stats=lcd.stats ;
+	lcd_unlock() ;
+}
+
+/**
+ * lcd_virtual_resetstats
+ *
+ * Zeroes the refresh and transfer counters.
+ **/
+void lcd_virtual_resetstats()
+{
+	lcd_lock() ;
+	memset(&lcd.stats, 0, sizeof(lcd.stats)) ;
+	lcd_unlock() ;
+}
+
+/**
+ * lcd_virtual_getframe
+ *
+ * Returns the rendered display as lcd_height() rows of
+ * lcd_width() unicode characters, as of the last refresh.
+ * Hold lcd_lock() while reading it if other threads draw.
+ **/
+const unsigned int *lcd_virtual_getframe()
+{
+	return lcd.frame ;
+}
+
+/**
+ * lcd_virtual_getbitmap
+ * @width, @height: set to the graphics size in pixels
+ *
+ * Returns the graphics display as 1bpp rows of (width+7)/8
+ * bytes, MSB first, or NULL if LCD_VIRTUAL_GRAPHICS is not set.
+ **/
+const unsigned char *lcd_virtual_getbitmap(int *width, int *height)
+{
+	*width=lcd.gwid ;
+	*height=lcd.ghei ;
+	return lcd.pixels ;
+}
+
+/**
+ * lcd_virtual_dumpframe
+ * @f: destination file
+ *
+ * Writes the rendered display as UTF8 text, one row per line,
+ * framed by the selection arrows.  The radio's private glyphs
+ * (END, DEL, volume etc.) are shown as ASCII look-alikes.
+ **/
+void lcd_virtual_dumpframe(FILE *f)
+{
+	int r, c ;
+	unsigned int u ;
+	char lp, rp ;
+
+	if (f==NULL) return ;
+	lcd_lock() ;
+	if (lcd.frame==NULL) {
+		lcd_unlock() ;
+		return ;
+	}
+	fprintf(f, "frame %lu\n+", lcd.stats.refreshes) ;
+	for (c=0; c<lcd.wid; c++) fputc('-', f) ;
+	fprintf(f, "+\n") ;
+	for (r=0; r<lcd.hei; r++) {
+		lp=(lcd.arrows[r]==LCD_ARROW_LEFT || lcd.arrows[r]==LCD_ARROW_BOTH)?'<':'|' ;
+		rp=(lcd.arrows[r]==LCD_ARROW_RIGHT || lcd.arrows[r]==LCD_ARROW_BOTH)?'>':'|' ;
+		fputc(lp, f) ;
+		for (c=0; c<lcd.wid; c++) {
+			u=lcd.frame[r*lcd.wid+c] ;
+			if (lcd.cursoron && r==lcd.cursory && c==lcd.cursorx) u='_' ;
+			if (u>=0xE000 && u<=0xE00F) u="ENDDELVv<>pbfrsx"[u-0xE000] ;
+			if (u<0x80) {
+				fputc(u, f) ;
+			} else if (u<0x800) {
+				fputc(0xC0|(u>>6), f) ;
+				fputc(0x80|(u&0x3F), f) ;
+			} else if (u<0x10000) {
+				fputc(0xE0|(u>>12), f) ;
+				fputc(0x80|((u>>6)&0x3F), f) ;
+				fputc(0x80|(u&0x3F), f) ;
+			} else {
+				fputc(0xF0|(u>>18), f) ;
+				fputc(0x80|((u>>12)&0x3F), f) ;
+				fputc(0x80|((u>>6)&0x3F), f) ;
+				fputc(0x80|(u&0x3F), f) ;
+			}
+		}
+		fputc(rp, f) ;
+		fputc('\n', f) ;
+	}
+	fprintf(f, "+") ;
+	for (c=0; c<lcd.wid; c++) fputc('-', f) ;
+	fprintf(f, "+\n") ;
+	lcd_unlock() ;
+}
+
+/*
+ * Local support functions
+ */
+
+/* Accounts for one transfer to the (virtual) driver */
+static void lcd_hwsend(int bytes)
+{
+	lcd.stats.ioctls++ ;
+	lcd.stats.bytes+=bytes ;
+}
+
+/* Decodes the UTF8 character at *pos, and moves *pos past it */
+static unsigned int lcd_hwglyph(char *str, int *pos)
+{
+	unsigned char *s=(unsigned char *)str+*pos ;
+	unsigned int c ;
+	int n, i ;
+
+	if (s[0]<0x80) { c=s[0] ; n=0 ; }
+	else if ((s[0]&0xE0)==0xC0) { c=s[0]&0x1F ; n=1 ; }
+	else if ((s[0]&0xF0)==0xE0) { c=s[0]&0x0F ; n=2 ; }
+	else if ((s[0]&0xF8)==0xF0) { c=s[0]&0x07 ; n=3 ; }
+	else { c='?' ; n=0 ; }
+
+	for (i=1; i<=n && (s[i]&0xC0)==0x80; i++) c=(c<<6)|(s[i]&0x3F) ;
+	if (i<=n) c='?' ;
+	*pos+=i ;
+	return c ;
+}
@@ -0,0 +1,548 @@
+/*
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github
+ *
+ * This file is part of the sharpfin project
+ * LCD bitmap drawing
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * LCD Bitmap Surfaces
+ *
+ * Drawing is done in memory, and only the dirty rectangles of a
+ * screen surface are sent to the driver, through lcd_hwdrawbitmap().
+ */
+#include "lcdbitmap.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*************************
+ * Local Variables, defs and types
+ *************************/
+
+/*
+ * 5x7 font for ASCII 0x20 to 0x7E, one byte per column,
+ * least significant bit at the top.
+ */
+static const unsigned char lcd_bitmapfont[95][5]={
+	{0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14},
+	{0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, {0x36,0x49,0x55,0x22,0x50}, {0x00,0x05,0x03,0x00,0x00},
+	{0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00}, {0x14,0x08,0x3E,0x08,0x14}, {0x08,0x08,0x3E,0x08,0x08},
+	{0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x60,0x60,0x00,0x00}, {0x20,0x10,0x08,0x04,0x02},
+	{0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, {0x42,0x61,0x51,0x49,0x46}, {0x21,0x41,0x45,0x4B,0x31},
+	{0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x30}, {0x01,0x71,0x09,0x05,0x03},
+	{0x36,0x49,0x49,0x49,0x36}, {0x06,0x49,0x49,0x29,0x1E}, {0x00,0x36,0x36,0x00,0x00}, {0x00,0x56,0x36,0x00,0x00},
+	{0x08,0x14,0x22,0x41,0x00}, {0x14,0x14,0x14,0x14,0x14}, {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x51,0x09,0x06},
+	{0x32,0x49,0x79,0x41,0x3E}, {0x7E,0x11,0x11,0x11,0x7E}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22},
+	{0x7F,0x41,0x41,0x22,0x1C}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x49,0x49,0x7A},
+	{0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41},
+	{0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x0C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E},
+	{0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46}, {0x46,0x49,0x49,0x49,0x31},
+	{0x01,0x01,0x7F,0x01,0x01}, {0x3F,0x40,0x40,0x40,0x3F}, {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F},
+	{0x63,0x14,0x08,0x14,0x63}, {0x07,0x08,0x70,0x08,0x07}, {0x61,0x51,0x49,0x45,0x43}, {0x00,0x7F,0x41,0x41,0x00},
+	{0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x7F,0x00}, {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40},
+	{0x00,0x01,0x02,0x04,0x00}, {0x20,0x54,0x54,0x54,0x78}, {0x7F,0x48,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x20},
+	{0x38,0x44,0x44,0x48,0x7F}, {0x38,0x54,0x54,0x54,0x18}, {0x08,0x7E,0x09,0x01,0x02}, {0x0C,0x52,0x52,0x52,0x3E},
+	{0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x44,0x3D,0x00}, {0x7F,0x10,0x28,0x44,0x00},
+	{0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x18,0x04,0x78}, {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38},
+	{0x7C,0x14,0x14,0x14,0x08}, {0x08,0x14,0x14,0x18,0x7C}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x20},
+	{0x04,0x3F,0x44,0x40,0x20}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C},
+	{0x44,0x28,0x10,0x28,0x44}, {0x0C,0x50,0x50,0x50,0x3C}, {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00},
+	{0x00,0x00,0x7F,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, {0x08,0x04,0x08,0x10,0x08}
+} ;
+
+/*
+ * 8x8 icons, indexed by enum slcd_e_icons, one byte per row,
+ * most significant bit on the left.
+ */
+static const unsigned char lcd_bitmapicons[SLCD_ICON_FF+1][SLCD_BITMAP_ICONSIZE]={
+	{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00},	/* (unused) */
+	{0x18,0x3C,0x7E,0x18,0x18,0x18,0x18,0x00},	/* SHIFT */
+	{0x04,0x08,0xFF,0x81,0xB5,0xB1,0xFF,0x00},	/* IRADIO */
+	{0x0C,0x0E,0x0B,0x09,0x08,0x78,0xF8,0x70},	/* MEDIA */
+	{0x00,0xE2,0x14,0x08,0x14,0xE2,0x00,0x00},	/* SHUFFLE */
+	{0x08,0x7C,0x88,0x81,0x11,0x3E,0x10,0x00},	/* REPEAT */
+	{0x00,0x7E,0x04,0x08,0x10,0x20,0x7E,0x00},	/* SLEEP */
+	{0x10,0x30,0xF5,0xF2,0xF5,0x30,0x10,0x00},	/* MUTE */
+	{0x18,0x3C,0x3C,0x3C,0x7E,0xFF,0x18,0x00},	/* ALARM */
+	{0xF0,0x20,0x40,0xF0,0x0F,0x02,0x04,0x0F},	/* SNOOZE */
+	{0x00,0xFF,0x00,0xFF,0x00,0xFF,0x00,0x00},	/* MENU */
+	{0x10,0x32,0xF1,0xF5,0xF1,0x32,0x10,0x00},	/* VOLUME */
+	{0x00,0x11,0x33,0x77,0xFF,0x77,0x33,0x11},	/* REWIND */
+	{0x00,0x66,0x66,0x66,0x66,0x66,0x66,0x00},	/* PAUSE */
+	{0x00,0x7E,0x7E,0x7E,0x7E,0x7E,0x7E,0x00},	/* STOP */
+	{0x00,0x88,0xCC,0xEE,0xFF,0xEE,0xCC,0x88}	/* FF */
+} ;
+
+static int lcd_bitmapclip(lcd_bitmap *bm, int *x, int *y, int *w, int *h) ;
+static void lcd_bitmapdirty(lcd_bitmap *bm, int x, int y, int w, int h) ;
+static void lcd_bitmapfillarea(lcd_bitmap *bm, int x, int y, int w, int h, enum slcd_e_pixel mode) ;
+static void lcd_bitmapcopy(lcd_bitmap *dst, int dx, int dy, const unsigned char *src, int sstride,
+	int swid, int shei, int sx, int sy, int w, int h) ;
+static void lcd_bitmapcopyrow(unsigned char *dst, int dx, const unsigned char *src, int sx, int w) ;
+static void lcd_bitmapsetpixel(lcd_bitmap *bm, int x, int y, enum slcd_e_pixel mode) ;
+static unsigned char *lcd_bitmapreserve(lcd_bitmap *bm, int size) ;
+
+/*************************
+ * Surface creation and deletion
+ *************************/
+
+/**
+ * lcd_bitmapcreate
+ * @width: width in pixels, or 0 for the display
+ * @height: height in pixels, or 0 for the display
+ *
+ * Creates a cleared surface.  With a zero size, the surface covers
+ * the graphics display, and lcd_bitmapflush() sends it there.
+ * Otherwise it is an off-screen surface, e.g. for icons or album
+ * art, to be drawn with lcd_bitmapblit().
+ * Returns NULL if out of memory, or if a screen surface is
+ * requested from a display without SLCD_HAS_GRAPHICS.
+ **/
+lcd_bitmap *lcd_bitmapcreate(int width, int height)
+{
+	lcd_bitmap *bm ;
+	int screen=SLCD_FALSE ;
+
+	if (width<=0 || height<=0) {
+		if (!lcd_hwgraphicsize(&width, &height)) {
+			logf(LG_ERR, "display has no graphics") ;
+			return NULL ;
+		}
+		screen=SLCD_TRUE ;
+	}
+
+	bm=malloc(sizeof(lcd_bitmap)) ;
+	if (bm==NULL) {
+		logf(LG_FTL, "memory allocation failure") ;
+		return NULL ;
+	}
+	bm->width=width ;
+	bm->height=height ;
+	bm->stride=(width+7)/8 ;
+	bm->screen=screen ;
+	bm->ndirty=0 ;
+	bm->packbuf=NULL ;
+	bm->packsize=0 ;
+	bm->pixels=calloc(height, bm->stride) ;
+	if (bm->pixels==NULL) {
+		logf(LG_FTL, "memory allocation failure") ;
+		free(bm) ;
+		return NULL ;
+	}
+
+	/* The display's contents are unknown, so send everything first time */
+	lcd_bitmapdirty(bm, 0, 0, width, height) ;
+	return bm ;
+}
+
+/**
+ * lcd_bitmapdelete
+ * @bm: surface
+ *
+ * Frees the surface and its pixels.
+ **/
+void lcd_bitmapdelete(lcd_bitmap *bm)
+{
+	if (bm==NULL) return ;
+	if (bm->packbuf!=NULL) free(bm->packbuf) ;
+	free(bm->pixels) ;
+	free(bm) ;
+}
+
+/*************************
+ * Drawing
+ *************************/
+
+/**
+ * lcd_bitmapfill
+ * @bm: surface
+ * @x, @y, @w, @h: area to fill, clipped to the surface
+ * @mode: SLCD_PIXEL_ON, SLCD_PIXEL_OFF or SLCD_PIXEL_INVERT
+ *
+ * Fills a rectangle.
+ **/
+void lcd_bitmapfill(lcd_bitmap *bm, int x, int y, int w, int h, enum slcd_e_pixel mode)
+{
+	if (bm==NULL || !lcd_bitmapclip(bm, &x, &y, &w, &h)) return ;
+	lcd_bitmapfillarea(bm, x, y, w, h, mode) ;
+	lcd_bitmapdirty(bm, x, y, w, h) ;
+}
+
+/**
+ * lcd_bitmapblit
+ * @dst: destination surface
+ * @dx, @dy: destination position
+ * @src: source surface
+ * @sx, @sy, @w, @h: source area
+ *
+ * Copies an area of one surface to another, clipped to both.
+ **/
+void lcd_bitmapblit(lcd_bitmap *dst, int dx, int dy, lcd_bitmap *src, int sx, int sy, int w, int h)
+{
+	if (dst==NULL || src==NULL) return ;
+	lcd_bitmapcopy(dst, dx, dy, src->pixels, src->stride, src->width, src->height, sx, sy, w, h) ;
+}
+
+/**
+ * lcd_bitmapdraw
+ * @bm: surface
+ * @x, @y: destination position
+ * @data: 1bpp pixels, each row packed MSB first into (w+7)/8 bytes
+ * @w, @h: size of the data in pixels
+ *
+ * Copies packed pixel data onto the surface.
+ **/
+void lcd_bitmapdraw(lcd_bitmap *bm, int x, int y, const unsigned char *data, int w, int h)
+{
+	if (bm==NULL || data==NULL) return ;
+	lcd_bitmapcopy(bm, x, y, data, (w+7)/8, w, h, 0, 0, w, h) ;
+}
+
+/**
+ * lcd_bitmaptext
+ * @bm: surface
+ * @x, @y: position of the top left of the first character
+ * @str: UTF8 text
+ * @mode: SLCD_PIXEL_ON for dark on light, SLCD_PIXEL_OFF for light
+ *        on dark, or SLCD_PIXEL_INVERT to invert the glyph pixels only
+ *
+ * Renders text with the built in 5x7 font, in cells of
+ * SLCD_BITMAP_FONTWID x SLCD_BITMAP_FONTHEI pixels, which are
+ * cleared first unless inverting.  Characters outside ASCII
+ * are drawn as '?'.
+ * Returns the x position following the text.
+ **/
+int lcd_bitmaptext(lcd_bitmap *bm, int x, int y, char *str, enum slcd_e_pixel mode)
+{
+	unsigned char *s=(unsigned char *)str ;
+	const unsigned char *glyph ;
+	int startx=x, c, r, cx, cy, cw, ch ;
+
+	if (bm==NULL || str==NULL) return x ;
+
+	for (; *s!='\0' && x<bm->width; x+=SLCD_BITMAP_FONTWID) {
+		/* One glyph per UTF8 character */
+		if (*s>=0x20 && *s<0x7F) glyph=lcd_bitmapfont[*s-0x20] ;
+		else glyph=lcd_bitmapfont['?'-0x20] ;
+		if ((*s&0xC0)==0xC0)
+			for (s++; (*s&0xC0)==0x80; s++) ;
+		else
+			s++ ;
+
+		/* Clear the cell, then set the glyph pixels */
+		cx=x ; cy=y ; cw=SLCD_BITMAP_FONTWID ; ch=SLCD_BITMAP_FONTHEI ;
+		if (mode!=SLCD_PIXEL_INVERT && lcd_bitmapclip(bm, &cx, &cy, &cw, &ch))
+			lcd_bitmapfillarea(bm, cx, cy, cw, ch, (mode==SLCD_PIXEL_ON)?SLCD_PIXEL_OFF:SLCD_PIXEL_ON) ;
+		for (c=0; c<5; c++) {
+			for (r=0; r<7; r++) {
+				if ((glyph[c]>>r)&1) lcd_bitmapsetpixel(bm, x+c, y+r, mode) ;
+			}
+		}
+	}
+
+	cx=startx ; cy=y ; cw=x-startx ; ch=SLCD_BITMAP_FONTHEI ;
+	if (lcd_bitmapclip(bm, &cx, &cy, &cw, &ch)) lcd_bitmapdirty(bm, cx, cy, cw, ch) ;
+	return x ;
+}
+
+/**
+ * lcd_bitmapicon
+ * @bm: surface
+ * @x, @y: destination position
+ * @icon: icon to draw
+ * @mode: as for lcd_bitmaptext()
+ *
+ * Draws one of the radio's icons in a SLCD_BITMAP_ICONSIZE square.
+ * Returns false if there is no bitmap for the icon.
+ **/
+int lcd_bitmapicon(lcd_bitmap *bm, int x, int y, enum slcd_e_icons icon, enum slcd_e_pixel mode)
+{
+	unsigned char inv[SLCD_BITMAP_ICONSIZE] ;
+	int r, c, cx, cy, cw, ch ;
+
+	if (bm==NULL || icon<SLCD_ICON_SHIFT || icon>SLCD_ICON_FF) return SLCD_FALSE ;
+
+	switch (mode) {
+	case SLCD_PIXEL_ON:
+		lcd_bitmapdraw(bm, x, y, lcd_bitmapicons[icon], SLCD_BITMAP_ICONSIZE, SLCD_BITMAP_ICONSIZE) ;
+		break ;
+	case SLCD_PIXEL_OFF:
+		for (r=0; r<SLCD_BITMAP_ICONSIZE; r++) inv[r]=~lcd_bitmapicons[icon][r] ;
+		lcd_bitmapdraw(bm, x, y, inv, SLCD_BITMAP_ICONSIZE, SLCD_BITMAP_ICONSIZE) ;
+		break ;
+	case SLCD_PIXEL_INVERT:
+		for (r=0; r<SLCD_BITMAP_ICONSIZE; r++) {
+			for (c=0; c<SLCD_BITMAP_ICONSIZE; c++) {
+				if ((lcd_bitmapicons[icon][r]<<c)&0x80) lcd_bitmapsetpixel(bm, x+c, y+r, mode) ;
+			}
+		}
+		cx=x ; cy=y ; cw=SLCD_BITMAP_ICONSIZE ; ch=SLCD_BITMAP_ICONSIZE ;
+		if (lcd_bitmapclip(bm, &cx, &cy, &cw, &ch)) lcd_bitmapdirty(bm, cx, cy, cw, ch) ;
+		break ;
+	}
+	return SLCD_TRUE ;
+}
+
+/*************************
+ * Display update
+ *************************/
+
+/**
+ * lcd_bitmapflush
+ * @bm: screen surface
+ *
+ * Sends the dirty rectangles of a screen surface to the display,
+ * one lcd_hwdrawbitmap() each, and marks the surface clean.
+ * Returns true on success, or false if the surface is off-screen
+ * or the display rejected a rectangle.
+ **/
+int lcd_bitmapflush(lcd_bitmap *bm)
+{
+	struct slcd_s_rect *d ;
+	unsigned char *buf ;
+	int i, r, stride, ok=SLCD_TRUE ;
+
+	if (bm==NULL || !bm->screen) return SLCD_FALSE ;
+
+	for (i=0; i<bm->ndirty; i++) {
+		/* Pack the rectangle's pixels into rows of their own */
+		d=&bm->dirty[i] ;
+		stride=(d->w+7)/8 ;
+		buf=lcd_bitmapreserve(bm, stride*d->h) ;
+		if (buf==NULL) return SLCD_FALSE ;
+		memset(buf, 0, stride*d->h) ;
+		for (r=0; r<d->h; r++) {
+			lcd_bitmapcopyrow(&buf[r*stride], 0, &bm->pixels[(d->y+r)*bm->stride], d->x, d->w) ;
+		}
+		lcd_lock() ;
+		if (!lcd_hwdrawbitmap(d->x, d->y, d->w, d->h, buf)) ok=SLCD_FALSE ;
+		lcd_unlock() ;
+	}
+	bm->ndirty=0 ;
+	return ok ;
+}
+
+/**
+ * lcd_bitmapinvalidate
+ * @bm: surface
+ *
+ * Marks the whole surface dirty, e.g. after the text screen has
+ * been drawn over it.
+ **/
+void lcd_bitmapinvalidate(lcd_bitmap *bm)
+{
+	if (bm==NULL) return ;
+	bm->ndirty=0 ;
+	lcd_bitmapdirty(bm, 0, 0, bm->width, bm->height) ;
+}
+
+/*************************
+ * Local support functions
+ *************************/
+
+/* Clips a rectangle to the surface, returns false if nothing is left */
+int lcd_bitmapclip(lcd_bitmap *bm, int *x, int *y, int *w, int *h)
+{
+	if (*x<0) { *w+=*x ; *x=0 ; }
+	if (*y<0) { *h+=*y ; *y=0 ; }
+	if (*x+*w>bm->width) *w=bm->width-*x ;
+	if (*y+*h>bm->height) *h=bm->height-*y ;
+	return (*w>0 && *h>0) ;
+}
+
+/* Adds a (clipped) rectangle to a screen surface's dirty list */
+void lcd_bitmapdirty(lcd_bitmap *bm, int x, int y, int w, int h)
+{
+	struct slcd_s_rect r, u, *d ;
+	int i, best, cost, bestcost ;
+
+	if (!bm->screen) return ;
+	r.x=x ; r.y=y ; r.w=w ; r.h=h ;
+
+	/* Absorb any rectangles that this one overlaps or touches */
+	for (i=0; i<bm->ndirty; ) {
+		d=&bm->dirty[i] ;
+		if (r.x<=d->x+d->w && d->x<=r.x+r.w && r.y<=d->y+d->h && d->y<=r.y+r.h) {
+			u.x=(r.x<d->x)?r.x:d->x ;
+			u.y=(r.y<d->y)?r.y:d->y ;
+			u.w=((r.x+r.w>d->x+d->w)?r.x+r.w:d->x+d->w)-u.x ;
+			u.h=((r.y+r.h>d->y+d->h)?r.y+r.h:d->y+d->h)-u.y ;
+			r=u ;
+			*d=bm->dirty[--bm->ndirty] ;
+			i=0 ;
+		} else {
+			i++ ;
+		}
+	}
+
+	if (bm->ndirty<SLCD_BITMAP_MAXDIRTY) {
+		bm->dirty[bm->ndirty++]=r ;
+		return ;
+	}
+
+	/* The list is full, so grow whichever rectangle grows least */
+	for (i=0, best=0, bestcost=-1; i<bm->ndirty; i++) {
+		d=&bm->dirty[i] ;
+		u.x=(r.x<d->x)?r.x:d->x ;
+		u.y=(r.y<d->y)?r.y:d->y ;
+		u.w=((r.x+r.w>d->x+d->w)?r.x+r.w:d->x+d->w)-u.x ;
+		u.h=((r.y+r.h>d->y+d->h)?r.y+r.h:d->y+d->h)-u.y ;
+		cost=u.w*u.h-d->w*d->h ;
+		if (bestcost<0 || cost<bestcost) {
+			best=i ;
+			bestcost=cost ;
+		}
+	}
+	d=&bm->dirty[best] ;
+	u.x=(r.x<d->x)?r.x:d->x ;
+	u.y=(r.y<d->y)?r.y:d->y ;
+	u.w=((r.x+r.w>d->x+d->w)?r.x+r.w:d->x+d->w)-u.x ;
+	u.h=((r.y+r.h>d->y+d->h)?r.y+r.h:d->y+d->h)-u.y ;
+	*d=u ;
+}
+
+/* Fills an already clipped rectangle, a byte at a time where possible */
+void lcd_bitmapfillarea(lcd_bitmap *bm, int x, int y, int w, int h, enum slcd_e_pixel mode)
+{
+	unsigned char *row, lmask, rmask ;
+	int r, b, lb, rb ;
+
+	lb=x/8 ;
+	rb=(x+w-1)/8 ;
+	lmask=0xFF>>(x%8) ;
+	rmask=0xFF<<(7-(x+w-1)%8) ;
+	if (lb==rb) lmask&=rmask ;
+
+	for (r=y; r<y+h; r++) {
+		row=&bm->pixels[r*bm->stride] ;
+		switch (mode) {
+		case SLCD_PIXEL_ON:
+			row[lb]|=lmask ;
+			if (rb>lb) {
+				if (rb>lb+1) memset(&row[lb+1], 0xFF, rb-lb-1) ;
+				row[rb]|=rmask ;
+			}
+			break ;
+		case SLCD_PIXEL_OFF:
+			row[lb]&=~lmask ;
+			if (rb>lb) {
+				if (rb>lb+1) memset(&row[lb+1], 0x00, rb-lb-1) ;
+				row[rb]&=~rmask ;
+			}
+			break ;
+		case SLCD_PIXEL_INVERT:
+			row[lb]^=lmask ;
+			if (rb>lb) {
+				for (b=lb+1; b<rb; b++) row[b]^=0xFF ;
+				row[rb]^=rmask ;
+			}
+			break ;
+		}
+	}
+}
+
+/* Copies an area of packed pixels onto a surface, clipped to both */
+void lcd_bitmapcopy(lcd_bitmap *dst, int dx, int dy, const unsigned char *src, int sstride,
+	int swid, int shei, int sx, int sy, int w, int h)
+{
+	unsigned char *tmp=NULL ;
+	int r ;
+
+	/* Clip to the source, then to the destination */
+	if (sx<0) { w+=sx ; dx-=sx ; sx=0 ; }
+	if (sy<0) { h+=sy ; dy-=sy ; sy=0 ; }
+	if (sx+w>swid) w=swid-sx ;
+	if (sy+h>shei) h=shei-sy ;
+	if (dx<0) { w+=dx ; sx-=dx ; dx=0 ; }
+	if (dy<0) { h+=dy ; sy-=dy ; dy=0 ; }
+	if (dx+w>dst->width) w=dst->width-dx ;
+	if (dy+h>dst->height) h=dst->height-dy ;
+	if (w<=0 || h<=0) return ;
+
+	if (src==dst->pixels) {
+		/* Copying within a surface, so go via a row buffer, in */
+		/* an order that does not overwrite rows still to be read */
+		tmp=lcd_bitmapreserve(dst, sstride) ;
+		if (tmp==NULL) return ;
+		for (r=(dy>sy)?h-1:0; r>=0 && r<h; r+=(dy>sy)?-1:1) {
+			memcpy(tmp, &src[(sy+r)*sstride], sstride) ;
+			lcd_bitmapcopyrow(&dst->pixels[(dy+r)*dst->stride], dx, tmp, sx, w) ;
+		}
+	} else {
+		for (r=0; r<h; r++) {
+			lcd_bitmapcopyrow(&dst->pixels[(dy+r)*dst->stride], dx, &src[(sy+r)*sstride], sx, w) ;
+		}
+	}
+	lcd_bitmapdirty(dst, dx, dy, w, h) ;
+}
+
+/* Copies w bits from bit sx of src to bit dx of dst, up to a byte at a time */
+void lcd_bitmapcopyrow(unsigned char *dst, int dx, const unsigned char *src, int sx, int w)
+{
+	unsigned int v, m ;
+	int n ;
+
+	while (w>0) {
+		/* Take as many bits as fit in the current destination byte */
+		n=8-dx%8 ;
+		if (n>w) n=w ;
+		v=src[sx/8]<<8 ;
+		if (sx%8+n>8) v|=src[sx/8+1] ;
+		v=((v<<(sx%8))>>8)&0xFF ;
+
+		m=((0xFF<<(8-n))&0xFF)>>(dx%8) ;
+		dst[dx/8]=(dst[dx/8]&~m)|((v>>(dx%8))&m) ;
+		dx+=n ;
+		sx+=n ;
+		w-=n ;
+	}
+}
+
+/* Changes one pixel, ignoring any outside the surface */
+void lcd_bitmapsetpixel(lcd_bitmap *bm, int x, int y, enum slcd_e_pixel mode)
+{
+	unsigned char *p, m ;
+
+	if (x<0 || y<0 || x>=bm->width || y>=bm->height) return ;
+	p=&bm->pixels[y*bm->stride+x/8] ;
+	m=0x80>>(x%8) ;
+	switch (mode) {
+	case SLCD_PIXEL_ON: *p|=m ; break ;
+	case SLCD_PIXEL_OFF: *p&=~m ; break ;
+	case SLCD_PIXEL_INVERT: *p^=m ; break ;
+	}
+}
+
+/* Returns the surface's scratch buffer, grown to at least size bytes */
+unsigned char *lcd_bitmapreserve(lcd_bitmap *bm, int size)
+{
+	unsigned char *p ;
+
+	if (size<=bm->packsize) return bm->packbuf ;
+	p=realloc(bm->packbuf, size) ;
+	if (p==NULL) {
+		logf(LG_FTL, "memory allocation failure") ;
+		return NULL ;
+	}
+	bm->packbuf=p ;
+	bm->packsize=size ;
+	return p ;
+}
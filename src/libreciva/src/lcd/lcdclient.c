@@ -0,0 +1,149 @@
+/*
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github
+ *
+ * This file is part of the sharpfin project
+ * LCD compositor client
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * LCD Compositor Client Functions
+ *
+ * Each call is a single datagram to lcdd, so using the display
+ * costs a client no LCD initialisation and no driver calls.
+ */
+#include "lcdclient.h"
+#include "lcd.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static int lcd_clientsend(int fd, struct lcdd_msg *msg) ;
+
+/**
+ * lcd_clientopen
+ *
+ * Connects to the lcdd daemon.  Returns a socket to pass to
+ * the other lcd_client functions, or -1 if lcdd is not running.
+ **/
+int lcd_clientopen()
+{
+	struct sockaddr_un addr ;
+	char *path ;
+	int fd ;
+
+	path=getenv("LCDD_SOCKET") ;
+	if (path==NULL) path=LCDD_SOCKET ;
+	if (strlen(path)>=sizeof(addr.sun_path)) {
+		logf(LG_ERR, "socket path too long: %s", path) ;
+		return -1 ;
+	}
+
+	fd=socket(AF_UNIX, SOCK_DGRAM, 0) ;
+	if (fd<0) {
+		logf(LG_ERR, "unable to create socket") ;
+		return -1 ;
+	}
+	memset(&addr, 0, sizeof(addr)) ;
+	addr.sun_family=AF_UNIX ;
+	strcpy(addr.sun_path, path) ;
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))!=0) {
+		logf(LG_DBG, "lcdd is not running on %s", path) ;
+		close(fd) ;
+		return -1 ;
+	}
+	return fd ;
+}
+
+/**
+ * lcd_clientset
+ * @fd: socket from lcd_clientopen()
+ * @layer: layer identifier
+ * @priority: layer priority, higher is on top
+ * @timeout: milliseconds until the layer is removed, or 0
+ * @rows: text for each row, NULL to let lower layers show through
+ * @nrows: number of entries in rows, up to LCDD_MAXROWS
+ *
+ * Creates or replaces a layer.  Rows longer than LCDD_ROWLEN-1
+ * bytes are truncated.  Returns true on success.
+ **/
+int lcd_clientset(int fd, int layer, int priority, int timeout, char **rows, int nrows)
+{
+	struct lcdd_msg msg ;
+	int r ;
+
+	memset(&msg, 0, sizeof(msg)) ;
+	msg.cmd=LCDD_SET ;
+	msg.layer=layer ;
+	msg.priority=priority ;
+	msg.timeout=timeout ;
+	for (r=0; r<nrows && r<LCDD_MAXROWS; r++) {
+		if (rows[r]==NULL) continue ;
+		strncpy(msg.rows[r], rows[r], LCDD_ROWLEN-1) ;
+		msg.mask|=1<<r ;
+	}
+	return lcd_clientsend(fd, &msg) ;
+}
+
+/**
+ * lcd_clientclear
+ * @fd: socket from lcd_clientopen()
+ * @layer: layer identifier
+ *
+ * Removes a layer.  Returns true on success.
+ **/
+int lcd_clientclear(int fd, int layer)
+{
+	struct lcdd_msg msg ;
+
+	memset(&msg, 0, sizeof(msg)) ;
+	msg.cmd=LCDD_CLEAR ;
+	msg.layer=layer ;
+	return lcd_clientsend(fd, &msg) ;
+}
+
+/**
+ * lcd_clientclose
+ * @fd: socket from lcd_clientopen()
+ *
+ * Disconnects from lcdd.  The client's layers stay until they
+ * time out or are cleared.
+ **/
+void lcd_clientclose(int fd)
+{
+	if (fd>=0) close(fd) ;
+}
+
+/*
+ * Local support functions
+ */
+
+/* Sends one message, returns true on success */
+int lcd_clientsend(int fd, struct lcdd_msg *msg)
+{
+	msg->magic=LCDD_MAGIC ;
+	if (send(fd, msg, sizeof(struct lcdd_msg), 0)!=sizeof(struct lcdd_msg)) {
+		logf(LG_ERR, "unable to send to lcdd") ;
+		return SLCD_FALSE ;
+	}
+	return SLCD_TRUE ;
+}
@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <regex.h>
 #include "scr_devel.h"
+#include "lcdhw.h"
 #include "log.h"
 
 static char *levelstr[16] = { "ftl", "err", "wrn", "inf", "dbg" };
@@ -74,6 +75,14 @@ void log_init(char *name, enum log_to to, enum log_level level, int color) {
 	
 }
 
+/*
+ * The simulator always logs synchronously (ncurses is not thread
+ * safe, and is shared with the display under lcd_lock()), so
+ * LOG_ASYNC is ignored and there is nothing to flush.
+ */
+void log_flush(void) {
+}
+
 void log_entry(enum log_level level, const char *func, char *fmt, ...) {
 	va_list va;
 	char buf[512] = "";
@@ -103,34 +112,46 @@ void log_entry(enum log_level level, const char *func, char *fmt, ...) {
 	}
 
 	if (logw!=NULL) {
+		lcd_lock() ;
 		wprintw(logw, buf) ;
 		wprintw(logw, "\n") ;
 		wrefresh(logw) ;
+		lcd_unlock() ;
 	}
 	if(level == LG_FTL) exit(1);
 }
 
 void log_hexdump(char *txt, unsigned char *data, int len) {
-	int i,j;
+	static const char hex[] = "0123456789ABCDEF";
+	char line[80];
+	int i,j,n;
 	if(len == 0) return;
+
 	fprintf(stderr, "+-------| %s len=%d |-------\n", txt, len);
 	for(i=0; i<len; i+=16) {
-		fprintf(stderr, "| %04X  ", i);
+		/* Build the whole line, then write it in one go */
+		n = snprintf(line, sizeof(line), "| %04X  ", i);
 		for(j=i; (j<i+16);  j++) {
 			if(j<len) {
-				fprintf(stderr, "%02X ", (unsigned char)*(data+j));
+				line[n++] = hex[data[j] >> 4];
+				line[n++] = hex[data[j] & 0x0f];
+				line[n++] = ' ';
 			} else {
-				fprintf(stderr, "   ");
+				line[n++] = ' ';
+				line[n++] = ' ';
+				line[n++] = ' ';
 			}
 		}
-		fprintf(stderr, "  ");
+		line[n++] = ' ';
+		line[n++] = ' ';
 		for(j=i; (j<i+16) && (j<len);  j++) {
-			if((*(data+j) >= 32) && (*(data+j)<=127)) {
-				fprintf(stderr, "%c", *(data+j));
+			if((data[j] >= 32) && (data[j]<=127)) {
+				line[n++] = data[j];
 			} else {
-				fprintf(stderr, ".");
+				line[n++] = '.';
 			}
 		}
-		fprintf(stderr, "\n");
+		line[n++] = '\n';
+		fwrite(line, 1, n, stderr);
 	}
 }
@@ -21,14 +21,44 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
 #include <syslog.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
 #include <regex.h>
 #include "log.h"
 
+/*
+ * Async ring: a logging thread claims a slot by advancing ring_head
+ * with a compare-and-swap, formats its line straight into it, and
+ * publishes it by setting the slot's seq.  The flusher thread writes
+ * published slots out in order and advances ring_tail.  Nobody takes
+ * a lock, so any number of threads may log, and a full ring drops the
+ * line and counts it instead of blocking.
+ *
+ * The flusher sleeps on ring_wake once it has caught up.  A thread
+ * posts it only when the slot it publishes is the one the flusher
+ * stopped at, so a busy ring costs no wakeups at all.
+ *
+ * The settings are written by log_init() only, which should be called
+ * before any threads are started.
+ */
+#define LOG_LINE_MAX 512
+#define LOG_RING_SLOTS 32	/* must be a power of two */
+
+struct log_record {
+	volatile unsigned int seq;	/* Position + 1 once published */
+	int level;
+	int len;
+	char buf[LOG_LINE_MAX];
+};
+
 static char *levelstr[16] = { "ftl", "err", "wrn", "inf", "dbg" };
 static char *ansistr[16] = { 	
 	"\x1b[7m",
@@ -43,6 +73,20 @@ static int log_to = 0;
 static int log_ansicolors = 0;
 static char *progname;
 
+static struct log_record ring[LOG_RING_SLOTS];
+static volatile unsigned int ring_head = 0;	/* claimed by the producers */
+static volatile unsigned int ring_tail = 0;	/* written by the flusher */
+static volatile unsigned int ring_dropped = 0;	/* counted by the producers */
+static unsigned int ring_reported = 0;		/* written by the flusher */
+static pthread_mutex_t ring_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static sem_t ring_wake;
+static pthread_t ring_flusher;
+static int ring_running = 0;
+
+static void log_write(int level, char *buf, int len);
+static int log_ring_drain(void);
+static void *log_ring_flusher(void *arg);
+
 /*
  * ident
  */
@@ -59,12 +103,38 @@ void log_init(char *name, enum log_to to, enum log_level level, int color) {
 	if(log_to & LOG_TO_SYSLOG) {
 		openlog(progname, 0, LOG_DAEMON);
 	}
+
+	if((log_to & LOG_ASYNC) && !ring_running) {
+		if(sem_init(&ring_wake, 0, 0) != 0 ||
+				pthread_create(&ring_flusher, NULL, log_ring_flusher, NULL) != 0) {
+			/* No flusher, so fall back to writing on the caller's thread */
+			log_to &= ~LOG_ASYNC;
+			return;
+		}
+		pthread_detach(ring_flusher);
+		ring_running = 1;
+		atexit(log_flush);
+	}
 	
 }
 
+/*
+ * Write out everything that is queued in the ring.  Safe to call
+ * from any thread, and called automatically at exit.
+ */
+void log_flush(void) {
+	if(!ring_running) return;
+	pthread_mutex_lock(&ring_drain_lock);
+	log_ring_drain();
+	pthread_mutex_unlock(&ring_drain_lock);
+}
+
 void log_entry(enum log_level level, const char *func, char *fmt, ...) {
 	va_list va;
-	char buf[512] = "";
+	char stackbuf[LOG_LINE_MAX];
+	char *buf = stackbuf;
+	unsigned int head = 0;
+	int queued = 0;
 	int l = 0;
 	char *p=NULL;
 
@@ -73,50 +143,152 @@ void log_entry(enum log_level level, const char *func, char *fmt, ...) {
 	 */
 	
 	if(level > loglevel) return;
+
+	/*
+	 * Format straight into the next free ring slot when running async,
+	 * fatal lines are always written synchronously as we exit below
+	 */
+	if((log_to & LOG_ASYNC) && level != LG_FTL) {
+		do {
+			head = ring_head;
+			if(head - ring_tail >= LOG_RING_SLOTS) {
+				__sync_fetch_and_add(&ring_dropped, 1);
+				return;
+			}
+		} while(!__sync_bool_compare_and_swap(&ring_head, head, head + 1));
+		buf = ring[head & (LOG_RING_SLOTS-1)].buf;
+		queued = 1;
+	}
 		
-	l += snprintf(buf+l, sizeof(buf)-l, "[%s] %-10.10s ", levelstr[level], func);
+	l += snprintf(buf+l, LOG_LINE_MAX-l, "[%s] %-10.10s ", levelstr[level], func);
 	va_start(va, fmt);
-	l += vsnprintf(buf+l, sizeof(buf)-l, fmt, va);
+	l += vsnprintf(buf+l, LOG_LINE_MAX-l, fmt, va);
 	va_end(va);
+	if(l >= LOG_LINE_MAX) l = LOG_LINE_MAX-1;
 
-	while( (p = strchr(buf, '\n')) ) *p=' ';
-	while( (p = strchr(buf, '\r')) ) *p=' ';
+	for(p=buf; *p; p++) if(*p == '\n' || *p == '\r') *p=' ';
 
-	if(log_to & LOG_TO_SYSLOG) {
-		syslog(LOG_DAEMON | LOG_INFO, "%s", buf);
+	if(queued) {
+		ring[head & (LOG_RING_SLOTS-1)].level = level;
+		ring[head & (LOG_RING_SLOTS-1)].len = l;
+		/* Make the record visible before the flusher sees it published */
+		__sync_synchronize();
+		ring[head & (LOG_RING_SLOTS-1)].seq = head + 1;
+		/* Pairs with the barrier after ring_tail is advanced in log_ring_drain() */
+		__sync_synchronize();
+		if(ring_tail == head) sem_post(&ring_wake);
+		return;
 	}
 
-	 
-	if((log_to & LOG_TO_STDERR) || (level == LG_FTL)) {
-		if(log_ansicolors) fprintf(stderr, "%s", ansistr[level]);
-		fprintf(stderr, "%s\n", buf);
-		if(log_ansicolors) fprintf(stderr, "\x1b[0m");
-	}
+	if(level == LG_FTL) log_flush();
+	log_write(level, buf, l);
 	if(level == LG_FTL) exit(1);
 }
 
 void log_hexdump(char *txt, unsigned char *data, int len) {
-	int i,j;
+	static const char hex[] = "0123456789ABCDEF";
+	char line[80];
+	int i,j,n;
 	if(len == 0) return;
 
 	fprintf(stderr, "+-------| %s len=%d |-------\n", txt, len);
 	for(i=0; i<len; i+=16) {
-		fprintf(stderr, "| %04X  ", i);
+		/* Build the whole line, then write it in one go */
+		n = snprintf(line, sizeof(line), "| %04X  ", i);
 		for(j=i; (j<i+16);  j++) {
 			if(j<len) {
-				fprintf(stderr, "%02X ", (unsigned char)*(data+j));
+				line[n++] = hex[data[j] >> 4];
+				line[n++] = hex[data[j] & 0x0f];
+				line[n++] = ' ';
 			} else {
-				fprintf(stderr, "   ");
+				line[n++] = ' ';
+				line[n++] = ' ';
+				line[n++] = ' ';
 			}
 		}
-		fprintf(stderr, "  ");
+		line[n++] = ' ';
+		line[n++] = ' ';
 		for(j=i; (j<i+16) && (j<len);  j++) {
-			if((*(data+j) >= 32) && (*(data+j)<=127)) {
-				fprintf(stderr, "%c", *(data+j));
+			if((data[j] >= 32) && (data[j]<=127)) {
+				line[n++] = data[j];
 			} else {
-				fprintf(stderr, ".");
+				line[n++] = '.';
 			}
 		}
-		fprintf(stderr, "\n");
+		line[n++] = '\n';
+		fwrite(line, 1, n, stderr);
+	}
+}
+
+/*
+ * Local support functions
+ */
+
+/* Send one formatted line to syslog and/or stderr */
+static void log_write(int level, char *buf, int len) {
+	char out[LOG_LINE_MAX+16];
+	int n;
+
+	if(log_to & LOG_TO_SYSLOG) {
+		syslog(LOG_DAEMON | LOG_INFO, "%s", buf);
+	}
+
+	if((log_to & LOG_TO_STDERR) || (level == LG_FTL)) {
+		n = 0;
+		if(log_ansicolors) n += snprintf(out, sizeof(out), "%s", ansistr[level]);
+		memcpy(out+n, buf, len);
+		n += len;
+		if(log_ansicolors) {
+			memcpy(out+n, "\x1b[0m", 4);
+			n += 4;
+		}
+		out[n++] = '\n';
+		fwrite(out, 1, n, stderr);
+	}
+}
+
+/* Write out all published records, caller holds ring_drain_lock */
+static int log_ring_drain(void) {
+	struct log_record *r;
+	unsigned int tail = ring_tail;
+	unsigned int dropped;
+	char buf[64];
+	int count = 0;
+
+	while(tail != ring_head) {
+		/* Stop at a slot that is claimed but still being written */
+		r = &ring[tail & (LOG_RING_SLOTS-1)];
+		if(r->seq != tail + 1) break;
+		/* Don't read the record before we have seen it published */
+		__sync_synchronize();
+		log_write(r->level, r->buf, r->len);
+		__sync_synchronize();
+		ring_tail = ++tail;
+		/* Either we see the next slot published, or its writer sees ring_tail */
+		__sync_synchronize();
+		count++;
+	}
+
+	dropped = ring_dropped;
+	if(dropped != ring_reported) {
+		snprintf(buf, sizeof(buf), "[%s] %-10.10s %u lines dropped",
+			levelstr[LG_WRN], "log", dropped - ring_reported);
+		log_write(LG_WRN, buf, strlen(buf));
+		ring_reported = dropped;
+	}
+	return count;
+}
+
+/* Background thread writing out the ring */
+static void *log_ring_flusher(void *arg) {
+	int n;
+	while(1) {
+		pthread_mutex_lock(&ring_drain_lock);
+		n = log_ring_drain();
+		pthread_mutex_unlock(&ring_drain_lock);
+		if(n == 0) {
+			while(sem_wait(&ring_wake) != 0 && errno == EINTR);
+		}
 	}
+	return NULL;
 }
@@ -0,0 +1,718 @@
+/*
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github
+ *
+ * This file is part of the sharpfin project
+ * Station directory index
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Station Directory Index
+ *
+ * File layout: a header, then the sections it points to, each starting
+ * on a 4 byte boundary.  All numbers are 32 bit in the byte order of the
+ * radio, and strings are given as offsets in the string table.
+ *
+ *   strings        sorted, unique, NUL terminated strings
+ *   stations       struct sdb_station, sorted by name
+ *   names          name offset of each station, for lcd_vmenucreatetable()
+ *   hash           station number + 1 (0 for free), by hash of the ID
+ *   prefix         first station for each first byte of the name, + count
+ *   genres         struct sdb_genre, sorted by name
+ *   postings       station numbers of each genre
+ *   stationgenres  genre numbers of each station
+ */
+#include "stationdb.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*************************
+ * Local Variables, defs and types
+ *************************/
+
+#define SDB_MAGIC "SFDB"
+#define SDB_VERSION 1
+#define SDB_FOLD(c) (((c)>='A' && (c)<='Z') ? (c)-'A'+'a' : (c))
+
+struct sdb_header {
+	char magic[4] ;
+	uint32_t version ;
+	uint32_t size ;			/* Of the whole file */
+	uint32_t nstations ;
+	uint32_t ngenres ;
+	uint32_t hashsize ;		/* Power of two */
+	uint32_t strings ;
+	uint32_t stringslen ;
+	uint32_t stations ;
+	uint32_t names ;
+	uint32_t hash ;
+	uint32_t prefix ;
+	uint32_t genres ;
+	uint32_t postings ;
+	uint32_t npostings ;
+	uint32_t stationgenres ;
+} ;
+
+struct sdb_station {
+	uint32_t id ;
+	uint32_t name ;
+	uint32_t url ;
+	uint32_t genres ;		/* First entry in stationgenres */
+	uint32_t ngenres ;
+} ;
+
+struct sdb_genre {
+	uint32_t name ;
+	uint32_t stations ;		/* First entry in postings */
+	uint32_t nstations ;
+} ;
+
+struct stationdb {
+	void *map ;
+	size_t size ;
+	const struct sdb_header *hdr ;
+	const char *strings ;
+	const struct sdb_station *stations ;
+	const uint32_t *names ;
+	const uint32_t *hash ;
+	const uint32_t *prefix ;
+	const struct sdb_genre *genres ;
+	const uint32_t *postings ;
+	const uint32_t *stationgenres ;
+} ;
+
+/* A station while building */
+struct sdb_entry {
+	char *id ;
+	char *name ;
+	char *url ;
+	char **genres ;
+	int ngenres ;
+	int line ;
+	int dup ;
+	uint32_t *genrenums ;
+} ;
+
+static uint32_t stationdb_hash(const char *s) ;
+static int stationdb_foldcmp(const char *a, const char *b, int n) ;
+static const char *stationdb_str(stationdb *db, uint32_t off) ;
+static int stationdb_section(stationdb *db, uint32_t off, uint32_t count, uint32_t elemsize) ;
+
+/*************************
+ * Index Building Functions
+ *************************/
+
+/* Split off the next field, returns the rest of the line or NULL */
+static char *stationdb_field(char *s, int sep)
+{
+	char *e=strchr(s, sep) ;
+	if (e==NULL) return NULL ;
+	*e='\0' ;
+	return e+1 ;
+}
+
+static int stationdb_cmpid(const void *a, const void *b)
+{
+	const struct sdb_entry *x=*(struct sdb_entry * const *)a, *y=*(struct sdb_entry * const *)b ;
+	int r=strcmp(x->id, y->id) ;
+	return r ? r : x->line-y->line ;
+}
+
+static int stationdb_cmpname(const void *a, const void *b)
+{
+	const struct sdb_entry *x=a, *y=b ;
+	int r=stationdb_foldcmp(x->name, y->name, -1) ;
+	if (r==0) r=strcmp(x->name, y->name) ;
+	if (r==0) r=strcmp(x->id, y->id) ;
+	return r ;
+}
+
+static int stationdb_cmpstr(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b) ;
+}
+
+static int stationdb_cmpu32(const void *a, const void *b)
+{
+	uint32_t x=*(const uint32_t *)a, y=*(const uint32_t *)b ;
+	return (x>y)-(x<y) ;
+}
+
+/* Offset of a string in the sorted, unique string table */
+static uint32_t stationdb_stroff(char **strs, uint32_t *offs, int n, const char *s)
+{
+	char **p=bsearch(&s, strs, n, sizeof(char *), stationdb_cmpstr) ;
+	return offs[p-strs] ;
+}
+
+/* Index of a genre in the sorted, unique genre list */
+static uint32_t stationdb_genreidx(char **genres, int n, const char *s)
+{
+	char **p=bsearch(&s, genres, n, sizeof(char *), stationdb_cmpstr) ;
+	return p-genres ;
+}
+
+/* realloc() for the build, which cannot carry on without the memory */
+static void *stationdb_alloc(void *p, size_t size)
+{
+	p=realloc(p, size) ;
+	if (p==NULL) logf(LG_FTL, "memory allocation failure") ;
+	return p ;
+}
+
+/* As stationdb_alloc(), for a new zeroed array of n elements */
+static void *stationdb_zalloc(size_t n, size_t size)
+{
+	void *p=calloc(n, size) ;
+	if (p==NULL) logf(LG_FTL, "memory allocation failure") ;
+	return p ;
+}
+
+/* Write a section, padded to 4 bytes, only the padding if data is NULL */
+static int stationdb_write(FILE *f, const void *data, size_t len)
+{
+	static const char pad[4]={0, 0, 0, 0} ;
+	if (data!=NULL && len>0 && fwrite(data, len, 1, f)!=1) return -1 ;
+	if ((len&3)!=0 && fwrite(pad, 4-(len&3), 1, f)!=1) return -1 ;
+	return 0 ;
+}
+
+/**
+ * stationdb_build
+ **/
+int stationdb_build(FILE *in, const char *fname)
+{
+	struct sdb_entry *e=NULL, **byid ;
+	struct sdb_header h ;
+	struct sdb_station *st ;
+	struct sdb_genre *gr ;
+	uint32_t *names, *hash, *prefix, *postings, *stgenres, *stroffs ;
+	char **strs, **genres ;
+	char *buf=NULL, *line, *p, *g, *tmp ;
+	size_t bufsize=0 ;
+	ssize_t len ;
+	int ne=0, maxe=0, nstr, ngen, npost, i, j, k, c, lineno=0 ;
+	uint32_t slot, stringslen ;
+	FILE *f ;
+
+	/* Read the station list */
+	while ((len=getline(&buf, &bufsize, in))>0) {
+		lineno++ ;
+		while (len>0 && (buf[len-1]=='\n' || buf[len-1]=='\r')) buf[--len]='\0' ;
+		if (len==0 || buf[0]=='#') continue ;
+		if (ne==maxe) {
+			maxe=maxe ? maxe*2 : 256 ;
+			e=stationdb_alloc(e, maxe*sizeof(*e)) ;
+		}
+		line=stationdb_alloc(NULL, len+1) ;
+		memcpy(line, buf, len+1) ;
+		memset(&e[ne], 0, sizeof(*e)) ;
+		e[ne].id=line ;
+		e[ne].line=lineno ;
+		e[ne].name=stationdb_field(line, '|') ;
+		g=(e[ne].name==NULL) ? NULL : stationdb_field(e[ne].name, '|') ;
+		if (e[ne].name==NULL || e[ne].name[0]=='\0') {
+			logf(LG_WRN, "line %d: no station name, skipped", lineno) ;
+			free(line) ;
+			continue ;
+		}
+		e[ne].url="" ;
+		if (g!=NULL) {
+			p=stationdb_field(g, '|') ;
+			if (p!=NULL) e[ne].url=p ;
+			/* Genres, trimmed, empty ones dropped */
+			e[ne].genres=stationdb_alloc(NULL, (strlen(g)/2+1)*sizeof(char *)) ;
+			while (g!=NULL) {
+				p=stationdb_field(g, ',') ;
+				while (*g==' ') g++ ;
+				for (k=strlen(g); k>0 && g[k-1]==' '; k--) g[k-1]='\0' ;
+				if (*g!='\0') e[ne].genres[e[ne].ngenres++]=g ;
+				g=p ;
+			}
+		}
+		ne++ ;
+	}
+	free(buf) ;
+
+	/* Drop stations with an ID that was seen before */
+	byid=stationdb_alloc(NULL, (ne+1)*sizeof(*byid)) ;
+	for (i=0; i<ne; i++) byid[i]=&e[i] ;
+	qsort(byid, ne, sizeof(*byid), stationdb_cmpid) ;
+	for (i=1; i<ne; i++) {
+		if (strcmp(byid[i]->id, byid[i-1]->id)==0) {
+			logf(LG_WRN, "line %d: station %s seen before, skipped", byid[i]->line, byid[i]->id) ;
+			byid[i]->dup=1 ;
+		}
+	}
+	free(byid) ;
+	for (i=0, j=0; i<ne; i++) {
+		if (e[i].dup) {
+			free(e[i].id) ;
+			free(e[i].genres) ;
+		} else {
+			e[j++]=e[i] ;
+		}
+	}
+	ne=j ;
+	qsort(e, ne, sizeof(*e), stationdb_cmpname) ;
+
+	/* Genre list */
+	for (i=0, ngen=0; i<ne; i++) ngen+=e[i].ngenres ;
+	genres=stationdb_alloc(NULL, (ngen+1)*sizeof(char *)) ;
+	for (i=0, ngen=0; i<ne; i++) {
+		for (j=0; j<e[i].ngenres; j++) genres[ngen++]=e[i].genres[j] ;
+	}
+	qsort(genres, ngen, sizeof(char *), stationdb_cmpstr) ;
+	for (i=0, j=0; i<ngen; i++) {
+		if (j==0 || strcmp(genres[i], genres[j-1])!=0) genres[j++]=genres[i] ;
+	}
+	ngen=j ;
+
+	/* String table */
+	strs=stationdb_alloc(NULL, (ne*3+ngen+1)*sizeof(char *)) ;
+	for (i=0, nstr=0; i<ne; i++) {
+		strs[nstr++]=e[i].id ;
+		strs[nstr++]=e[i].name ;
+		strs[nstr++]=e[i].url ;
+	}
+	for (i=0; i<ngen; i++) strs[nstr++]=genres[i] ;
+	/* Always at least the empty string, so an empty list still gives a valid table */
+	strs[nstr++]="" ;
+	qsort(strs, nstr, sizeof(char *), stationdb_cmpstr) ;
+	stroffs=stationdb_alloc(NULL, (nstr+1)*sizeof(uint32_t)) ;
+	stringslen=0 ;
+	for (i=0, j=0; i<nstr; i++) {
+		if (j>0 && strcmp(strs[i], strs[j-1])==0) continue ;
+		strs[j]=strs[i] ;
+		stroffs[j++]=stringslen ;
+		stringslen+=strlen(strs[i])+1 ;
+	}
+	nstr=j ;
+
+	/* Stations, their genres and the genre postings */
+	st=stationdb_zalloc(ne+1, sizeof(*st)) ;
+	names=stationdb_alloc(NULL, (ne+1)*sizeof(uint32_t)) ;
+	gr=stationdb_zalloc(ngen+1, sizeof(*gr)) ;
+	for (i=0, npost=0; i<ne; i++) {
+		e[i].genrenums=stationdb_alloc(NULL, (e[i].ngenres+1)*sizeof(uint32_t)) ;
+		for (j=0; j<e[i].ngenres; j++) e[i].genrenums[j]=stationdb_genreidx(genres, ngen, e[i].genres[j]) ;
+		qsort(e[i].genrenums, e[i].ngenres, sizeof(uint32_t), stationdb_cmpu32) ;
+		for (j=0, k=0; j<e[i].ngenres; j++) {
+			if (k==0 || e[i].genrenums[j]!=e[i].genrenums[k-1]) e[i].genrenums[k++]=e[i].genrenums[j] ;
+		}
+		e[i].ngenres=k ;
+		for (j=0; j<k; j++) gr[e[i].genrenums[j]].nstations++ ;
+		npost+=k ;
+	}
+	for (i=0, k=0; i<ngen; i++) {
+		gr[i].name=stationdb_stroff(strs, stroffs, nstr, genres[i]) ;
+		gr[i].stations=k ;
+		k+=gr[i].nstations ;
+		gr[i].nstations=0 ;
+	}
+	postings=stationdb_alloc(NULL, (npost+1)*sizeof(uint32_t)) ;
+	stgenres=stationdb_alloc(NULL, (npost+1)*sizeof(uint32_t)) ;
+	for (i=0, k=0; i<ne; i++) {
+		st[i].id=stationdb_stroff(strs, stroffs, nstr, e[i].id) ;
+		st[i].name=stationdb_stroff(strs, stroffs, nstr, e[i].name) ;
+		st[i].url=stationdb_stroff(strs, stroffs, nstr, e[i].url) ;
+		st[i].genres=k ;
+		st[i].ngenres=e[i].ngenres ;
+		names[i]=st[i].name ;
+		for (j=0; j<e[i].ngenres; j++) {
+			stgenres[k++]=e[i].genrenums[j] ;
+			postings[gr[e[i].genrenums[j]].stations+gr[e[i].genrenums[j]].nstations++]=i ;
+		}
+	}
+
+	/* ID hash, at most half full */
+	memset(&h, 0, sizeof(h)) ;
+	for (h.hashsize=16; h.hashsize<(uint32_t)ne*2; h.hashsize*=2) ;
+	hash=stationdb_zalloc(h.hashsize, sizeof(uint32_t)) ;
+	for (i=0; i<ne; i++) {
+		for (slot=stationdb_hash(e[i].id); hash[slot&(h.hashsize-1)]!=0; slot++) ;
+		hash[slot&(h.hashsize-1)]=i+1 ;
+	}
+
+	/* First station for each first byte of the name */
+	prefix=stationdb_alloc(NULL, 257*sizeof(uint32_t)) ;
+	for (c=0, i=0; c<256; c++) {
+		while (i<ne && (unsigned char)SDB_FOLD(e[i].name[0])<c) i++ ;
+		prefix[c]=i ;
+	}
+	prefix[256]=ne ;
+
+	/* Lay out and write the file */
+	memcpy(h.magic, SDB_MAGIC, 4) ;
+	h.version=SDB_VERSION ;
+	h.nstations=ne ;
+	h.ngenres=ngen ;
+	h.strings=sizeof(h) ;
+	h.stringslen=stringslen ;
+	h.stations=h.strings+((stringslen+3)&~3) ;
+	h.names=h.stations+ne*sizeof(*st) ;
+	h.hash=h.names+ne*sizeof(uint32_t) ;
+	h.prefix=h.hash+h.hashsize*sizeof(uint32_t) ;
+	h.genres=h.prefix+257*sizeof(uint32_t) ;
+	h.postings=h.genres+ngen*sizeof(*gr) ;
+	h.npostings=npost ;
+	h.stationgenres=h.postings+npost*sizeof(uint32_t) ;
+	h.size=h.stationgenres+npost*sizeof(uint32_t) ;
+
+	tmp=stationdb_alloc(NULL, strlen(fname)+5) ;
+	sprintf(tmp, "%s.new", fname) ;
+	f=fopen(tmp, "w") ;
+	k=(f==NULL) ? -1 : 0 ;
+	if (k==0) k=stationdb_write(f, &h, sizeof(h)) ;
+	for (i=0; k==0 && i<nstr; i++) {
+		if (fwrite(strs[i], strlen(strs[i])+1, 1, f)!=1) k=-1 ;
+	}
+	if (k==0) k=stationdb_write(f, NULL, stringslen) ;
+	if (k==0) k=stationdb_write(f, st, ne*sizeof(*st)) ;
+	if (k==0) k=stationdb_write(f, names, ne*sizeof(uint32_t)) ;
+	if (k==0) k=stationdb_write(f, hash, h.hashsize*sizeof(uint32_t)) ;
+	if (k==0) k=stationdb_write(f, prefix, 257*sizeof(uint32_t)) ;
+	if (k==0) k=stationdb_write(f, gr, ngen*sizeof(*gr)) ;
+	if (k==0) k=stationdb_write(f, postings, npost*sizeof(uint32_t)) ;
+	if (k==0) k=stationdb_write(f, stgenres, npost*sizeof(uint32_t)) ;
+	if (f!=NULL && fclose(f)!=0) k=-1 ;
+	if (k==0 && rename(tmp, fname)!=0) k=-1 ;
+	if (k!=0) {
+		logf(LG_ERR, "Unable to write %s", fname) ;
+		unlink(tmp) ;
+	}
+
+	for (i=0; i<ne; i++) {
+		free(e[i].id) ;
+		free(e[i].genres) ;
+		free(e[i].genrenums) ;
+	}
+	free(e) ;
+	free(tmp) ;
+	free(genres) ;
+	free(strs) ;
+	free(stroffs) ;
+	free(st) ;
+	free(names) ;
+	free(gr) ;
+	free(postings) ;
+	free(stgenres) ;
+	free(hash) ;
+	free(prefix) ;
+	return (k==0) ? ne : -1 ;
+}
+
+/*************************
+ * Index Reading Functions
+ *************************/
+
+/**
+ * stationdb_open
+ **/
+stationdb *stationdb_open(const char *fname)
+{
+	stationdb *db ;
+	const struct sdb_header *h ;
+	struct stat st ;
+	void *map ;
+	int fd ;
+
+	fd=open(fname, O_RDONLY) ;
+	if (fd<0) {
+		logf(LG_ERR, "Unable to open %s", fname) ;
+		return NULL ;
+	}
+	if (fstat(fd, &st)!=0 || st.st_size<(off_t)sizeof(*h)) {
+		logf(LG_ERR, "%s is not a station index", fname) ;
+		close(fd) ;
+		return NULL ;
+	}
+	map=mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0) ;
+	close(fd) ;
+	if (map==MAP_FAILED) {
+		logf(LG_ERR, "Unable to map %s", fname) ;
+		return NULL ;
+	}
+
+	db=calloc(1, sizeof(*db)) ;
+	if (db==NULL) {
+		logf(LG_FTL, "memory allocation failure") ;
+		munmap(map, st.st_size) ;
+		return NULL ;
+	}
+	db->map=map ;
+	db->size=st.st_size ;
+	db->hdr=h=map ;
+
+	/* Check that every section lies within the file, nothing else is read */
+	if (memcmp(h->magic, SDB_MAGIC, 4)!=0 || h->version!=SDB_VERSION || h->size!=db->size ||
+	    (h->hashsize&(h->hashsize-1))!=0 || h->hashsize==0 ||
+	    !stationdb_section(db, h->strings, h->stringslen, 1) || h->stringslen==0 ||
+	    !stationdb_section(db, h->stations, h->nstations, sizeof(struct sdb_station)) ||
+	    !stationdb_section(db, h->names, h->nstations, sizeof(uint32_t)) ||
+	    !stationdb_section(db, h->hash, h->hashsize, sizeof(uint32_t)) ||
+	    !stationdb_section(db, h->prefix, 257, sizeof(uint32_t)) ||
+	    !stationdb_section(db, h->genres, h->ngenres, sizeof(struct sdb_genre)) ||
+	    !stationdb_section(db, h->postings, h->npostings, sizeof(uint32_t)) ||
+	    !stationdb_section(db, h->stationgenres, h->npostings, sizeof(uint32_t))) {
+		logf(LG_ERR, "%s is not a valid station index", fname) ;
+		stationdb_close(db) ;
+		return NULL ;
+	}
+	db->strings=(const char *)map+h->strings ;
+	if (db->strings[h->stringslen-1]!='\0') {
+		logf(LG_ERR, "%s is not a valid station index", fname) ;
+		stationdb_close(db) ;
+		return NULL ;
+	}
+	db->stations=(const void *)((const char *)map+h->stations) ;
+	db->names=(const void *)((const char *)map+h->names) ;
+	db->hash=(const void *)((const char *)map+h->hash) ;
+	db->prefix=(const void *)((const char *)map+h->prefix) ;
+	db->genres=(const void *)((const char *)map+h->genres) ;
+	db->postings=(const void *)((const char *)map+h->postings) ;
+	db->stationgenres=(const void *)((const char *)map+h->stationgenres) ;
+	return db ;
+}
+
+/**
+ * stationdb_close
+ **/
+void stationdb_close(stationdb *db)
+{
+	if (db==NULL) return ;
+	munmap(db->map, db->size) ;
+	free(db) ;
+}
+
+/**
+ * stationdb_count
+ **/
+int stationdb_count(stationdb *db)
+{
+	return db->hdr->nstations ;
+}
+
+/**
+ * stationdb_id
+ **/
+const char *stationdb_id(stationdb *db, int station)
+{
+	if (station<0 || station>=(int)db->hdr->nstations) return NULL ;
+	return stationdb_str(db, db->stations[station].id) ;
+}
+
+/**
+ * stationdb_name
+ **/
+const char *stationdb_name(stationdb *db, int station)
+{
+	if (station<0 || station>=(int)db->hdr->nstations) return NULL ;
+	return stationdb_str(db, db->stations[station].name) ;
+}
+
+/**
+ * stationdb_url
+ **/
+const char *stationdb_url(stationdb *db, int station)
+{
+	if (station<0 || station>=(int)db->hdr->nstations) return NULL ;
+	return stationdb_str(db, db->stations[station].url) ;
+}
+
+/**
+ * stationdb_stationgenres
+ **/
+int stationdb_stationgenres(stationdb *db, int station, const unsigned int **genres)
+{
+	const struct sdb_station *s ;
+	if (station<0 || station>=(int)db->hdr->nstations) return 0 ;
+	s=&db->stations[station] ;
+	if (s->genres>db->hdr->npostings || s->ngenres>db->hdr->npostings-s->genres) return 0 ;
+	*genres=db->stationgenres+s->genres ;
+	return s->ngenres ;
+}
+
+/**
+ * stationdb_find
+ **/
+int stationdb_find(stationdb *db, const char *id)
+{
+	uint32_t mask=db->hdr->hashsize-1 ;
+	uint32_t slot, n, probes ;
+
+	slot=stationdb_hash(id) ;
+	for (probes=0; probes<=mask; probes++, slot++) {
+		n=db->hash[slot&mask] ;
+		if (n==0 || n>db->hdr->nstations) return -1 ;
+		if (strcmp(stationdb_str(db, db->stations[n-1].id), id)==0) return n-1 ;
+	}
+	return -1 ;
+}
+
+/**
+ * stationdb_prefix
+ **/
+int stationdb_prefix(stationdb *db, const char *prefix, int *first)
+{
+	int n=strlen(prefix) ;
+	int lo, hi, mid, end ;
+	unsigned char c ;
+
+	if (n==0) {
+		*first=0 ;
+		return db->hdr->nstations ;
+	}
+
+	/* The first byte narrows it down to one bucket */
+	c=SDB_FOLD((unsigned char)prefix[0]) ;
+	lo=db->prefix[c] ;
+	end=hi=db->prefix[c+1] ;
+	if (hi>(int)db->hdr->nstations || lo>hi) lo=hi=end=0 ;
+
+	/* First name that does not sort before the prefix */
+	while (lo<hi) {
+		mid=(lo+hi)/2 ;
+		if (stationdb_foldcmp(stationdb_str(db, db->stations[mid].name), prefix, n)<0) lo=mid+1 ;
+		else hi=mid ;
+	}
+	*first=lo ;
+
+	/* First name after the ones starting with the prefix */
+	hi=end ;
+	while (lo<hi) {
+		mid=(lo+hi)/2 ;
+		if (stationdb_foldcmp(stationdb_str(db, db->stations[mid].name), prefix, n)==0) lo=mid+1 ;
+		else hi=mid ;
+	}
+	return lo-*first ;
+}
+
+/**
+ * stationdb_genrecount
+ **/
+int stationdb_genrecount(stationdb *db)
+{
+	return db->hdr->ngenres ;
+}
+
+/**
+ * stationdb_genrename
+ **/
+const char *stationdb_genrename(stationdb *db, int genre)
+{
+	if (genre<0 || genre>=(int)db->hdr->ngenres) return NULL ;
+	return stationdb_str(db, db->genres[genre].name) ;
+}
+
+/**
+ * stationdb_findgenre
+ **/
+int stationdb_findgenre(stationdb *db, const char *name)
+{
+	int lo=0, hi=db->hdr->ngenres, mid, r ;
+
+	while (lo<hi) {
+		mid=(lo+hi)/2 ;
+		r=strcmp(stationdb_str(db, db->genres[mid].name), name) ;
+		if (r==0) return mid ;
+		if (r<0) lo=mid+1 ;
+		else hi=mid ;
+	}
+	return -1 ;
+}
+
+/**
+ * stationdb_genrestations
+ **/
+int stationdb_genrestations(stationdb *db, int genre, const unsigned int **stations)
+{
+	const struct sdb_genre *g ;
+	if (genre<0 || genre>=(int)db->hdr->ngenres) return 0 ;
+	g=&db->genres[genre] ;
+	if (g->stations>db->hdr->npostings || g->nstations>db->hdr->npostings-g->stations) return 0 ;
+	*stations=db->postings+g->stations ;
+	return g->nstations ;
+}
+
+/**
+ * stationdb_strings
+ **/
+const char *stationdb_strings(stationdb *db)
+{
+	return db->strings ;
+}
+
+/**
+ * stationdb_nameoffsets
+ **/
+const int *stationdb_nameoffsets(stationdb *db)
+{
+	return (const int *)db->names ;
+}
+
+/*************************
+ * Local support functions
+ *************************/
+
+/* FNV-1a */
+static uint32_t stationdb_hash(const char *s)
+{
+	uint32_t h=2166136261u ;
+	while (*s) h=(h^(unsigned char)*s++)*16777619u ;
+	return h ;
+}
+
+/* strcmp ignoring ASCII case, on at most n bytes if n>=0 */
+static int stationdb_foldcmp(const char *a, const char *b, int n)
+{
+	int ca, cb ;
+	for (; n!=0; n--) {
+		ca=SDB_FOLD((unsigned char)*a) ;
+		cb=SDB_FOLD((unsigned char)*b) ;
+		if (ca!=cb || ca=='\0') return ca-cb ;
+		a++ ;
+		b++ ;
+	}
+	return 0 ;
+}
+
+/* String at an offset, "" for an offset outside the table */
+static const char *stationdb_str(stationdb *db, uint32_t off)
+{
+	if (off>=db->hdr->stringslen) return "" ;
+	return db->strings+off ;
+}
+
+/*
+ * True if a section of count elements of elemsize bytes at off lies
+ * within the file.  The count is checked by division, as a corrupt
+ * one could wrap count*elemsize round to something small.
+ */
+static int stationdb_section(stationdb *db, uint32_t off, uint32_t count, uint32_t elemsize)
+{
+	return ((off&3)==0 && off>=sizeof(struct sdb_header) && off<=db->size &&
+		count<=(db->size-off)/elemsize) ;
+}
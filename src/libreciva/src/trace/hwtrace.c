@@ -0,0 +1,269 @@
+/*
+ * Sharpfin project
+ * Copyright (C) by Steve Clarke and Ico Doornekamp
+ * 2011-11-30 Philipp Schmidt
+ *   Added to github
+ *
+ * This file is part of the sharpfin project
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this source files. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "hwtrace.h"
+
+/*
+ * The ring keeps the last HWTRACE_RING_SLOTS operations, older ones are
+ * overwritten.  The histograms count every operation since the last
+ * hwtrace_reset(), bucket 0 holds the ones under 1us and bucket n the
+ * ones from 2^(n-1) up to 2^n us.  Opcodes beyond HWTRACE_OPS are only
+ * counted in the totals.
+ *
+ * Recording takes hwtrace_lock, which is fine as it only happens while
+ * tracing is on.
+ */
+#define HWTRACE_RING_SLOTS 512	/* must be a power of two */
+#define HWTRACE_OPS 32
+#define HWTRACE_BUCKETS 24
+
+struct hwtrace_record {
+	const char *name;
+	unsigned int op;
+	int bytes;
+	long long start;
+	long long ns;
+};
+
+struct hwtrace_opstat {
+	const char *name;
+	unsigned int op;
+	unsigned long count;
+	unsigned long long bytes;
+	long long min;
+	long long max;
+	long long total;
+	unsigned long hist[HWTRACE_BUCKETS];
+};
+
+volatile int hwtrace_on = -1;		/* -1 until the environment has been read */
+
+static pthread_once_t hwtrace_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t hwtrace_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *hwtrace_dest = NULL;	/* LIBRECIVA_TRACE, dumped to at exit */
+
+static struct hwtrace_record ring[HWTRACE_RING_SLOTS];
+static unsigned long ring_head = 0;
+static struct hwtrace_opstat ops[HWTRACE_OPS];
+static int nops = 0;
+static unsigned long untracked = 0;
+
+static void hwtrace_setup(void);
+static void hwtrace_atexit(void);
+static long long hwtrace_now(void);
+static int hwtrace_bucket(long long ns);
+
+/**
+ * hwtrace_start
+ *
+ * Returns the start time of an operation, or 0 when tracing is off.
+ * Use through HWTRACE_START(), which skips the call when it is off.
+ **/
+long long hwtrace_start(void) {
+	if(hwtrace_on < 0) pthread_once(&hwtrace_once, hwtrace_setup);
+	if(!hwtrace_on) return 0;
+	return hwtrace_now();
+}
+
+/**
+ * hwtrace_end
+ * @name: device name, a string constant
+ * @op: opcode, the ioctl number or a HWTRACE_OP_xxx
+ * @bytes: payload size
+ * @t0: value returned by HWTRACE_START()
+ *
+ * Records an operation that started at t0 and ends now.
+ **/
+void hwtrace_end(const char *name, unsigned int op, int bytes, long long t0) {
+	long long ns = hwtrace_now() - t0;
+	struct hwtrace_record *r;
+	struct hwtrace_opstat *s = NULL;
+	int i;
+
+	pthread_mutex_lock(&hwtrace_lock);
+
+	r = &ring[ring_head++ & (HWTRACE_RING_SLOTS-1)];
+	r->name = name;
+	r->op = op;
+	r->bytes = bytes;
+	r->start = t0;
+	r->ns = ns;
+
+	for(i=0; i<nops; i++) {
+		if(ops[i].op == op && ops[i].name == name) {
+			s = &ops[i];
+			break;
+		}
+	}
+	if(s == NULL && nops < HWTRACE_OPS) {
+		s = &ops[nops++];
+		s->name = name;
+		s->op = op;
+		s->min = ns;
+	}
+
+	if(s == NULL) {
+		untracked++;
+	} else {
+		s->count++;
+		s->bytes += bytes;
+		s->total += ns;
+		if(ns < s->min) s->min = ns;
+		if(ns > s->max) s->max = ns;
+		s->hist[hwtrace_bucket(ns)]++;
+	}
+
+	pthread_mutex_unlock(&hwtrace_lock);
+}
+
+/**
+ * hwtrace_enable
+ * @on: true to record operations
+ *
+ * Switches tracing on or off, overriding LIBRECIVA_TRACE.
+ **/
+void hwtrace_enable(int on) {
+	pthread_once(&hwtrace_once, hwtrace_setup);
+	hwtrace_on = (on != 0);
+}
+
+/**
+ * hwtrace_reset
+ *
+ * Empties the ring and the histograms.
+ **/
+void hwtrace_reset(void) {
+	pthread_mutex_lock(&hwtrace_lock);
+	memset(ring, 0, sizeof(ring));
+	memset(ops, 0, sizeof(ops));
+	ring_head = 0;
+	nops = 0;
+	untracked = 0;
+	pthread_mutex_unlock(&hwtrace_lock);
+}
+
+/**
+ * hwtrace_dump
+ * @f: stream to write to
+ * @records: number of most recent ring records to list as well
+ *
+ * Writes a summary line and a latency histogram for each opcode.
+ **/
+void hwtrace_dump(FILE *f, int records) {
+	struct hwtrace_opstat *s;
+	struct hwtrace_record *r;
+	unsigned long total = untracked;
+	unsigned long first;
+	int i, b;
+
+	pthread_mutex_lock(&hwtrace_lock);
+
+	for(i=0; i<nops; i++) total += ops[i].count;
+	fprintf(f, "hwtrace: %lu operations", total);
+	if(untracked) fprintf(f, ", %lu on untracked opcodes", untracked);
+	fprintf(f, "\n%-8s %-10s %8s %10s %10s %10s %10s\n",
+		"device", "opcode", "count", "bytes", "min_us", "avg_us", "max_us");
+
+	for(i=0; i<nops; i++) {
+		s = &ops[i];
+		fprintf(f, "%-8s 0x%08x %8lu %10llu %10.1f %10.1f %10.1f\n",
+			s->name, s->op, s->count, s->bytes, s->min / 1000.0,
+			s->total / 1000.0 / s->count, s->max / 1000.0);
+		fprintf(f, "        ");
+		for(b=0; b<HWTRACE_BUCKETS; b++) {
+			if(s->hist[b] == 0) continue;
+			if(b == 0) fprintf(f, " <1us:%lu", s->hist[b]);
+			else fprintf(f, " <%luus:%lu", 1UL << b, s->hist[b]);
+		}
+		fprintf(f, "\n");
+	}
+
+	if(records > HWTRACE_RING_SLOTS) records = HWTRACE_RING_SLOTS;
+	if((unsigned long)records > ring_head) records = ring_head;
+	if(records > 0) {
+		first = ring_head - records;
+		for(i=0; i<records; i++) {
+			r = &ring[(first + i) & (HWTRACE_RING_SLOTS-1)];
+			fprintf(f, "%12.6f %-8s 0x%08x %6d %10.1fus\n",
+				r->start / 1e9, r->name, r->op, r->bytes, r->ns / 1000.0);
+		}
+	}
+
+	pthread_mutex_unlock(&hwtrace_lock);
+	fflush(f);
+}
+
+/*
+ * Local support functions
+ */
+
+/* Read LIBRECIVA_TRACE once, and dump at exit when it is set */
+static void hwtrace_setup(void) {
+	char *e = getenv("LIBRECIVA_TRACE");
+
+	if(e == NULL || *e == '\0' || strcmp(e, "0") == 0) {
+		hwtrace_on = 0;
+		return;
+	}
+	if(strcmp(e, "1") != 0 && strcmp(e, "stderr") != 0) hwtrace_dest = e;
+	atexit(hwtrace_atexit);
+	hwtrace_on = 1;
+}
+
+static void hwtrace_atexit(void) {
+	FILE *f = stderr;
+
+	if(hwtrace_dest != NULL) {
+		f = fopen(hwtrace_dest, "w");
+		if(f == NULL) f = stderr;
+	}
+	hwtrace_dump(f, HWTRACE_RING_SLOTS);
+	if(f != stderr) fclose(f);
+}
+
+static long long hwtrace_now(void) {
+	struct timespec ts;
+	long long ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ns = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	/* 0 means 'not traced' to HWTRACE_END */
+	return ns ? ns : 1;
+}
+
+/* Histogram bucket of a duration, see the top of this file */
+static int hwtrace_bucket(long long ns) {
+	long long us = ns / 1000;
+	int b = 0;
+
+	while(us > 0 && b < HWTRACE_BUCKETS-1) {
+		us >>= 1;
+		b++;
+	}
+	return b;
+}